@@ -0,0 +1,39 @@
+#pragma once
+
+/*
+ * Counts the heap allocations of a benchmark executable by replacing the global operator new
+ * Must be included by exactly one translation unit of the executable.
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace allocation_counter {
+
+inline std::atomic<size_t> count{0};
+
+/*
+ * Number of allocations since the program started
+ */
+inline size_t get() {
+    return count.load(std::memory_order_relaxed);
+}
+
+}  // namespace allocation_counter
+
+void* operator new(size_t size) {
+    allocation_counter::count.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
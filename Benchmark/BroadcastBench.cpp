@@ -0,0 +1,113 @@
+/*
+ * Broadcast allocation benchmark
+ * Fans messages out to connections over local socketpairs and counts the heap allocations per broadcast, comparing
+ * a per-recipient formatted std::string with shared, reference counted message segments.
+ * Usage: broadcast_bench [--clients N] [--broadcasts M]
+ */
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Networking/MessageBuffer.hpp"
+#include "../Server/Connection.hpp"
+#include "AllocationCounter.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchResult {
+    double allocationsPerBroadcast;
+    double nanosecondsPerBroadcast;
+};
+
+// Reads and discards everything the connections received, so the socket buffers never fill up
+void drainPeers(const std::vector<int>& peerFds) {
+    char buffer[16 * 1024];
+    for (int fd : peerFds) {
+        while (::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+        }
+    }
+}
+
+template <typename Broadcast>
+BenchResult measure(std::vector<Connection>& connections, const std::vector<int>& peerFds, size_t broadcasts, Broadcast broadcast) {
+    size_t allocations = 0;
+    Clock::duration elapsed{};
+    for (size_t broadcastIdx = 0; broadcastIdx < broadcasts; broadcastIdx++) {
+        size_t allocationsBefore = allocation_counter::get();
+        auto start = Clock::now();
+        broadcast(connections, broadcastIdx);
+        elapsed += Clock::now() - start;
+        allocations += allocation_counter::get() - allocationsBefore;
+        drainPeers(peerFds);
+    }
+    return BenchResult{static_cast<double>(allocations) / broadcasts, std::chrono::duration<double, std::nano>(elapsed).count() / broadcasts};
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t clientCount = 500;
+    size_t broadcasts = 200;
+    for (int argIdx = 1; argIdx + 1 < argc; argIdx += 2) {
+        std::string option = argv[argIdx];
+        if (option == "--clients") {
+            clientCount = std::stoul(argv[argIdx + 1]);
+        } else if (option == "--broadcasts") {
+            broadcasts = std::stoul(argv[argIdx + 1]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--clients N] [--broadcasts M]" << std::endl;
+            return 1;
+        }
+    }
+
+    BufferPool receivePool{8192};
+    std::vector<Connection> connections;
+    std::vector<int> peerFds;
+    connections.reserve(clientCount);
+    for (size_t clientIdx = 0; clientIdx < clientCount; clientIdx++) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) != 0) {
+            std::cerr << "socketpair failed, errno: " << errno << std::endl;
+            return 1;
+        }
+        TCPSocket socket;
+        socket.m_setSockFd(fds[0]);
+        connections.emplace_back(std::move(socket), UserData(clientIdx + 1, "user" + std::to_string(clientIdx), ""), receivePool);
+        connections.back().setClientData(connections.back().getClientData());
+        peerFds.push_back(fds[1]);
+    }
+
+    const std::string message = "The quick brown fox jumps over the lazy dog, a typical chat message of moderate length\n";
+    Connection& sender = connections.front();
+
+    // Previous implementation: every recipient gets its own formatted copy
+    BenchResult copied = measure(connections, peerFds, broadcasts, [&](std::vector<Connection>& targets, size_t) {
+        for (size_t targetIdx = 1; targetIdx < targets.size(); targetIdx++) {
+            targets[targetIdx].send(sender.getClientData().getName() + ": " + message);
+        }
+    });
+
+    // Shared segments: the sender prefix exists since login, the payload is allocated once
+    BenchResult shared = measure(connections, peerFds, broadcasts, [&](std::vector<Connection>& targets, size_t) {
+        MessageRef segments[] = {sender.getSenderPrefix(), MessageBuffer::create({message})};
+        for (size_t targetIdx = 1; targetIdx < targets.size(); targetIdx++) {
+            targets[targetIdx].send(segments);
+        }
+    });
+
+    std::cout << "recipients per broadcast: " << clientCount - 1 << "\n"
+              << "per-recipient strings:    " << copied.allocationsPerBroadcast << " allocations, " << copied.nanosecondsPerBroadcast << " ns per broadcast\n"
+              << "shared segments:          " << shared.allocationsPerBroadcast << " allocations, " << shared.nanosecondsPerBroadcast << " ns per broadcast" << std::endl;
+
+    for (int fd : peerFds) {
+        close(fd);
+    }
+    return 0;
+}
@@ -0,0 +1,533 @@
+/*
+ * End-to-end load generator
+ * Connects a number of clients to a running server, registers and logs them in and drives chat traffic. Every
+ * message carries the time it was sent, so the receivers measure the end-to-end latency of each delivery.
+ *
+ * Scenarios:
+ *   login-storm      all clients register and log in at once, measures logins per second and login latency
+ *   broadcast-flood  some clients send messages at a fixed total rate, all others receive them
+ *   slow-readers     like broadcast-flood, but some clients read at a throttled rate, the latency of all others
+ *                    shows whether the slow ones affect them
+ *
+ * Usage: chat_bench <ip> <port> <scenario> [options]
+ *        chat_bench <ip> <port> --script <file>
+ * A script contains one scenario with its options per line, empty lines and lines starting with '#' are ignored.
+ * The exit code is 2 if a scenario exceeded its --max-p99-us limit or lost deliveries, so the suite can gate changes.
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../Networking/EventLoop.hpp"
+#include "../Networking/TCPSocket.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct ScenarioOptions {
+    std::string scenario;
+    size_t clients = 100;
+    size_t senders = 10;
+    // Messages per second of all senders together, 0 sends as fast as the server accepts them
+    double rate = 1000;
+    double duration = 5;
+    size_t payload = 64;
+    size_t slowClients = 0;
+    // Bytes per second a slow client reads
+    size_t slowReadRate = 1024;
+    // Fails the scenario if the p99 delivery latency exceeds this many microseconds, 0 disables the check
+    double maxP99Us = 0;
+    std::string namePrefix = "cb";
+};
+
+const std::string usage = "Usage: chat_bench <ip> <port> <login-storm|broadcast-flood|slow-readers> [--clients N] [--senders N] [--rate MSGS_PER_S] "
+                          "[--duration S] [--payload BYTES] [--slow-clients N] [--slow-read-rate BYTES_PER_S] [--max-p99-us US] [--name-prefix P]\n"
+                          "       chat_bench <ip> <port> --script <file>";
+
+bool parseScenario(const std::vector<std::string>& args, ScenarioOptions& options) {
+    if (args.empty()) {
+        return false;
+    }
+    options.scenario = args[0];
+    if (options.scenario == "login-storm") {
+        options.clients = 1000;
+        options.senders = 0;
+        options.duration = 0;
+    } else if (options.scenario == "broadcast-flood") {
+        options.clients = 500;
+        options.senders = 50;
+        options.rate = 5000;
+    } else if (options.scenario == "slow-readers") {
+        options.clients = 200;
+        options.senders = 20;
+        options.rate = 2000;
+        options.slowClients = 20;
+    } else {
+        return false;
+    }
+
+    try {
+        for (size_t argIdx = 1; argIdx < args.size(); argIdx += 2) {
+            if (argIdx + 1 >= args.size()) {
+                return false;
+            }
+            const std::string& option = args[argIdx];
+            const std::string& value = args[argIdx + 1];
+            if (option == "--clients") {
+                options.clients = std::stoul(value);
+            } else if (option == "--senders") {
+                options.senders = std::stoul(value);
+            } else if (option == "--rate") {
+                options.rate = std::stod(value);
+            } else if (option == "--duration") {
+                options.duration = std::stod(value);
+            } else if (option == "--payload") {
+                options.payload = std::stoul(value);
+            } else if (option == "--slow-clients") {
+                options.slowClients = std::stoul(value);
+            } else if (option == "--slow-read-rate") {
+                options.slowReadRate = std::stoul(value);
+            } else if (option == "--max-p99-us") {
+                options.maxP99Us = std::stod(value);
+            } else if (option == "--name-prefix") {
+                options.namePrefix = value;
+            } else {
+                return false;
+            }
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+    // Names have to be between 3 and 16 characters
+    return options.clients >= 1 && options.senders + options.slowClients <= options.clients && options.rate >= 0 && options.duration >= 0 &&
+           !options.namePrefix.empty() && options.namePrefix.size() + std::to_string(options.clients).size() <= 16;
+}
+
+/*
+ * Collects latency samples and reports percentiles
+ */
+class LatencyRecorder {
+   private:
+    std::vector<uint64_t> m_samples;
+    bool m_sorted = true;
+
+   public:
+    void add(uint64_t nanoseconds) {
+        m_samples.push_back(nanoseconds);
+        m_sorted = false;
+    }
+
+    size_t count() const {
+        return m_samples.size();
+    }
+
+    double percentileUs(double percentile) {
+        if (m_samples.empty()) {
+            return 0;
+        }
+        if (!m_sorted) {
+            std::sort(m_samples.begin(), m_samples.end());
+            m_sorted = true;
+        }
+        size_t sampleIdx = std::min(m_samples.size() - 1, static_cast<size_t>(percentile / 100 * m_samples.size()));
+        return m_samples[sampleIdx] / 1000.0;
+    }
+
+    std::string summary() {
+        std::ostringstream stream;
+        stream << "p50 " << percentileUs(50) << " us, p99 " << percentileUs(99) << " us, p999 " << percentileUs(99.9) << " us, max " << percentileUs(100) << " us";
+        return stream.str();
+    }
+};
+
+struct BenchClient {
+    TCPSocket socket;
+    std::string name;
+    std::string joinMarker;
+    std::string partialLine;
+    std::string pendingOutput;
+    Clock::time_point loginStart;
+    bool accepted = false;
+    bool loggedIn = false;
+    bool closed = false;
+    bool slow = false;
+    size_t readBudget = 0;
+    size_t deliveries = 0;
+};
+
+uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+class ScenarioRunner {
+   private:
+    std::string m_ip;
+    uint16_t m_port;
+    ScenarioOptions m_options;
+    EventLoop m_eventLoop{EventLoop::Backend::EPOLL, 4096};
+    std::vector<BenchClient> m_clients;
+
+    LatencyRecorder m_loginLatency;
+    LatencyRecorder m_deliveryLatency;
+    size_t m_loggedIn = 0;
+    size_t m_rejections = 0;
+    size_t m_fastDeliveries = 0;
+    size_t m_slowDeliveries = 0;
+    bool m_measuring = false;
+    size_t m_nextClient = 0;
+
+    // Connections that may wait for being accepted at the same time
+    const size_t m_connectConcurrency = 4;
+
+    void flushOutput(BenchClient& client) {
+        while (!client.pendingOutput.empty() && !client.closed) {
+            ssize_t written = client.socket.sendSome(client.pendingOutput.data(), client.pendingOutput.size());
+            if (written <= 0) {
+                return;
+            }
+            client.pendingOutput.erase(0, written);
+        }
+    }
+
+    void handleLine(BenchClient& client, std::string_view line) {
+        // Keepalive of servers started with --ping-interval
+        if (line == "/ping") {
+            client.pendingOutput += "/pong\n";
+            flushOutput(client);
+            return;
+        }
+        if (!client.loggedIn) {
+            if (line.find(client.joinMarker) != std::string_view::npos) {
+                client.loggedIn = true;
+                m_loggedIn++;
+                m_loginLatency.add(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - client.loginStart).count());
+            } else if (line.find("try again later") != std::string_view::npos) {
+                m_rejections++;
+            }
+            return;
+        }
+        // '<sender>: t=<send time> <padding>'
+        size_t stampPos = line.find(": t=");
+        if (!m_measuring || stampPos == std::string_view::npos) {
+            return;
+        }
+        uint64_t sentNs = 0;
+        const char* stampBegin = line.data() + stampPos + 4;
+        if (std::from_chars(stampBegin, line.data() + line.size(), sentNs).ec != std::errc()) {
+            return;
+        }
+        client.deliveries++;
+        if (client.slow) {
+            m_slowDeliveries++;
+        } else {
+            m_fastDeliveries++;
+            m_deliveryLatency.add(nowNs() - sentNs);
+        }
+    }
+
+    void readInput(BenchClient& client, size_t limit) {
+        char buffer[64 * 1024];
+        while (limit > 0 && !client.closed) {
+            ssize_t received = client.socket.recvSome(buffer, std::min(limit, sizeof(buffer)));
+            if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                client.closed = true;
+                m_eventLoop.remove(client.socket.getSockFd());
+                return;
+            }
+            if (received < 0) {
+                return;
+            }
+            limit -= received;
+            if (!client.accepted) {
+                handleAccepted(client);
+            }
+
+            std::string_view data(buffer, received);
+            size_t lineEnd;
+            while ((lineEnd = data.find('\n')) != std::string_view::npos) {
+                if (client.partialLine.empty()) {
+                    handleLine(client, data.substr(0, lineEnd));
+                } else {
+                    client.partialLine.append(data.substr(0, lineEnd));
+                    handleLine(client, client.partialLine);
+                    client.partialLine.clear();
+                }
+                data.remove_prefix(lineEnd + 1);
+            }
+            client.partialLine.append(data);
+        }
+    }
+
+    // Slow clients are not read from their event callback, they get a byte budget that grows with their read rate
+    void readSlowClients(Clock::time_point& lastTick) {
+        auto now = Clock::now();
+        size_t grant = static_cast<size_t>(std::chrono::duration<double>(now - lastTick).count() * m_options.slowReadRate);
+        if (grant == 0) {
+            return;
+        }
+        lastTick = now;
+        for (auto& client : m_clients) {
+            if (client.slow && !client.closed) {
+                client.readBudget += grant;
+                size_t budget = client.readBudget;
+                client.readBudget = 0;
+                readInput(client, budget);
+            }
+        }
+    }
+
+    template <typename Condition>
+    bool pumpUntil(Condition condition, std::chrono::milliseconds idleTimeout) {
+        auto lastProgress = Clock::now();
+        while (!condition()) {
+            if (m_eventLoop.poll(10) > 0) {
+                lastProgress = Clock::now();
+            } else if (Clock::now() - lastProgress > idleTimeout) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*
+     * Starts connecting the next client
+     * Only a few connections wait for their welcome message (i.e. for being accepted) at a time, more would overflow
+     * the server's listen backlog and wait for the kernel to retry the handshake instead of measuring the server.
+     */
+    void connectNext() {
+        if (m_nextClient == m_clients.size()) {
+            return;
+        }
+        BenchClient& client = m_clients[m_nextClient];
+        client.name = m_options.namePrefix + std::to_string(m_nextClient);
+        client.joinMarker = ">>> Logged in as " + client.name;
+        m_nextClient++;
+
+        client.socket = TCPSocket(TCPSocketType::TCP);
+        client.socket.setNonBlocking(true);
+        if (!client.socket.connect(m_ip, m_port) && errno != EINPROGRESS) {
+            std::cerr << "Failed to connect " << client.name << ", errno: " << errno << std::endl;
+            client.closed = true;
+            connectNext();
+            return;
+        }
+        m_eventLoop.add(client.socket.getSockFd(), EPOLLIN | EPOLLOUT, [this, &client](uint32_t events) {
+            if (events & EPOLLOUT) {
+                flushOutput(client);
+            }
+            if (!client.slow || !m_measuring) {
+                readInput(client, SIZE_MAX);
+            }
+            if (!client.accepted && client.closed) {
+                connectNext();
+            }
+        });
+    }
+
+    // Called with the first data (the welcome message) of a client, which shows the server accepted it
+    void handleAccepted(BenchClient& client) {
+        client.accepted = true;
+        // Registering fails for names left from a previous run, the login is handled after it either way
+        client.loginStart = Clock::now();
+        client.pendingOutput += "/register " + client.name + " benchpass\n/login " + client.name + " benchpass\n";
+        flushOutput(client);
+        connectNext();
+    }
+
+    void logIn() {
+        m_clients.resize(m_options.clients);
+        auto start = Clock::now();
+        for (size_t clientIdx = 0; clientIdx < m_connectConcurrency; clientIdx++) {
+            connectNext();
+        }
+        pumpUntil([this] { return m_loggedIn == m_clients.size(); }, std::chrono::seconds(5));
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::cout << "  logged in:     " << m_loggedIn << " / " << m_clients.size() << " in " << seconds << " s, " << m_loggedIn / seconds << " logins/s";
+        if (m_rejections > 0) {
+            std::cout << ", " << m_rejections << " request(s) rejected by the server";
+        }
+        std::cout << "\n  login latency: " << m_loginLatency.summary() << std::endl;
+    }
+
+    std::string makeMessage() {
+        std::string message = "t=" + std::to_string(nowNs()) + " ";
+        if (message.size() < m_options.payload) {
+            message.append(m_options.payload - message.size(), 'x');
+        }
+        return message + "\n";
+    }
+
+    bool sendMessages() {
+        std::vector<BenchClient*> senders;
+        size_t fastReceivers = 0;
+        size_t fastAssigned = 0;
+        for (size_t clientIdx = 0; clientIdx < m_clients.size(); clientIdx++) {
+            BenchClient& client = m_clients[clientIdx];
+            client.slow = clientIdx >= m_clients.size() - m_options.slowClients;
+            if (!client.loggedIn || client.slow) {
+                continue;
+            }
+            fastReceivers++;
+            if (fastAssigned++ < m_options.senders) {
+                senders.push_back(&client);
+            }
+        }
+        if (senders.empty()) {
+            std::cout << "  no logged in client left to send messages" << std::endl;
+            return false;
+        }
+
+        // Let the join notifications settle before measuring
+        pumpUntil([] { return false; }, std::chrono::milliseconds(300));
+        m_measuring = true;
+
+        auto start = Clock::now();
+        auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(m_options.duration));
+        auto lastSlowTick = start;
+        size_t sent = 0;
+        while (Clock::now() < deadline) {
+            double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+            size_t due = m_options.rate > 0 ? static_cast<size_t>(elapsed * m_options.rate) : sent + senders.size();
+            for (; sent < due; sent++) {
+                BenchClient& sender = *senders[sent % senders.size()];
+                // Without a rate, a sender only gets a new message once the previous one was written
+                if (m_options.rate == 0 && !sender.pendingOutput.empty()) {
+                    break;
+                }
+                sender.pendingOutput += makeMessage();
+                flushOutput(sender);
+            }
+            m_eventLoop.poll(m_options.rate > 0 ? 1 : 0);
+            readSlowClients(lastSlowTick);
+        }
+        double sendSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        // Every message reaches all other fast clients (the sender itself does not receive it)
+        size_t expected = sent * (fastReceivers - 1);
+        auto lastProgress = Clock::now();
+        size_t lastDeliveries = m_fastDeliveries;
+        while (m_fastDeliveries < expected && Clock::now() - lastProgress < std::chrono::seconds(2)) {
+            m_eventLoop.poll(10);
+            readSlowClients(lastSlowTick);
+            if (m_fastDeliveries != lastDeliveries) {
+                lastDeliveries = m_fastDeliveries;
+                lastProgress = Clock::now();
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        size_t disconnected = 0;
+        for (const auto& client : m_clients) {
+            disconnected += client.closed;
+        }
+        std::cout << "  messages:      " << sent << " sent in " << sendSeconds << " s, " << sent / sendSeconds << " messages/s\n"
+                  << "  deliveries:    " << m_fastDeliveries << " / " << expected << " in " << seconds << " s, " << m_fastDeliveries / seconds << " deliveries/s\n"
+                  << "  latency:       " << m_deliveryLatency.summary() << "\n";
+        if (m_options.slowClients > 0) {
+            std::cout << "  slow clients:  " << m_options.slowClients << " reading " << m_options.slowReadRate << " bytes/s, " << m_slowDeliveries << " deliveries\n";
+        }
+        std::cout << "  disconnected:  " << disconnected << std::endl;
+        return m_fastDeliveries >= expected;
+    }
+
+   public:
+    ScenarioRunner(const std::string& ip, uint16_t port, const ScenarioOptions& options) : m_ip{ip}, m_port{port}, m_options{options} {}
+
+    /*
+     * Runs the scenario and prints its results
+     * @return false if the scenario failed or exceeded its latency limit
+     */
+    bool run() {
+        std::cout << m_options.scenario << ": " << m_options.clients << " clients";
+        if (m_options.duration > 0 && m_options.senders > 0) {
+            std::cout << ", " << m_options.senders << " senders at " << (m_options.rate > 0 ? std::to_string(static_cast<size_t>(m_options.rate)) : "max") << " messages/s for "
+                      << m_options.duration << " s, " << m_options.payload << " byte payload";
+        }
+        std::cout << std::endl;
+
+        logIn();
+        if (m_loggedIn < m_clients.size()) {
+            return false;
+        }
+        if (m_options.duration == 0 || m_options.senders == 0) {
+            return true;
+        }
+
+        bool complete = sendMessages();
+        if (m_options.maxP99Us > 0 && m_deliveryLatency.percentileUs(99) > m_options.maxP99Us) {
+            std::cout << "  FAILED: p99 latency above " << m_options.maxP99Us << " us" << std::endl;
+            return false;
+        }
+        if (!complete) {
+            std::cout << "  FAILED: deliveries missing" << std::endl;
+        }
+        return complete;
+    }
+};
+
+std::vector<std::string> splitWords(const std::string& line) {
+    std::istringstream stream(line);
+    std::vector<std::string> words;
+    std::string word;
+    while (stream >> word) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::cerr << usage << std::endl;
+        return 1;
+    }
+    std::string ip = argv[1];
+    uint16_t port = static_cast<uint16_t>(std::stoul(argv[2]));
+
+    std::vector<ScenarioOptions> scenarios;
+    if (std::string(argv[3]) == "--script") {
+        std::ifstream script(argc > 4 ? argv[4] : "");
+        if (!script) {
+            std::cerr << "Failed to open the script" << std::endl;
+            return 1;
+        }
+        std::string line;
+        for (size_t lineNumber = 1; std::getline(script, line); lineNumber++) {
+            std::vector<std::string> words = splitWords(line);
+            if (words.empty() || words[0].starts_with("#")) {
+                continue;
+            }
+            ScenarioOptions options;
+            if (!parseScenario(words, options)) {
+                std::cerr << "Invalid scenario in line " << lineNumber << ": " << line << "\n" << usage << std::endl;
+                return 1;
+            }
+            scenarios.push_back(options);
+        }
+    } else {
+        ScenarioOptions options;
+        if (!parseScenario(std::vector<std::string>(argv + 3, argv + argc), options)) {
+            std::cerr << usage << std::endl;
+            return 1;
+        }
+        scenarios.push_back(options);
+    }
+
+    bool passed = true;
+    for (const auto& options : scenarios) {
+        ScenarioRunner runner{ip, port, options};
+        passed = runner.run() && passed;
+    }
+    return passed ? 0 : 2;
+}
@@ -0,0 +1,153 @@
+/*
+ * User database benchmark
+ * Measures registrations and logins (name lookups with password check) per second, comparing statements that are
+ * prepared and finalized on every call with default pragmas against the cached statements and WAL journaling of
+ * UserDatabase, with and without the UserCache in front of it. Every variant uses its own database file in the
+ * temporary directory.
+ * Usage: db_bench [--users N] [--logins M]
+ */
+
+#include <sqlite3.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "../Database/UserDatabase.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Previous implementation: every call compiles its statement, the database runs with the default rollback journal
+class UncachedDatabase {
+   private:
+    sqlite3* m_database;
+
+   public:
+    UncachedDatabase(const std::string& path) {
+        sqlite3_open(path.c_str(), &m_database);
+        sqlite3_exec(m_database, "CREATE TABLE IF NOT EXISTS users (id INTEGER PRIMARY KEY, name TEXT NOT NULL UNIQUE, password TEXT NOT NULL);", nullptr, nullptr, nullptr);
+    }
+    ~UncachedDatabase() {
+        sqlite3_close(m_database);
+    }
+
+    bool insert(const UserData& userData) {
+        std::string insertStmtBase = "INSERT INTO users (id, name, password) VALUES ($id, $name, $password);";
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(m_database, insertStmtBase.c_str(), insertStmtBase.length(), &stmt, nullptr);
+        sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, "$id"), userData.getId());
+        sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, "$name"), userData.getName().c_str(), userData.getName().length(), SQLITE_STATIC);
+        sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, "$password"), userData.getPassword().c_str(), userData.getPassword().length(), SQLITE_STATIC);
+        int result = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        return result == SQLITE_DONE;
+    }
+
+    UserData findByName(const std::string& name) {
+        std::string selectStmtBase = "SELECT id, name, password FROM users WHERE name = $name;";
+        sqlite3_stmt* stmt;
+        sqlite3_prepare_v2(m_database, selectStmtBase.c_str(), selectStmtBase.length(), &stmt, nullptr);
+        sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, "$name"), name.c_str(), name.length(), SQLITE_STATIC);
+        UserData userData = UserData::empty();
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            userData = UserData(sqlite3_column_int(stmt, 0), reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)),
+                                reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
+        }
+        sqlite3_finalize(stmt);
+        return userData;
+    }
+};
+
+struct BenchResult {
+    double registrationsPerSecond;
+    double loginsPerSecond;
+};
+
+template <typename Database>
+BenchResult measure(Database& database, size_t users, size_t logins) {
+    auto start = Clock::now();
+    for (size_t userIdx = 0; userIdx < users; userIdx++) {
+        database.insert(UserData(userIdx + 1, "user" + std::to_string(userIdx), "password" + std::to_string(userIdx)));
+    }
+    double registrationSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // A login looks the user up by name and compares the password, like the server does
+    size_t successfulLogins = 0;
+    start = Clock::now();
+    for (size_t loginIdx = 0; loginIdx < logins; loginIdx++) {
+        size_t userIdx = (loginIdx * 7919) % users;
+        UserData userData = database.findByName("user" + std::to_string(userIdx));
+        successfulLogins += userData.getPassword() == "password" + std::to_string(userIdx);
+    }
+    double loginSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    if (successfulLogins != logins) {
+        std::cerr << "Only " << successfulLogins << " of " << logins << " logins succeeded" << std::endl;
+    }
+    return BenchResult{users / registrationSeconds, logins / loginSeconds};
+}
+
+void removeDatabase(const std::filesystem::path& path) {
+    for (const char* suffix : {"", "-wal", "-shm", "-journal"}) {
+        std::filesystem::remove(path.string() + suffix);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t users = 2000;
+    size_t logins = 200000;
+    for (int argIdx = 1; argIdx + 1 < argc; argIdx += 2) {
+        std::string option = argv[argIdx];
+        if (option == "--users") {
+            users = std::stoul(argv[argIdx + 1]);
+        } else if (option == "--logins") {
+            logins = std::stoul(argv[argIdx + 1]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--users N] [--logins M]" << std::endl;
+            return 1;
+        }
+    }
+    if (users == 0) {
+        std::cerr << "At least one user is required" << std::endl;
+        return 1;
+    }
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string pid = std::to_string(getpid());
+    std::filesystem::path uncachedPath = directory / ("db_bench_uncached_" + pid + ".db");
+    std::filesystem::path cachedPath = directory / ("db_bench_cached_" + pid + ".db");
+    std::filesystem::path userCachePath = directory / ("db_bench_user_cache_" + pid + ".db");
+
+    BenchResult uncached;
+    {
+        UncachedDatabase database{uncachedPath.string()};
+        uncached = measure(database, users, logins);
+    }
+    BenchResult cached;
+    {
+        UserDatabase database{cachedPath.string()};
+        cached = measure(database, users, logins);
+    }
+    BenchResult userCached;
+    {
+        UserCache userCache{users};
+        UserDatabase database{userCachePath.string(), &userCache};
+        database.warmCache();
+        userCached = measure(database, users, logins);
+    }
+    removeDatabase(uncachedPath);
+    removeDatabase(cachedPath);
+    removeDatabase(userCachePath);
+
+    std::cout << "users: " << users << ", logins: " << logins << "\n"
+              << "prepare per call:   " << uncached.registrationsPerSecond << " registrations/s, " << uncached.loginsPerSecond << " logins/s\n"
+              << "cached statements:  " << cached.registrationsPerSecond << " registrations/s, " << cached.loginsPerSecond << " logins/s\n"
+              << "with user cache:    " << userCached.registrationsPerSecond << " registrations/s, " << userCached.loginsPerSecond << " logins/s, "
+              << 1e9 / userCached.loginsPerSecond << " ns per login" << std::endl;
+    return 0;
+}
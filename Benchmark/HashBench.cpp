@@ -0,0 +1,94 @@
+/*
+ * Password hashing benchmark
+ * Derives PBKDF2-HMAC-SHA256 password hashes on an increasing number of threads and reports the hashes per second,
+ * which shows how many logins per second an auth pool of that size sustains.
+ * Usage: hash_bench [--iterations I] [--max-threads T] [--hashes N]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Security/PasswordHasher.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// PBKDF2-HMAC-SHA256 test vector of RFC 7914 (P = "passwd", S = "salt", c = 1), first 32 bytes of the derived key
+bool selfTest() {
+    const uint8_t salt[] = {'s', 'a', 'l', 't'};
+    const uint8_t expected[] = {0x55, 0xac, 0x04, 0x6e, 0x56, 0xe3, 0x08, 0x9f, 0xec, 0x16, 0x91, 0xc2, 0x25, 0x44, 0xb6, 0x05,
+                                0xf9, 0x41, 0x85, 0x21, 0x6d, 0xde, 0x04, 0x65, 0xe6, 0x8b, 0x9d, 0x57, 0xc2, 0x0d, 0xac, 0xbc};
+    uint8_t key[32];
+    PasswordHasher::pbkdf2("passwd", salt, 1, key);
+    return std::equal(std::begin(key), std::end(key), std::begin(expected));
+}
+
+double measure(const PasswordHasher& hasher, unsigned int threadCount, size_t hashes) {
+    std::atomic<size_t> nextHash{0};
+    std::vector<std::thread> threads;
+    auto start = Clock::now();
+    for (unsigned int threadIdx = 0; threadIdx < threadCount; threadIdx++) {
+        threads.emplace_back([&hasher, &nextHash, hashes]() {
+            while (nextHash.fetch_add(1, std::memory_order_relaxed) < hashes) {
+                hasher.hash("benchmark password");
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return hashes / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    unsigned int iterations = 100000;
+    unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    size_t hashes = 64;
+    try {
+        for (int argIdx = 1; argIdx < argc; argIdx += 2) {
+            std::string option = argv[argIdx];
+            if (argIdx + 1 >= argc) {
+                throw std::invalid_argument(option);
+            }
+            unsigned long value = std::stoul(argv[argIdx + 1]);
+            if (option == "--iterations" && value > 0) {
+                iterations = value;
+            } else if (option == "--max-threads" && value > 0) {
+                maxThreads = value;
+            } else if (option == "--hashes" && value > 0) {
+                hashes = value;
+            } else {
+                throw std::invalid_argument(option);
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Usage: " << argv[0] << " [--iterations I] [--max-threads T] [--hashes N]" << std::endl;
+        return 1;
+    }
+
+    if (!selfTest()) {
+        std::cerr << "PBKDF2 self test failed" << std::endl;
+        return 1;
+    }
+
+    PasswordHasher hasher{iterations};
+    std::cout << "iterations: " << iterations << ", hashes per run: " << hashes << ", cores: " << std::thread::hardware_concurrency() << std::endl;
+    double singleThreaded = 0;
+    for (unsigned int threadCount = 1; threadCount <= maxThreads; threadCount = threadCount < maxThreads ? std::min(threadCount * 2, maxThreads) : threadCount + 1) {
+        double hashesPerSecond = measure(hasher, threadCount, hashes);
+        if (threadCount == 1) {
+            singleThreaded = hashesPerSecond;
+        }
+        std::cout << "threads: " << threadCount << "  hashes/s: " << hashesPerSecond << "  speedup: " << hashesPerSecond / singleThreaded << std::endl;
+    }
+    return 0;
+}
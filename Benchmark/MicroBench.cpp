@@ -0,0 +1,525 @@
+/*
+ * Microbenchmarks of the hot primitives
+ * Measures nanoseconds, TSC cycles and heap allocations per operation of isolated building blocks: colorizing text,
+ * framing received lines, the text and binary protocols, compressing frames, the broadcast loop over connections,
+ * receiving from a socket, user lookups and UserData copies, recording metrics, admitting connections and timers. Sockets are local socketpairs and the database lives in memory, so no network or server is needed.
+ * Usage: micro_bench [--filter SUBSTRING] [--scale FACTOR]
+ */
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Database/UserCache.hpp"
+#include "../Database/UserDatabase.hpp"
+#include "../Networking/BinaryFrame.hpp"
+#include "../Networking/BufferPool.hpp"
+#include "../Networking/LineFramer.hpp"
+#include "../Networking/MessageBuffer.hpp"
+#include "../Networking/TimerWheel.hpp"
+#include "../Server/Connection.hpp"
+#include "../Server/ConnectionAdmission.hpp"
+#include "../Server/ConnectionSlab.hpp"
+#include "../Server/Metrics.hpp"
+#include "../Server/TextColor.hpp"
+#include "../Server/WireMessage.hpp"
+#include "AllocationCounter.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Reads the time stamp counter, other architectures report 0 cycles
+uint64_t readCycles() {
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Keeps the compiler from optimizing a result away
+template <typename T>
+void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct Measurement {
+    double nanosecondsPerOp;
+    double cyclesPerOp;
+    double allocationsPerOp;
+};
+
+/*
+ * Runs an operation in batches, only the operations themselves are measured
+ * @param prepare - called before every batch without being measured (e.g. to fill or drain sockets)
+ * @param operation - called batchSize times per batch with the index of the operation within the batch
+ */
+template <typename Prepare, typename Operation>
+Measurement measure(size_t batches, size_t batchSize, Prepare prepare, Operation operation) {
+    uint64_t nanoseconds = 0;
+    uint64_t cycles = 0;
+    size_t allocations = 0;
+    for (size_t batchIdx = 0; batchIdx < batches; batchIdx++) {
+        prepare();
+        size_t allocationsBefore = allocation_counter::get();
+        auto start = Clock::now();
+        uint64_t startCycles = readCycles();
+        for (size_t opIdx = 0; opIdx < batchSize; opIdx++) {
+            operation(opIdx);
+        }
+        cycles += readCycles() - startCycles;
+        nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        allocations += allocation_counter::get() - allocationsBefore;
+    }
+    double ops = static_cast<double>(batches * batchSize);
+    return Measurement{nanoseconds / ops, cycles / ops, allocations / ops};
+}
+
+class MicroBench {
+   private:
+    std::string m_filter;
+    double m_scale;
+
+    bool m_selected(const std::string& name) const {
+        return m_filter.empty() || name.find(m_filter) != std::string::npos;
+    }
+
+    size_t m_batches(size_t batches) const {
+        return std::max<size_t>(1, static_cast<size_t>(batches * m_scale));
+    }
+
+    void m_report(const std::string& name, const Measurement& measurement) const {
+        std::cout << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(1) << std::setw(12) << measurement.nanosecondsPerOp << std::setw(14)
+                  << measurement.cyclesPerOp << std::setprecision(2) << std::setw(12) << measurement.allocationsPerOp << std::endl;
+    }
+
+    // Creates a connected socketpair, the first socket is wrapped into the TCPSocket
+    static int m_socketPair(TCPSocket& socket) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) != 0) {
+            throw std::runtime_error("socketpair failed, errno: " + std::to_string(errno));
+        }
+        socket.m_setSockFd(fds[0]);
+        return fds[1];
+    }
+
+    static void m_drain(int fd) {
+        char buffer[64 * 1024];
+        while (::recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+        }
+    }
+
+   public:
+    MicroBench(const std::string& filter, double scale) : m_filter{filter}, m_scale{scale} {}
+
+    void colorize() {
+        const std::string text = ">>> someone joined the server";
+        if (m_selected("colorize/concatenation")) {
+            // Previous implementation: a temporary string per operator+
+            m_report("colorize/concatenation", measure(m_batches(200), 1000, [] {}, [&](size_t) {
+                         std::string colorized = std::string(colorCode(TextColor::SERVER_NOTIFICATION)) + text + std::string(colorReset);
+                         keep(colorized);
+                     }));
+        }
+        if (m_selected("colorize/colorizeText")) {
+            m_report("colorize/colorizeText", measure(m_batches(200), 1000, [] {}, [&](size_t) {
+                         std::string colorized = colorizeText(text, TextColor::SERVER_NOTIFICATION);
+                         keep(colorized);
+                     }));
+        }
+    }
+
+    void framing() {
+        if (!m_selected("framing/nextLine")) {
+            return;
+        }
+        // Chat lines of 64 bytes, as many as fit into one receive chunk
+        BufferPool pool{64 * 1024};
+        LineFramer framer{pool, 4096};
+        const std::string line = std::string(63, 'x') + "\n";
+        const size_t linesPerChunk = pool.getChunkSize() / line.size() - 1;
+        m_report("framing/nextLine", measure(
+                                         m_batches(200), linesPerChunk,
+                                         [&] {
+                                             std::span<char> space = framer.writableSpace();
+                                             for (size_t lineIdx = 0; lineIdx < linesPerChunk; lineIdx++) {
+                                                 std::memcpy(space.data() + lineIdx * line.size(), line.data(), line.size());
+                                             }
+                                             framer.commit(linesPerChunk * line.size());
+                                         },
+                                         [&](size_t) {
+                                             std::string_view extracted;
+                                             framer.nextLine(extracted);
+                                             keep(extracted);
+                                         }));
+    }
+
+    /*
+     * Writes copies of a line or frame into the framer, the buffer has to be empty and large enough
+     */
+    static void m_fill(LineFramer& framer, std::string_view unit, size_t count) {
+        std::span<char> space = framer.writableSpace();
+        for (size_t unitIdx = 0; unitIdx < count; unitIdx++) {
+            std::memcpy(space.data() + unitIdx * unit.size(), unit.data(), unit.size());
+        }
+        framer.commit(count * unit.size());
+    }
+
+    void protocol() {
+        // What a bot extracts from a received chat message: room, sender, id, time and text
+        const std::string text = "The quick brown fox jumps over the lazy dog";
+        BufferPool pool{64 * 1024};
+        if (m_selected("protocol/parse text line")) {
+            // Only sender and text can be recovered from a line, room and id are not part of it
+            LineFramer framer{pool, 4096};
+            const std::string line = "alice: " + text + "\n";
+            size_t count = pool.getChunkSize() / line.size() - 1;
+            m_report("protocol/parse text line", measure(m_batches(200), count, [&] { m_fill(framer, line, count); }, [&](size_t) {
+                         std::string_view extracted;
+                         framer.nextLine(extracted);
+                         size_t separator = extracted.find(": ");
+                         std::string_view sender = extracted.substr(0, separator);
+                         std::string_view body = extracted.substr(separator + 2);
+                         keep(sender);
+                         keep(body);
+                     }));
+        }
+        if (m_selected("protocol/parse binary frame")) {
+            LineFramer framer{pool, 4096};
+            FrameHeader header;
+            header.type = FrameType::CHAT;
+            header.senderId = 42;
+            header.messageId = 1000;
+            std::string frame;
+            appendFrame(frame, header, "lobby", "alice", text);
+            size_t count = pool.getChunkSize() / frame.size() - 1;
+            m_report("protocol/parse binary frame", measure(m_batches(200), count, [&] { m_fill(framer, frame, count); }, [&](size_t) {
+                         FrameHeader parsed;
+                         std::string_view payload;
+                         framer.nextFrame(parsed, payload);
+                         std::string_view room = parsed.getRoom(payload);
+                         std::string_view sender = parsed.getSender(payload);
+                         std::string_view body = parsed.getText(payload);
+                         keep(parsed);
+                         keep(room);
+                         keep(sender);
+                         keep(body);
+                     }));
+        }
+
+        // A notice for a single connection (e.g. 'You are now in room ...')
+        const std::string notice = "You are now in room lobby";
+        if (m_selected("protocol/encode notice (colorizeText)")) {
+            // Previous implementation: label, colors and line break added with temporary strings
+            m_report("protocol/encode notice (colorizeText)", measure(m_batches(200), 1000, [] {}, [&](size_t) {
+                         std::string encoded = colorizeText(">>> " + notice, TextColor::SERVER_NOTIFICATION) + "\n";
+                         keep(encoded);
+                     }));
+        }
+        if (m_selected("protocol/encode notice (text)")) {
+            m_report("protocol/encode notice (text)", measure(m_batches(200), 1000, [] {}, [&](size_t) {
+                         std::string encoded = decorateText(notice, TextColor::SERVER_NOTIFICATION);
+                         keep(encoded);
+                     }));
+        }
+        if (m_selected("protocol/encode notice (binary)")) {
+            FrameHeader header;
+            header.type = FrameType::NOTICE;
+            header.flags = static_cast<uint8_t>(TextColor::SERVER_NOTIFICATION);
+            std::string encoded;
+            m_report("protocol/encode notice (binary)", measure(m_batches(200), 1000, [] {}, [&](size_t) {
+                         encoded.clear();
+                         appendFrame(encoded, header, {}, {}, notice);
+                         keep(encoded);
+                     }));
+        }
+
+        // A chat message as created once per message and shared by all recipients
+        const MessageRef room = MessageBuffer::create({"lobby"});
+        const MessageRef prefix = MessageBuffer::create({"alice: "});
+        if (m_selected("protocol/chat message (text)")) {
+            m_report("protocol/chat message (text)", measure(m_batches(200), 1000, [] {}, [&](size_t opIdx) {
+                         WireMessage message = WireMessage::chat(room, prefix, 42, text, opIdx);
+                         keep(message.text());
+                     }));
+        }
+        if (m_selected("protocol/chat message (text + binary)")) {
+            m_report("protocol/chat message (text + binary)", measure(m_batches(200), 1000, [] {}, [&](size_t opIdx) {
+                         WireMessage message = WireMessage::chat(room, prefix, 42, text, opIdx);
+                         keep(message.text());
+                         keep(message.binary());
+                     }));
+        }
+    }
+
+    void compression() {
+        if (!m_selected("compression")) {
+            return;
+        }
+        // A history replay of 25 chat messages, sent as one batch
+        std::string frames;
+        FrameHeader header;
+        header.type = FrameType::HISTORY;
+        for (size_t messageIdx = 0; messageIdx < 25; messageIdx++) {
+            appendFrame(frames, header, "lobby", messageIdx % 3 == 0 ? "alice" : "bobby", "message number " + std::to_string(messageIdx) + ", has anyone seen the release notes of the new version?");
+        }
+        std::string compressed;
+        appendCompressedFrame(compressed, frames);
+        // The ratio is part of the name, e.g. 'compression/history (8.1x)'
+        char ratio[16];
+        std::snprintf(ratio, sizeof(ratio), " (%.1fx)", static_cast<double>(frames.size()) / compressed.size());
+
+        if (m_selected("compression/compress history")) {
+            std::string out;
+            m_report(std::string("compression/compress history") + ratio, measure(m_batches(20), 100, [] {}, [&](size_t) {
+                         out.clear();
+                         keep(appendCompressedFrame(out, frames));
+                     }));
+        }
+        if (m_selected("compression/decompress history")) {
+            FrameHeader compressedHeader = readFrameHeader(compressed.data());
+            std::string_view payload = std::string_view(compressed).substr(FrameHeader::SIZE);
+            std::string out;
+            m_report("compression/decompress history", measure(m_batches(20), 100, [] {}, [&](size_t) {
+                         out.clear();
+                         keep(decompressFrames(compressedHeader, payload, out, frames.size()));
+                     }));
+        }
+
+        // Fan-out to a compressing client: large messages are compressed once, small ones only cost the size check
+        const MessageRef room = MessageBuffer::create({"lobby"});
+        const MessageRef prefix = MessageBuffer::create({"alice: "});
+        const std::string paste = frames.substr(0, 1024);
+        if (m_selected("compression/chat message (small)")) {
+            m_report("compression/chat message (small)", measure(m_batches(200), 1000, [] {}, [&](size_t opIdx) {
+                         WireMessage message = WireMessage::chat(room, prefix, 42, "see you tomorrow", opIdx);
+                         keep(message.compressed(256));
+                     }));
+        }
+        if (m_selected("compression/chat message (1 KiB)")) {
+            m_report("compression/chat message (1 KiB)", measure(m_batches(20), 100, [] {}, [&](size_t opIdx) {
+                         WireMessage message = WireMessage::chat(room, prefix, 42, paste, opIdx);
+                         keep(message.compressed(256));
+                     }));
+        }
+    }
+
+    void fanOut() {
+        if (!m_selected("fanout/deliverLocal")) {
+            return;
+        }
+        // Same loop as Server::deliverLocal over 100 connections, one operation is a broadcast to 99 recipients
+        BufferPool pool{8192};
+        ConnectionSlab connections;
+        std::vector<int> peerFds;
+        ConnectionHandle sender;
+        for (unsigned int clientIdx = 0; clientIdx < 100; clientIdx++) {
+            TCPSocket socket;
+            peerFds.push_back(m_socketPair(socket));
+            UserData clientData(clientIdx + 1, "user" + std::to_string(clientIdx), "");
+            Connection connection{std::move(socket), clientData, pool};
+            connection.setClientData(clientData);
+            ConnectionHandle handle = connections.insert(std::move(connection));
+            connections.setState(handle.index, ConnectionSlab::State::APPROVED);
+            if (clientIdx == 0) {
+                sender = handle;
+            }
+        }
+        const MessageRef prefix = connections.get(sender)->getSenderPrefix();
+        const std::string message = "The quick brown fox jumps over the lazy dog, a typical chat message\n";
+
+        m_report("fanout/deliverLocal (99 recipients)", measure(
+                                                           m_batches(100), 16,
+                                                           [&] {
+                                                               for (int fd : peerFds) {
+                                                                   m_drain(fd);
+                                                               }
+                                                           },
+                                                           [&](size_t) {
+                                                               MessageRef segments[] = {prefix, MessageBuffer::create({message})};
+                                                               connections.forEach(ConnectionSlab::State::APPROVED, [&](ConnectionHandle handle, Connection& connection) {
+                                                                   if (handle != sender) {
+                                                                       connection.send(segments);
+                                                                   }
+                                                               });
+                                                           }));
+        for (int fd : peerFds) {
+            close(fd);
+        }
+    }
+
+    void receive() {
+        const size_t messageSize = 1024;
+        const size_t batchSize = 64;
+        const std::string message(messageSize, 'x');
+        TCPSocket socket;
+        int peerFd = m_socketPair(socket);
+        auto fill = [&] {
+            for (size_t messageIdx = 0; messageIdx < batchSize; messageIdx++) {
+                [[maybe_unused]] ssize_t written = ::send(peerFd, message.data(), message.size(), 0);
+            }
+        };
+
+        if (m_selected("recv/TCPSocket::recv")) {
+            m_report("recv/TCPSocket::recv (1 KiB)", measure(m_batches(200), batchSize, fill, [&](size_t) {
+                         std::string data = socket.recv(messageSize);
+                         keep(data);
+                     }));
+        }
+        if (m_selected("recv/TCPSocket::recvSome")) {
+            char buffer[messageSize];
+            m_report("recv/TCPSocket::recvSome (1 KiB)", measure(m_batches(200), batchSize, fill, [&](size_t) {
+                         ssize_t received = socket.recvSome(buffer, sizeof(buffer));
+                         keep(received);
+                     }));
+        }
+        close(peerFd);
+    }
+
+    void database() {
+        if (!m_selected("database")) {
+            return;
+        }
+        const size_t users = 10000;
+        UserCache userCache{users};
+        UserDatabase uncached{":memory:"};
+        UserDatabase cached{":memory:", &userCache};
+        for (size_t userIdx = 0; userIdx < users; userIdx++) {
+            UserData userData(userIdx + 1, "user" + std::to_string(userIdx), "pbkdf2-sha256$100000$0123456789abcdef0123456789abcdef$0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef");
+            uncached.insert(userData);
+            cached.insert(userData);
+        }
+        std::vector<std::string> names;
+        for (size_t nameIdx = 0; nameIdx < 1000; nameIdx++) {
+            names.push_back("user" + std::to_string(nameIdx * 7919 % users));
+        }
+
+        if (m_selected("database/findByName (SQLite)")) {
+            m_report("database/findByName (SQLite)", measure(m_batches(20), names.size(), [] {}, [&](size_t opIdx) {
+                         UserData userData = uncached.findByName(names[opIdx]);
+                         keep(userData);
+                     }));
+        }
+        if (m_selected("database/findByName (UserCache)")) {
+            m_report("database/findByName (UserCache)", measure(m_batches(20), names.size(), [] {}, [&](size_t opIdx) {
+                         UserData userData = cached.findByName(names[opIdx]);
+                         keep(userData);
+                     }));
+        }
+    }
+
+    void userData() {
+        const std::string name = "someone";
+        const std::string password = "pbkdf2-sha256$100000$0123456789abcdef0123456789abcdef$0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+        if (m_selected("userdata/construct")) {
+            m_report("userdata/construct", measure(m_batches(200), 1000, [] {}, [&](size_t opIdx) {
+                         UserData userData(opIdx, name, password);
+                         keep(userData);
+                     }));
+        }
+        if (m_selected("userdata/copy")) {
+            const UserData original(1, name, password);
+            m_report("userdata/copy", measure(m_batches(200), 1000, [] {}, [&](size_t) {
+                         UserData copy = original;
+                         keep(copy);
+                     }));
+        }
+    }
+
+    void metrics() {
+        Metrics metrics;
+        metrics.registerThread();
+        if (m_selected("metrics/count")) {
+            m_report("metrics/count", measure(m_batches(200), 1000, [] {}, [&](size_t opIdx) { Metrics::count(Counter::BYTES_SENT, opIdx); }));
+        }
+        if (m_selected("metrics/record")) {
+            m_report("metrics/record", measure(m_batches(200), 1000, [] {}, [&](size_t opIdx) { Metrics::record(Histogram::OUTBOUND_QUEUE_BYTES, opIdx * 7919); }));
+        }
+        if (m_selected("metrics/scoped latency")) {
+            m_report("metrics/scoped latency", measure(m_batches(200), 1000, [] {}, [&](size_t) { ScopedLatency latency(Histogram::LOOP_ITERATION_NS); }));
+        }
+        keep(metrics.snapshot().counters);
+    }
+
+    void admission() {
+        // A reconnect storm from many addresses, the table grows and purges refilled buckets
+        if (m_selected("admission/distinct addresses")) {
+            ConnectionAdmission admission{20, 100};
+            m_report("admission/distinct addresses", measure(m_batches(200), 1000, [] {}, [&](size_t opIdx) { keep(admission.admit(htonl(0x0A000000 + opIdx % 100000))); }));
+        }
+        // A single address exceeding its limit
+        if (m_selected("admission/repeated address")) {
+            ConnectionAdmission admission{20, 100};
+            m_report("admission/repeated address", measure(m_batches(200), 1000, [] {}, [&](size_t) { keep(admission.admit(htonl(0x7F000001))); }));
+        }
+    }
+
+    void timers() {
+        // Keepalive of 100k connections: every input moves the timer of its connection
+        TimerWheel wheel{std::chrono::milliseconds(100)};
+        TimerWheel::Clock::time_point start = TimerWheel::Clock::now();
+        std::vector<TimerHandle> handles(100000);
+        for (size_t timerIdx = 0; timerIdx < handles.size(); timerIdx++) {
+            handles[timerIdx] = wheel.schedule(start + std::chrono::seconds(30 + timerIdx % 60), timerIdx);
+        }
+        if (m_selected("timers/reschedule")) {
+            m_report("timers/reschedule", measure(m_batches(200), 1000, [] {}, [&](size_t opIdx) {
+                         TimerHandle& handle = handles[(opIdx * 7919) % handles.size()];
+                         wheel.cancel(handle);
+                         handle = wheel.schedule(start + std::chrono::seconds(30 + opIdx % 60), opIdx);
+                     }));
+        }
+        if (m_selected("timers/expire idle")) {
+            m_report("timers/expire idle", measure(m_batches(200), 1000, [] {}, [&](size_t) { keep(wheel.expire(TimerWheel::Clock::now(), [](uint64_t) {})); }));
+        }
+    }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string filter;
+    double scale = 1;
+    for (int argIdx = 1; argIdx + 1 < argc; argIdx += 2) {
+        std::string option = argv[argIdx];
+        if (option == "--filter") {
+            filter = argv[argIdx + 1];
+        } else if (option == "--scale") {
+            scale = std::stod(argv[argIdx + 1]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--filter SUBSTRING] [--scale FACTOR]" << std::endl;
+            return 1;
+        }
+    }
+    if (argc % 2 == 0 || scale <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [--filter SUBSTRING] [--scale FACTOR]" << std::endl;
+        return 1;
+    }
+
+    MicroBench bench{filter, scale};
+    std::cout << std::left << std::setw(36) << "benchmark" << std::right << std::setw(12) << "ns/op" << std::setw(14) << "cycles/op" << std::setw(12) << "allocs/op" << std::endl;
+    bench.colorize();
+    bench.framing();
+    bench.protocol();
+    bench.compression();
+    bench.fanOut();
+    bench.receive();
+    bench.database();
+    bench.userData();
+    bench.metrics();
+    bench.admission();
+    bench.timers();
+    return 0;
+}
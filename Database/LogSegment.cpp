@@ -0,0 +1,178 @@
+#include "LogSegment.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+LogSegment::LogSegment(const std::filesystem::path& directory, uint64_t firstId, size_t capacity) : m_path{pathFor(directory, firstId)},
+                                                                                                     m_indexPath{m_path},
+                                                                                                     m_fd{-1},
+                                                                                                     m_indexFd{-1},
+                                                                                                     m_data{nullptr},
+                                                                                                     m_capacity{0},
+                                                                                                     m_firstId{firstId},
+                                                                                                     m_end{0} {
+    m_indexPath.replace_extension(".idx");
+    auto fail = [this](const std::string& message) {
+        int error = errno;
+        if (m_data != nullptr) {
+            munmap(const_cast<char*>(m_data), m_capacity);
+        }
+        if (m_indexFd != -1) {
+            close(m_indexFd);
+        }
+        if (m_fd != -1) {
+            close(m_fd);
+        }
+        throw std::runtime_error(message + " " + m_path.string() + ", errno: " + std::to_string(error));
+    };
+
+    m_fd = open(m_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd == -1) {
+        fail("Failed to open log segment");
+    }
+    struct stat fileStat;
+    if (fstat(m_fd, &fileStat) != 0) {
+        fail("Failed to stat log segment");
+    }
+    m_capacity = fileStat.st_size;
+    if (m_capacity == 0) {
+        if (ftruncate(m_fd, capacity) != 0) {
+            fail("Failed to allocate log segment");
+        }
+        m_capacity = capacity;
+    }
+    void* mapping = mmap(nullptr, m_capacity, PROT_READ, MAP_SHARED, m_fd, 0);
+    if (mapping == MAP_FAILED) {
+        fail("Failed to map log segment");
+    }
+    m_data = static_cast<const char*>(mapping);
+
+    m_indexFd = open(m_indexPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_indexFd == -1) {
+        fail("Failed to open log index of");
+    }
+    IndexEntry entry;
+    while (::read(m_indexFd, &entry, sizeof(entry)) == sizeof(entry)) {
+        m_index.push_back(entry);
+    }
+    if (!m_recover()) {
+        fail("Failed to rewrite the log index of");
+    }
+}
+
+LogSegment::~LogSegment() {
+    munmap(const_cast<char*>(m_data), m_capacity);
+    close(m_indexFd);
+    close(m_fd);
+}
+
+bool LogSegment::m_recover() {
+    size_t dataEnd = m_capacity;
+    while (dataEnd > 0 && m_data[dataEnd - 1] == '\0') {
+        dataEnd--;
+    }
+    // A line that was only partially written before a crash is dropped and overwritten with zeros
+    m_end = dataEnd;
+    while (m_end > 0 && m_data[m_end - 1] != '\n') {
+        m_end--;
+    }
+    if (m_end < dataEnd) {
+        std::vector<char> zeros(dataEnd - m_end, '\0');
+        [[maybe_unused]] ssize_t written = pwrite(m_fd, zeros.data(), zeros.size(), m_end);
+    }
+
+    // Entries of lost messages are dropped, data without an index gets a first entry of unknown time
+    size_t indexSize = m_index.size();
+    std::erase_if(m_index, [this](const IndexEntry& entry) { return entry.offset >= m_end; });
+    bool rewrite = m_index.size() != indexSize;
+    if (m_end > 0 && (m_index.empty() || m_index.front().offset != 0)) {
+        m_index.insert(m_index.begin(), IndexEntry{m_firstId, 0, 0});
+        rewrite = true;
+    }
+    off_t indexBytes = m_index.size() * sizeof(IndexEntry);
+    if (rewrite && (ftruncate(m_indexFd, 0) != 0 || pwrite(m_indexFd, m_index.data(), indexBytes, 0) != indexBytes)) {
+        return false;
+    }
+    return lseek(m_indexFd, indexBytes, SEEK_SET) == indexBytes;
+}
+
+std::filesystem::path LogSegment::pathFor(const std::filesystem::path& directory, uint64_t firstId) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%020llu.log", static_cast<unsigned long long>(firstId));
+    return directory / name;
+}
+
+size_t LogSegment::offsetOf(uint64_t id) const {
+    // Start at the closest indexed message and skip the lines in between
+    auto it = std::upper_bound(m_index.begin(), m_index.end(), id, [](uint64_t id, const IndexEntry& entry) { return id < entry.id; });
+    if (it == m_index.begin()) {
+        return 0;
+    }
+    --it;
+    size_t offset = it->offset;
+    for (uint64_t current = it->id; current < id && offset < m_end; current++) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(m_data + offset, '\n', m_end - offset));
+        if (lineEnd == nullptr) {
+            return m_end;
+        }
+        offset = lineEnd - m_data + 1;
+    }
+    return offset;
+}
+
+uint64_t LogSegment::countFrom(size_t offset) const {
+    return std::count(m_data + offset, m_data + m_end, '\n');
+}
+
+bool LogSegment::writeIndex(const std::vector<IndexEntry>& entries) {
+    ssize_t bytes = entries.size() * sizeof(IndexEntry);
+    return entries.empty() || ::write(m_indexFd, entries.data(), bytes) == bytes;
+}
+
+void LogSegment::commit(size_t end, const std::vector<IndexEntry>& entries) {
+    m_end = end;
+    m_index.insert(m_index.end(), entries.begin(), entries.end());
+}
+
+bool LogSegment::sync() {
+    return fdatasync(m_fd) == 0 && fdatasync(m_indexFd) == 0;
+}
+
+void LogSegment::unlink() {
+    std::error_code error;
+    std::filesystem::remove(m_path, error);
+    std::filesystem::remove(m_indexPath, error);
+}
+
+int LogSegment::getFd() const {
+    return m_fd;
+}
+
+uint64_t LogSegment::getFirstId() const {
+    return m_firstId;
+}
+
+size_t LogSegment::getCapacity() const {
+    return m_capacity;
+}
+
+size_t LogSegment::getEnd() const {
+    return m_end;
+}
+
+const std::vector<LogSegment::IndexEntry>& LogSegment::getIndex() const {
+    return m_index;
+}
+
+std::string_view LogSegment::view(size_t offset, size_t length) const {
+    return std::string_view(m_data + offset, length);
+}
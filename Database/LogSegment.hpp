@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+/*
+ * Fixed-size file holding a consecutive range of the messages of a room, see MessageLog
+ * The file is allocated at its full size and mapped read-only. Messages are stored exactly as clients receive them,
+ * one line each, so a range of messages can be sent to a socket without being parsed or copied. The unused rest of
+ * the file is zero, the first zero byte after the last line ends the data.
+ * Next to the data file, an index file holds an entry for every n-th message (id, time and offset).
+ */
+class LogSegment {
+   public:
+    struct IndexEntry {
+        uint64_t id;
+        // Microseconds since the epoch, 0 if unknown
+        int64_t timestampUs;
+        uint64_t offset;
+    };
+
+   private:
+    std::filesystem::path m_path;
+    std::filesystem::path m_indexPath;
+    int m_fd;
+    int m_indexFd;
+    const char* m_data;
+    size_t m_capacity;
+    uint64_t m_firstId;
+
+    // Bytes of complete messages, only these are visible to readers
+    size_t m_end;
+
+    // Sparse index, ordered by id and offset
+    std::vector<IndexEntry> m_index;
+
+    /*
+     * Recovers the end of the data and drops index entries beyond it
+     * @return false if the index file could not be rewritten
+     */
+    bool m_recover();
+
+   public:
+    /*
+     * Opens the segment of a room starting with the given message id, the files are created if they do not exist
+     * Throws a runtime_error if the files can not be created or mapped.
+     * @param directory - directory of the room's log
+     * @param firstId - id of the first message in the segment
+     * @param capacity - size of a new segment file, existing files keep their size
+     */
+    LogSegment(const std::filesystem::path& directory, uint64_t firstId, size_t capacity);
+    LogSegment(const LogSegment& other) = delete;
+    ~LogSegment();
+
+    LogSegment& operator=(const LogSegment& other) = delete;
+
+    /*
+     * Path of the data file for the given first message id, the index file has the extension '.idx'
+     */
+    static std::filesystem::path pathFor(const std::filesystem::path& directory, uint64_t firstId);
+
+    /*
+     * Returns the offset of a message, which must be part of this segment
+     */
+    size_t offsetOf(uint64_t id) const;
+
+    /*
+     * Number of messages stored behind the given offset
+     */
+    uint64_t countFrom(size_t offset) const;
+
+    /*
+     * Appends entries to the index file, called by the writer before committing them
+     * @return false if the entries could not be written
+     */
+    bool writeIndex(const std::vector<IndexEntry>& entries);
+
+    /*
+     * Makes data written with pwrite and the given index entries visible to readers
+     * Only called by the writer, with the MessageLog's lock held.
+     */
+    void commit(size_t end, const std::vector<IndexEntry>& entries);
+
+    /*
+     * Flushes the data and index file to disk
+     */
+    bool sync();
+
+    /*
+     * Deletes both files, the mapping stays valid until the segment is destroyed
+     */
+    void unlink();
+
+    int getFd() const;
+    uint64_t getFirstId() const;
+    size_t getCapacity() const;
+    size_t getEnd() const;
+    const std::vector<IndexEntry>& getIndex() const;
+    std::string_view view(size_t offset, size_t length) const;
+};
@@ -0,0 +1,355 @@
+#include "MessageLog.hpp"
+
+#include <limits.h>
+#include <poll.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+#include "../Logging/Logger.hpp"
+
+MessageLog::MessageLog(const MessageLogOptions& options) : m_options{options},
+                                                           m_stopping{false} {
+    m_load();
+    m_writer = std::thread(&MessageLog::m_run, this);
+}
+
+MessageLog::~MessageLog() {
+    stop();
+}
+
+void MessageLog::m_load() {
+    std::error_code error;
+    std::filesystem::create_directories(m_options.directory, error);
+    if (error) {
+        throw std::runtime_error("Failed to create history directory " + m_options.directory + ": " + error.message());
+    }
+
+    for (const auto& roomEntry : std::filesystem::directory_iterator(m_options.directory)) {
+        if (!roomEntry.is_directory()) {
+            continue;
+        }
+        std::vector<uint64_t> firstIds;
+        for (const auto& fileEntry : std::filesystem::directory_iterator(roomEntry.path())) {
+            const std::filesystem::path& path = fileEntry.path();
+            std::string stem = path.stem().string();
+            if (path.extension() != ".log" || stem.empty() || !std::all_of(stem.begin(), stem.end(), ::isdigit)) {
+                continue;
+            }
+            firstIds.push_back(std::stoull(stem));
+        }
+        if (firstIds.empty()) {
+            continue;
+        }
+        std::sort(firstIds.begin(), firstIds.end());
+
+        RoomLog log{roomEntry.path(), {}, 0};
+        for (uint64_t firstId : firstIds) {
+            log.segments.push_back(std::make_shared<LogSegment>(log.directory, firstId, m_options.segmentSize));
+        }
+        const LogSegment& last = *log.segments.back();
+        const std::vector<LogSegment::IndexEntry>& index = last.getIndex();
+        log.nextId = index.empty() ? last.getFirstId() : index.back().id + last.countFrom(index.back().offset);
+        m_rooms.emplace(roomEntry.path().filename().string(), std::move(log));
+    }
+    if (!m_rooms.empty()) {
+        Logger::info("Loaded the history of ", m_rooms.size(), " room(s)");
+    }
+}
+
+void MessageLog::append(const MessageRef& room, std::span<const MessageRef> segments) {
+    Record record;
+    record.room = room;
+    record.segmentCount = std::min(segments.size(), record.segments.size());
+    std::copy_n(segments.begin(), record.segmentCount, record.segments.begin());
+    record.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    m_records.post(std::move(record));
+}
+
+void MessageLog::stop() {
+    if (!m_writer.joinable()) {
+        return;
+    }
+    m_stopping = true;
+    // Records without a room only wake the writer up
+    m_records.post(Record{});
+    m_writer.join();
+}
+
+void MessageLog::m_run() {
+    Logger::setThreadName("history");
+    std::vector<Record> batch;
+    while (true) {
+        int timeout = -1;
+        if (!m_unsynced.empty()) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(m_nextSync - std::chrono::steady_clock::now());
+            timeout = std::max<int>(0, remaining.count());
+        }
+        pollfd mailbox{m_records.getFd(), POLLIN, 0};
+        poll(&mailbox, 1, timeout);
+
+        // Reading the flag before draining guarantees that everything posted before stop() is written
+        bool stopping = m_stopping;
+        m_records.drain([&batch](Record record) {
+            batch.push_back(std::move(record));
+        });
+        m_write(batch);
+        batch.clear();
+
+        if (!m_unsynced.empty() && (stopping || std::chrono::steady_clock::now() >= m_nextSync)) {
+            m_sync();
+        }
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+void MessageLog::m_write(std::vector<Record>& batch) {
+    // Group the batch by room, keeping the order of every room's messages
+    std::stable_sort(batch.begin(), batch.end(), [](const Record& a, const Record& b) {
+        return a.room.view() < b.room.view();
+    });
+    std::vector<const Record*> records;
+    for (size_t begin = 0; begin < batch.size();) {
+        std::string_view room = batch[begin].room.view();
+        records.clear();
+        size_t end = begin;
+        for (; end < batch.size() && batch[end].room.view() == room; end++) {
+            records.push_back(&batch[end]);
+        }
+        begin = end;
+        if (room.empty()) {
+            continue;
+        }
+        RoomLog* log = m_roomLog(room);
+        if (log != nullptr) {
+            m_writeRoom(*log, records);
+        }
+    }
+}
+
+MessageLog::RoomLog* MessageLog::m_roomLog(std::string_view room) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_rooms.find(room);
+        if (it != m_rooms.end()) {
+            return &it->second;
+        }
+    }
+    std::filesystem::path directory = std::filesystem::path(m_options.directory) / room;
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        Logger::error("Failed to create history directory ", directory.string(), ": ", error.message());
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return &m_rooms.emplace(std::string(room), RoomLog{directory, {}, 0}).first->second;
+}
+
+void MessageLog::m_writeRoom(RoomLog& log, std::span<const Record* const> records) {
+    std::shared_ptr<LogSegment> segment = log.segments.empty() ? nullptr : log.segments.back();
+    size_t offset = segment ? segment->getEnd() : 0;
+    size_t bytes = 0;
+    uint64_t messages = 0;
+    std::vector<iovec> iov;
+    std::vector<LogSegment::IndexEntry> entries;
+
+    auto flush = [&]() {
+        if (messages > 0) {
+            m_writeSegment(log, segment, iov, offset, bytes, messages, entries);
+        }
+        iov.clear();
+        entries.clear();
+        offset = segment ? segment->getEnd() : 0;
+        bytes = 0;
+        messages = 0;
+    };
+
+    for (const Record* record : records) {
+        size_t size = 0;
+        for (size_t i = 0; i < record->segmentCount; i++) {
+            size += record->segments[i].size();
+        }
+        if (size == 0 || size > m_options.segmentSize) {
+            continue;
+        }
+        if (!segment || offset + bytes + size > segment->getCapacity() || iov.size() + record->segmentCount > IOV_MAX) {
+            bool full = !segment || offset + bytes + size > segment->getCapacity();
+            flush();
+            if (full) {
+                segment = m_startSegment(log);
+                if (!segment) {
+                    return;
+                }
+                offset = 0;
+            }
+        }
+
+        uint64_t id = log.nextId + messages;
+        if (offset + bytes == 0 || id % m_indexInterval == 0) {
+            entries.push_back(LogSegment::IndexEntry{id, record->timestampUs, offset + bytes});
+        }
+        for (size_t i = 0; i < record->segmentCount; i++) {
+            iov.push_back(iovec{const_cast<char*>(record->segments[i].data()), record->segments[i].size()});
+        }
+        bytes += size;
+        messages++;
+    }
+    flush();
+}
+
+bool MessageLog::m_writeSegment(RoomLog& log, const std::shared_ptr<LogSegment>& segment, std::vector<iovec>& iov, size_t offset, size_t bytes, uint64_t messages, std::vector<LogSegment::IndexEntry>& entries) {
+    // One pwritev for the whole batch, continued after partial writes
+    size_t written = 0;
+    size_t first = 0;
+    while (written < bytes) {
+        ssize_t result = pwritev(segment->getFd(), iov.data() + first, iov.size() - first, offset + written);
+        if (result <= 0) {
+            if (result == -1 && errno == EINTR) {
+                continue;
+            }
+            Logger::error("Failed to write the history, errno: ", errno);
+            return false;
+        }
+        written += result;
+        while (first < iov.size() && static_cast<size_t>(result) >= iov[first].iov_len) {
+            result -= iov[first].iov_len;
+            first++;
+        }
+        if (first < iov.size()) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + result;
+            iov[first].iov_len -= result;
+        }
+    }
+    if (!segment->writeIndex(entries)) {
+        Logger::error("Failed to write the history index, errno: ", errno);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        segment->commit(offset + bytes, entries);
+        log.nextId += messages;
+    }
+    if (m_unsynced.empty()) {
+        m_nextSync = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_options.syncIntervalMs);
+    }
+    if (std::find(m_unsynced.begin(), m_unsynced.end(), segment) == m_unsynced.end()) {
+        m_unsynced.push_back(segment);
+    }
+    return true;
+}
+
+std::shared_ptr<LogSegment> MessageLog::m_startSegment(RoomLog& log) {
+    std::shared_ptr<LogSegment> segment;
+    try {
+        segment = std::make_shared<LogSegment>(log.directory, log.nextId, m_options.segmentSize);
+    } catch (const std::runtime_error& error) {
+        Logger::error(error.what());
+        return nullptr;
+    }
+
+    std::shared_ptr<LogSegment> expired;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        log.segments.push_back(segment);
+        if (log.segments.size() > m_options.segmentsPerRoom) {
+            expired = std::move(log.segments.front());
+            log.segments.erase(log.segments.begin());
+        }
+    }
+    // Readers still holding ranges of the segment keep its mapping alive
+    if (expired) {
+        expired->unlink();
+    }
+    return segment;
+}
+
+void MessageLog::m_sync() {
+    for (const std::shared_ptr<LogSegment>& segment : m_unsynced) {
+        if (!segment->sync()) {
+            Logger::error("Failed to sync the history, errno: ", errno);
+        }
+    }
+    m_unsynced.clear();
+    m_nextSync = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_options.syncIntervalMs);
+}
+
+std::vector<MessageLog::Range> MessageLog::findLast(std::string_view room, size_t count) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_rooms.find(room);
+    if (it == m_rooms.end() || count == 0) {
+        return {};
+    }
+    const RoomLog& log = it->second;
+    return m_rangesFrom(log, log.nextId > count ? log.nextId - count : 0);
+}
+
+std::vector<MessageLog::Range> MessageLog::findFrom(std::string_view room, uint64_t firstId, size_t maxCount) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_rooms.find(room);
+    if (it == m_rooms.end() || maxCount == 0) {
+        return {};
+    }
+    const RoomLog& log = it->second;
+    if (log.nextId > maxCount) {
+        firstId = std::max(firstId, log.nextId - maxCount);
+    }
+    return m_rangesFrom(log, firstId);
+}
+
+uint64_t MessageLog::getNextId(std::string_view room) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_rooms.find(room);
+    return it != m_rooms.end() ? it->second.nextId : 0;
+}
+
+std::vector<MessageLog::Range> MessageLog::findSince(std::string_view room, std::chrono::system_clock::time_point since, size_t maxCount) const {
+    int64_t timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(since.time_since_epoch()).count();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_rooms.find(room);
+    if (it == m_rooms.end() || maxCount == 0 || it->second.segments.empty()) {
+        return {};
+    }
+    const RoomLog& log = it->second;
+
+    // The messages between two index entries are only known to be no older than the first of them, so the search
+    // starts at the last entry older than the given time
+    uint64_t firstId = log.segments.front()->getFirstId();
+    for (const std::shared_ptr<LogSegment>& segment : log.segments) {
+        const std::vector<LogSegment::IndexEntry>& index = segment->getIndex();
+        auto newer = std::partition_point(index.begin(), index.end(), [timestampUs](const LogSegment::IndexEntry& entry) {
+            return entry.timestampUs < timestampUs;
+        });
+        if (newer != index.begin()) {
+            firstId = std::prev(newer)->id;
+        }
+        if (newer != index.end()) {
+            break;
+        }
+    }
+    if (log.nextId > maxCount) {
+        firstId = std::max(firstId, log.nextId - maxCount);
+    }
+    return m_rangesFrom(log, firstId);
+}
+
+std::vector<MessageLog::Range> MessageLog::m_rangesFrom(const RoomLog& log, uint64_t firstId) const {
+    std::vector<Range> ranges;
+    for (size_t i = 0; i < log.segments.size(); i++) {
+        const std::shared_ptr<LogSegment>& segment = log.segments[i];
+        uint64_t nextFirstId = i + 1 < log.segments.size() ? log.segments[i + 1]->getFirstId() : log.nextId;
+        if (nextFirstId <= firstId) {
+            continue;
+        }
+        bool skipped = firstId > segment->getFirstId();
+        size_t offset = skipped ? segment->offsetOf(firstId) : 0;
+        if (segment->getEnd() > offset) {
+            ranges.push_back(Range{segment, offset, segment->getEnd() - offset, skipped ? firstId : segment->getFirstId()});
+        }
+    }
+    return ranges;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../Networking/Mailbox.hpp"
+#include "../Networking/MessageBuffer.hpp"
+#include "LogSegment.hpp"
+
+struct MessageLogOptions {
+    // Directory holding one subdirectory per room
+    std::string directory = std::filesystem::current_path().string() + "/history";
+
+    // Size of a segment file, the longest message has to fit into one
+    size_t segmentSize = 1024 * 1024;
+
+    // Segments kept per room, the oldest one is deleted when another one is started
+    size_t segmentsPerRoom = 16;
+
+    // Written messages are flushed to disk at most this long after they were written
+    unsigned int syncIntervalMs = 1000;
+};
+
+/*
+ * Persistent, append-only history of the messages of every room (thread-safe)
+ * Every room has its own sequence of message ids and its own directory of fixed-size LogSegments. The reactor
+ * threads only post the shared segments of a message to the writer thread, which appends whole batches with a single
+ * pwritev per segment file and flushes them to disk every sync interval. Readers get ranges of the mapped segment
+ * files, which can be sent to a socket with sendfile.
+ */
+class MessageLog {
+   public:
+    /*
+     * Consecutive messages within a segment, the segment stays mapped while the range is referenced
+     */
+    struct Range {
+        std::shared_ptr<const LogSegment> segment;
+        size_t offset;
+        size_t length;
+        // Id of the message at offset, the following ones are numbered consecutively
+        uint64_t firstId;
+    };
+
+   private:
+    struct Record {
+        MessageRef room;
+        std::array<MessageRef, 3> segments;
+        size_t segmentCount = 0;
+        int64_t timestampUs = 0;
+    };
+
+    struct RoomLog {
+        std::filesystem::path directory;
+        std::vector<std::shared_ptr<LogSegment>> segments;
+        // Id of the next message, only advanced once the message is committed
+        uint64_t nextId = 0;
+    };
+
+    // Allows looking rooms up by string_view without constructing a string
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const {
+            return std::hash<std::string_view>{}(name);
+        }
+    };
+
+    // Every n-th message of a segment gets an index entry
+    static constexpr uint64_t m_indexInterval = 64;
+
+    MessageLogOptions m_options;
+    Mailbox<Record> m_records;
+
+    // Guards the rooms, their segment lists, next ids and the committed part of the segments
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, RoomLog, NameHash, std::equal_to<>> m_rooms;
+
+    // Segments written since the last sync, only accessed by the writer thread
+    std::vector<std::shared_ptr<LogSegment>> m_unsynced;
+    std::chrono::steady_clock::time_point m_nextSync;
+
+    std::atomic<bool> m_stopping;
+    std::thread m_writer;
+
+    void m_load();
+    void m_run();
+    void m_write(std::vector<Record>& batch);
+    void m_writeRoom(RoomLog& log, std::span<const Record* const> records);
+    bool m_writeSegment(RoomLog& log, const std::shared_ptr<LogSegment>& segment, std::vector<iovec>& iov, size_t offset, size_t bytes, uint64_t messages, std::vector<LogSegment::IndexEntry>& entries);
+    std::shared_ptr<LogSegment> m_startSegment(RoomLog& log);
+    RoomLog* m_roomLog(std::string_view room);
+    void m_sync();
+    std::vector<Range> m_rangesFrom(const RoomLog& log, uint64_t firstId) const;
+
+   public:
+    /*
+     * Constructor, loads the existing history and starts the writer thread
+     * Throws a runtime_error if the directory or an existing segment can not be opened.
+     */
+    MessageLog(const MessageLogOptions& options);
+    MessageLog(const MessageLog& other) = delete;
+    ~MessageLog();
+
+    MessageLog& operator=(const MessageLog& other) = delete;
+
+    /*
+     * Queues a message for the writer thread without blocking, safe to call from any thread
+     * @param room - name of the room
+     * @param segments - segments of the message as it is sent to clients, ending with a newline (at most 3)
+     */
+    void append(const MessageRef& room, std::span<const MessageRef> segments);
+
+    /*
+     * Returns the ranges holding the last messages of a room, oldest first
+     */
+    std::vector<Range> findLast(std::string_view room, size_t count) const;
+
+    /*
+     * Returns the ranges holding the messages of a room starting with the given id, oldest first
+     * @param maxCount - only the latest maxCount messages are returned
+     */
+    std::vector<Range> findFrom(std::string_view room, uint64_t firstId, size_t maxCount) const;
+
+    /*
+     * Id the next message of a room will get, messages still queued for the writer are not counted
+     */
+    uint64_t getNextId(std::string_view room) const;
+
+    /*
+     * Returns the ranges holding the messages of a room sent since the given time, oldest first
+     * The index is sparse, so a few earlier messages might be included as well.
+     * @param maxCount - only the latest maxCount messages are returned
+     */
+    std::vector<Range> findSince(std::string_view room, std::chrono::system_clock::time_point since, size_t maxCount) const;
+
+    /*
+     * Writes and flushes all queued messages and stops the writer thread
+     */
+    void stop();
+};
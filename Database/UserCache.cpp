@@ -0,0 +1,200 @@
+#include "UserCache.hpp"
+
+#include <bit>
+#include <stdexcept>
+
+UserCache::UserCache(size_t capacity) : m_capacity{capacity},
+                                        m_slotMask{std::bit_ceil(std::max<size_t>(2 * capacity, 8)) - 1},
+                                        m_nameSlots(m_slotMask + 1, 0),
+                                        m_idSlots(m_slotMask + 1, 0),
+                                        m_lruHead{m_none},
+                                        m_lruTail{m_none},
+                                        m_size{0},
+                                        m_complete{false} {
+    if (m_capacity == 0 || m_capacity >= m_none) {
+        throw std::invalid_argument("Invalid user cache capacity " + std::to_string(capacity));
+    }
+}
+
+uint64_t UserCache::m_hashName(std::string_view name) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : name) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t UserCache::m_hashId(unsigned int id) {
+    // Fibonacci hashing, the high bits are mixed best
+    uint64_t hash = id * 11400714819323198485ull;
+    return hash ^ (hash >> 32);
+}
+
+uint32_t UserCache::m_findByName(std::string_view name, uint64_t nameHash) const {
+    for (size_t slotIdx = nameHash & m_slotMask; m_nameSlots[slotIdx] != 0; slotIdx = (slotIdx + 1) & m_slotMask) {
+        uint32_t entryIdx = m_nameSlots[slotIdx] - 1;
+        if (m_entries[entryIdx].nameHash == nameHash && m_entries[entryIdx].userData.getName() == name) {
+            return entryIdx;
+        }
+    }
+    return m_none;
+}
+
+uint32_t UserCache::m_findById(unsigned int id) const {
+    for (size_t slotIdx = m_hashId(id) & m_slotMask; m_idSlots[slotIdx] != 0; slotIdx = (slotIdx + 1) & m_slotMask) {
+        uint32_t entryIdx = m_idSlots[slotIdx] - 1;
+        if (m_entries[entryIdx].userData.getId() == id) {
+            return entryIdx;
+        }
+    }
+    return m_none;
+}
+
+size_t UserCache::m_findSlot(const std::vector<uint32_t>& slots, uint64_t hash, uint32_t entryIdx) const {
+    size_t slotIdx = hash & m_slotMask;
+    while (slots[slotIdx] != entryIdx + 1) {
+        slotIdx = (slotIdx + 1) & m_slotMask;
+    }
+    return slotIdx;
+}
+
+template <typename HashOf>
+void UserCache::m_eraseSlot(std::vector<uint32_t>& slots, size_t slotIdx, HashOf hashOf) {
+    size_t hole = slotIdx;
+    for (size_t next = (hole + 1) & m_slotMask; slots[next] != 0; next = (next + 1) & m_slotMask) {
+        // The entry may fill the hole unless its home slot lies cyclically between the hole and its current slot
+        size_t home = hashOf(slots[next] - 1) & m_slotMask;
+        if (((next - home) & m_slotMask) >= ((next - hole) & m_slotMask)) {
+            slots[hole] = slots[next];
+            hole = next;
+        }
+    }
+    slots[hole] = 0;
+}
+
+void UserCache::m_insertSlot(std::vector<uint32_t>& slots, uint64_t hash, uint32_t entryIdx) {
+    size_t slotIdx = hash & m_slotMask;
+    while (slots[slotIdx] != 0) {
+        slotIdx = (slotIdx + 1) & m_slotMask;
+    }
+    slots[slotIdx] = entryIdx + 1;
+}
+
+void UserCache::m_unlink(uint32_t entryIdx) {
+    Entry& entry = m_entries[entryIdx];
+    (entry.prev == m_none ? m_lruHead : m_entries[entry.prev].next) = entry.next;
+    (entry.next == m_none ? m_lruTail : m_entries[entry.next].prev) = entry.prev;
+}
+
+void UserCache::m_linkFront(uint32_t entryIdx) {
+    Entry& entry = m_entries[entryIdx];
+    entry.prev = m_none;
+    entry.next = m_lruHead;
+    (m_lruHead == m_none ? m_lruTail : m_entries[m_lruHead].prev) = entryIdx;
+    m_lruHead = entryIdx;
+}
+
+void UserCache::m_remove(uint32_t entryIdx) {
+    Entry& entry = m_entries[entryIdx];
+    m_eraseSlot(m_nameSlots, m_findSlot(m_nameSlots, entry.nameHash, entryIdx), [this](uint32_t idx) { return m_entries[idx].nameHash; });
+    m_eraseSlot(m_idSlots, m_findSlot(m_idSlots, m_hashId(entry.userData.getId()), entryIdx), [this](uint32_t idx) { return m_hashId(m_entries[idx].userData.getId()); });
+    m_unlink(entryIdx);
+    // Release the strings, the entry itself is reused
+    entry.userData = UserData::empty();
+    m_freeEntries.push_back(entryIdx);
+    m_size--;
+}
+
+void UserCache::m_insert(const UserData& userData) {
+    if (m_size == m_capacity) {
+        m_remove(m_lruTail);
+        m_complete = false;
+    }
+
+    uint64_t nameHash = m_hashName(userData.getName());
+    uint32_t entryIdx;
+    if (!m_freeEntries.empty()) {
+        entryIdx = m_freeEntries.back();
+        m_freeEntries.pop_back();
+        m_entries[entryIdx].userData = userData;
+        m_entries[entryIdx].nameHash = nameHash;
+    } else {
+        entryIdx = m_entries.size();
+        m_entries.push_back(Entry{userData, nameHash, m_none, m_none});
+    }
+    m_insertSlot(m_nameSlots, nameHash, entryIdx);
+    m_insertSlot(m_idSlots, m_hashId(userData.getId()), entryIdx);
+    m_linkFront(entryIdx);
+    m_size++;
+}
+
+UserData UserCache::findByName(std::string_view name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t entryIdx = m_findByName(name, m_hashName(name));
+    if (entryIdx == m_none) {
+        return UserData::empty();
+    }
+    m_unlink(entryIdx);
+    m_linkFront(entryIdx);
+    return m_entries[entryIdx].userData;
+}
+
+UserData UserCache::findById(unsigned int id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t entryIdx = m_findById(id);
+    if (entryIdx == m_none) {
+        return UserData::empty();
+    }
+    m_unlink(entryIdx);
+    m_linkFront(entryIdx);
+    return m_entries[entryIdx].userData;
+}
+
+void UserCache::put(const UserData& userData) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Replacing removes the old entry first, as the name may have changed
+    uint32_t entryIdx = m_findById(userData.getId());
+    if (entryIdx != m_none) {
+        m_remove(entryIdx);
+    }
+    entryIdx = m_findByName(userData.getName(), m_hashName(userData.getName()));
+    if (entryIdx != m_none) {
+        m_remove(entryIdx);
+    }
+    m_insert(userData);
+}
+
+void UserCache::putIfAbsent(const UserData& userData) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_findById(userData.getId()) == m_none && m_findByName(userData.getName(), m_hashName(userData.getName())) == m_none) {
+        m_insert(userData);
+    }
+}
+
+void UserCache::remove(unsigned int id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t entryIdx = m_findById(id);
+    if (entryIdx != m_none) {
+        m_remove(entryIdx);
+    }
+}
+
+bool UserCache::isComplete() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_complete;
+}
+
+void UserCache::setComplete(bool complete) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_complete = complete;
+}
+
+size_t UserCache::getSize() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_size;
+}
+
+size_t UserCache::getCapacity() const {
+    return m_capacity;
+}
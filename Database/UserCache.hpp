@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "UserData.hpp"
+
+/*
+ * Bounded in-memory index of users in front of the UserDatabase
+ * Users are found by name or id through two open addressing tables (linear probing) of entry indices. Both tables are
+ * sized for the capacity up front and never rehash. When the capacity is reached the least recently used user is
+ * evicted. As long as no user was evicted and the cache was warmed with the whole table, it is complete, so a name that
+ * is not cached does not exist either. Safe to use from multiple threads.
+ */
+class UserCache {
+   private:
+    static constexpr uint32_t m_none = UINT32_MAX;
+
+    struct Entry {
+        UserData userData;
+        uint64_t nameHash;
+        // Neighbours in the LRU list, m_none at its ends
+        uint32_t prev;
+        uint32_t next;
+    };
+
+    size_t m_capacity;
+    size_t m_slotMask;
+
+    std::vector<Entry> m_entries;
+    std::vector<uint32_t> m_freeEntries;
+
+    // Slots hold an entry index + 1, 0 marks an empty slot
+    std::vector<uint32_t> m_nameSlots;
+    std::vector<uint32_t> m_idSlots;
+
+    // Most and least recently used entry
+    uint32_t m_lruHead;
+    uint32_t m_lruTail;
+
+    size_t m_size;
+    bool m_complete;
+    mutable std::mutex m_mutex;
+
+    static uint64_t m_hashName(std::string_view name);
+    static uint64_t m_hashId(unsigned int id);
+
+    uint32_t m_findByName(std::string_view name, uint64_t nameHash) const;
+    uint32_t m_findById(unsigned int id) const;
+
+    /*
+     * Returns the slot of a table that refers to the entry
+     */
+    size_t m_findSlot(const std::vector<uint32_t>& slots, uint64_t hash, uint32_t entryIdx) const;
+
+    /*
+     * Empties a slot and moves later entries of its probe sequence back, so no tombstones are needed
+     * @param hashOf - returns the hash an entry is stored with in this table
+     */
+    template <typename HashOf>
+    void m_eraseSlot(std::vector<uint32_t>& slots, size_t slotIdx, HashOf hashOf);
+
+    void m_insertSlot(std::vector<uint32_t>& slots, uint64_t hash, uint32_t entryIdx);
+
+    void m_unlink(uint32_t entryIdx);
+    void m_linkFront(uint32_t entryIdx);
+
+    void m_remove(uint32_t entryIdx);
+    void m_insert(const UserData& userData);
+
+   public:
+    /*
+     * Constructor
+     * @param capacity - maximum number of cached users
+     */
+    UserCache(size_t capacity);
+    UserCache(const UserCache& other) = delete;
+
+    UserCache& operator=(const UserCache& other) = delete;
+
+    /*
+     * Looks a user up by name and marks it as recently used
+     * @return the user or UserData::empty() if it is not cached
+     */
+    UserData findByName(std::string_view name);
+
+    /*
+     * Looks a user up by id and marks it as recently used
+     * @return the user or UserData::empty() if it is not cached
+     */
+    UserData findById(unsigned int id);
+
+    /*
+     * Inserts or replaces a user, evicting the least recently used one if the cache is full
+     */
+    void put(const UserData& userData);
+
+    /*
+     * Inserts a user read from the database, unless it is cached already (a newer version written meanwhile wins)
+     */
+    void putIfAbsent(const UserData& userData);
+
+    void remove(unsigned int id);
+
+    /*
+     * Returns true while every user of the database is cached
+     */
+    bool isComplete() const;
+    void setComplete(bool complete);
+
+    size_t getSize() const;
+    size_t getCapacity() const;
+};
@@ -14,6 +14,14 @@ const std::string& UserData::getPassword() const {
     return m_password;
 }
 
+void UserData::setName(const std::string& name) {
+    m_name = name;
+}
+
+void UserData::setPassword(const std::string& password) {
+    m_password = password;
+}
+
 UserData UserData::empty() {
     return UserData(0, "", "");
 }
@@ -1,111 +1,190 @@
 #include "UserDatabase.hpp"
 
-#include <iostream>
+#include "../Logging/Logger.hpp"
 
-UserDatabase::UserDatabase(const std::string& path) {
-    std::cout << "Opening database at " << path << std::endl;
+UserDatabase::UserDatabase(const std::string& path, UserCache* cache) : m_statements{}, m_cache{cache} {
+    Logger::info("Opening database at ", path);
     int result = sqlite3_open(path.c_str(), &m_database);
     if (result != SQLITE_OK) {
-        std::cerr << "Failed to open database: " << sqlite3_errmsg(m_database) << std::endl;
+        Logger::error("Failed to open database: ", sqlite3_errmsg(m_database));
         sqlite3_close(m_database);
         exit(1);
     }
-    std::cout << "Database opened successfully" << std::endl;
+    Logger::info("Database opened successfully");
 
-    std::string createTableStmt = "CREATE TABLE IF NOT EXISTS users (id INTEGER PRIMARY KEY, name TEXT NOT NULL UNIQUE, password TEXT NOT NULL);";
+    // Every reactor thread uses its own connection, so concurrent writers wait for each other instead of failing
+    sqlite3_busy_timeout(m_database, m_busyTimeoutMs);
+
+    // WAL lets readers proceed during writes and, with synchronous=NORMAL, commits without an fsync per transaction.
+    // The page cache is raised to 8 MiB (negative values are KiB), so the users table stays in memory.
+    m_execute("PRAGMA journal_mode=WAL;");
+    m_execute("PRAGMA synchronous=NORMAL;");
+    m_execute("PRAGMA cache_size=-8192;");
+    m_execute("PRAGMA temp_store=MEMORY;");
+
+    m_execute("CREATE TABLE IF NOT EXISTS users (id INTEGER PRIMARY KEY, name TEXT NOT NULL UNIQUE, password TEXT NOT NULL);");
+
+    const std::array<std::string, STATEMENT_COUNT> statementSql = {
+        "INSERT INTO users (id, name, password) VALUES ($id, $name, $password);",
+        "UPDATE users SET name = $name, password = $password WHERE id = $id;",
+        "DELETE FROM users WHERE id = $id;",
+        "SELECT id, name, password FROM users WHERE id = $id;",
+        "SELECT id, name, password FROM users WHERE name = $name;",
+        "SELECT MAX(id) FROM users;",
+        "SELECT id, name, password FROM users ORDER BY id DESC;"};
+    for (size_t statementIdx = 0; statementIdx < STATEMENT_COUNT; statementIdx++) {
+        result = sqlite3_prepare_v3(m_database, statementSql[statementIdx].c_str(), statementSql[statementIdx].length(), SQLITE_PREPARE_PERSISTENT, &m_statements[statementIdx], nullptr);
+        if (result != SQLITE_OK) {
+            Logger::error("Failed to prepare statement '", statementSql[statementIdx], "': ", sqlite3_errmsg(m_database));
+            exit(1);
+        }
+    }
+}
+
+UserDatabase::~UserDatabase() {
+    for (sqlite3_stmt* stmt : m_statements) {
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(m_database);
+}
+
+sqlite3_stmt* UserDatabase::m_statement(Statement statement) {
+    sqlite3_stmt* stmt = m_statements[statement];
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return stmt;
+}
+
+void UserDatabase::m_execute(const std::string& sql) {
     char* errMsg;
-    result = sqlite3_exec(m_database, createTableStmt.c_str(), nullptr, nullptr, &errMsg);
+    int result = sqlite3_exec(m_database, sql.c_str(), nullptr, nullptr, &errMsg);
     if (result != SQLITE_OK) {
-        std::cerr << "Table 'users' does not exist and/or could not be created: " << errMsg << std::endl;
+        Logger::error("Failed to execute '", sql, "': ", errMsg);
         sqlite3_free(errMsg);
         sqlite3_close(m_database);
         exit(1);
     }
 }
 
-UserDatabase::~UserDatabase() {
-    sqlite3_close(m_database);
+UserData UserDatabase::m_readUser(sqlite3_stmt* stmt) {
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        sqlite3_reset(stmt);
+        return UserData::empty();
+    }
+    unsigned int id = sqlite3_column_int(stmt, 0);
+    std::string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+    std::string password = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+    sqlite3_reset(stmt);
+    return UserData(id, name, password);
 }
 
 bool UserDatabase::insert(const UserData& userData) {
-    std::string insertStmtBase = "INSERT INTO users (id, name, password) VALUES ($id, $name, $password);";
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(m_database, insertStmtBase.c_str(), insertStmtBase.length(), &stmt, nullptr);
+    sqlite3_stmt* stmt = m_statement(INSERT);
     sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, "$id"), userData.getId());
     sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, "$name"), userData.getName().c_str(), userData.getName().length(), SQLITE_STATIC);
     sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, "$password"), userData.getPassword().c_str(), userData.getPassword().length(), SQLITE_STATIC);
     int result = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
     if (result != SQLITE_DONE) {
-        std::cerr << "Failed to insert user: " << sqlite3_errmsg(m_database) << std::endl;
-        sqlite3_finalize(stmt);
+        Logger::warning("Failed to insert user: ", sqlite3_errmsg(m_database));
         return false;
     }
-    sqlite3_finalize(stmt);
+    if (m_cache != nullptr) {
+        m_cache->put(userData);
+    }
     return true;
 }
 
 bool UserDatabase::update(const UserData& userData) {
-    std::string updateStmtBase = "UPDATE users SET name = $name, password = $password WHERE id = $id;";
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(m_database, updateStmtBase.c_str(), updateStmtBase.length(), &stmt, nullptr);
+    sqlite3_stmt* stmt = m_statement(UPDATE);
     sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, "$id"), userData.getId());
     sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, "$name"), userData.getName().c_str(), userData.getName().length(), SQLITE_STATIC);
     sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, "$password"), userData.getPassword().c_str(), userData.getPassword().length(), SQLITE_STATIC);
     int result = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
     if (result != SQLITE_DONE) {
-        std::cerr << "Failed to update user: " << sqlite3_errmsg(m_database) << std::endl;
-        sqlite3_finalize(stmt);
+        Logger::warning("Failed to update user: ", sqlite3_errmsg(m_database));
         return false;
     }
-    sqlite3_finalize(stmt);
+    if (m_cache != nullptr) {
+        m_cache->put(userData);
+    }
     return true;
 }
 
 bool UserDatabase::remove(const UserData& userData) {
-    std::string deleteStmtBase = "DELETE FROM users WHERE id = $id;";
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(m_database, deleteStmtBase.c_str(), deleteStmtBase.length(), &stmt, nullptr);
+    sqlite3_stmt* stmt = m_statement(REMOVE);
     sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, "$id"), userData.getId());
     int result = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
     if (result != SQLITE_DONE) {
-        std::cerr << "Failed to delete user: " << sqlite3_errmsg(m_database) << std::endl;
-        sqlite3_finalize(stmt);
+        Logger::warning("Failed to delete user: ", sqlite3_errmsg(m_database));
         return false;
     }
-    sqlite3_finalize(stmt);
+    if (m_cache != nullptr) {
+        m_cache->remove(userData.getId());
+    }
     return true;
 }
 
 UserData UserDatabase::findById(unsigned int id) {
-    std::string selectStmtBase = "SELECT id, name, password FROM users WHERE id = $id;";
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(m_database, selectStmtBase.c_str(), selectStmtBase.length(), &stmt, nullptr);
+    if (m_cache != nullptr) {
+        UserData userData = m_cache->findById(id);
+        if (!(userData == UserData::empty()) || m_cache->isComplete()) {
+            return userData;
+        }
+    }
+
+    sqlite3_stmt* stmt = m_statement(FIND_BY_ID);
     sqlite3_bind_int(stmt, sqlite3_bind_parameter_index(stmt, "$id"), id);
-    int result = sqlite3_step(stmt);
-    if (result == SQLITE_ROW) {
-        unsigned int id = sqlite3_column_int(stmt, 0);
-        std::string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        std::string password = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        sqlite3_finalize(stmt);
-        return UserData(id, name, password);
+    UserData userData = m_readUser(stmt);
+    if (m_cache != nullptr && !(userData == UserData::empty())) {
+        m_cache->putIfAbsent(userData);
     }
-    sqlite3_finalize(stmt);
-    return UserData::empty();
+    return userData;
 }
 
 UserData UserDatabase::findByName(const std::string& name) {
-    std::string selectStmtBase = "SELECT id, name, password FROM users WHERE name = $name;";
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(m_database, selectStmtBase.c_str(), selectStmtBase.length(), &stmt, nullptr);
+    if (m_cache != nullptr) {
+        UserData userData = m_cache->findByName(name);
+        if (!(userData == UserData::empty()) || m_cache->isComplete()) {
+            return userData;
+        }
+    }
+
+    sqlite3_stmt* stmt = m_statement(FIND_BY_NAME);
     sqlite3_bind_text(stmt, sqlite3_bind_parameter_index(stmt, "$name"), name.c_str(), name.length(), SQLITE_STATIC);
-    int result = sqlite3_step(stmt);
-    if (result == SQLITE_ROW) {
-        unsigned int id = sqlite3_column_int(stmt, 0);
-        std::string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        std::string password = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        sqlite3_finalize(stmt);
-        return UserData(id, name, password);
+    UserData userData = m_readUser(stmt);
+    if (m_cache != nullptr && !(userData == UserData::empty())) {
+        m_cache->putIfAbsent(userData);
+    }
+    return userData;
+}
+
+unsigned int UserDatabase::findMaxId() {
+    sqlite3_stmt* stmt = m_statement(FIND_MAX_ID);
+    unsigned int maxId = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        maxId = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_reset(stmt);
+    return maxId;
+}
+
+size_t UserDatabase::warmCache() {
+    if (m_cache == nullptr) {
+        return 0;
+    }
+
+    sqlite3_stmt* stmt = m_statement(FIND_ALL);
+    size_t loaded = 0;
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW && loaded < m_cache->getCapacity()) {
+        m_cache->putIfAbsent(UserData(sqlite3_column_int(stmt, 0), reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)), reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2))));
+        loaded++;
     }
-    sqlite3_finalize(stmt);
-    return UserData::empty();
+    // A row left over means the table is larger than the cache
+    m_cache->setComplete(result == SQLITE_DONE);
+    sqlite3_reset(stmt);
+    return loaded;
 }
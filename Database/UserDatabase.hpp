@@ -2,21 +2,68 @@
 
 #include <sqlite3.h>
 
+#include <array>
 #include <string>
 
+#include "UserCache.hpp"
 #include "UserData.hpp"
 
 class UserDatabase {
    private:
+    // Statements prepared once on construction and reused by every call
+    enum Statement {
+        INSERT,
+        UPDATE,
+        REMOVE,
+        FIND_BY_ID,
+        FIND_BY_NAME,
+        FIND_MAX_ID,
+        FIND_ALL,
+        STATEMENT_COUNT
+    };
+
     sqlite3* m_database;
+    std::array<sqlite3_stmt*, STATEMENT_COUNT> m_statements;
+    const int m_busyTimeoutMs = 5000;
+
+    // Optional index shared by all connections of the database, nullptr to always query SQLite
+    UserCache* m_cache;
+
+    /*
+     * Returns a cached statement, reset and with cleared bindings
+     */
+    sqlite3_stmt* m_statement(Statement statement);
+
+    /*
+     * Executes a pragma or other statement without results, exits on failure
+     */
+    void m_execute(const std::string& sql);
+
+    UserData m_readUser(sqlite3_stmt* stmt);
 
    public:
-    UserDatabase(const std::string& path);
+    /*
+     * Opens (or creates) the database and prepares all statements
+     * @param path - path of the database file, ":memory:" for a private in-memory database
+     * @param cache - index consulted before SQLite and updated by every successful write, optional
+     */
+    UserDatabase(const std::string& path, UserCache* cache = nullptr);
+    UserDatabase(const UserDatabase& other) = delete;
     ~UserDatabase();
 
+    UserDatabase& operator=(const UserDatabase& other) = delete;
+
     bool insert(const UserData& userData);
     bool update(const UserData& userData);
     bool remove(const UserData& userData);
     UserData findById(unsigned int id);
     UserData findByName(const std::string& name);
-};
\ No newline at end of file
+    unsigned int findMaxId();
+
+    /*
+     * Loads users into the cache until it is full, newest users first
+     * The cache is marked complete if all users fit, lookups of unknown names are then answered without SQLite.
+     * @return number of loaded users
+     */
+    size_t warmCache();
+};
@@ -0,0 +1,207 @@
+#include "Logger.hpp"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+
+namespace {
+
+struct ThreadState {
+    char name[12] = {};
+    uint8_t nameLength = 0;
+
+    // Token bucket of the rate limit
+    double tokens = 0;
+    std::chrono::steady_clock::time_point refilled;
+    uint64_t suppressed = 0;
+};
+
+thread_local ThreadState t_state;
+
+const char* levelNames[] = {"DEBUG", "INFO ", "WARN ", "ERROR"};
+
+void writeAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t result = ::write(fd, data.data() + written, data.size() - written);
+        if (result == -1 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return;
+        }
+        written += result;
+    }
+}
+
+}  // namespace
+
+Logger::Logger() : m_slots{std::make_unique<Slot[]>(m_capacity)},
+                   m_enqueuePosition{0},
+                   m_dequeuePosition{0},
+                   m_droppedLines{0},
+                   m_level{LogOptions{}.level},
+                   m_linesPerSecond{LogOptions{}.linesPerSecond},
+                   m_stopping{false} {
+    for (size_t slotIdx = 0; slotIdx < m_capacity; slotIdx++) {
+        m_slots[slotIdx].sequence.store(slotIdx, std::memory_order_relaxed);
+    }
+    m_writer = std::thread(&Logger::m_run, this);
+}
+
+Logger::~Logger() {
+    m_stopping = true;
+    m_writer.join();
+}
+
+Logger& Logger::m_instance() {
+    // Constructed on first use and destroyed on exit, after the writer wrote everything logged until then
+    static Logger logger;
+    return logger;
+}
+
+void Logger::configure(const LogOptions& options) {
+    m_instance().m_level.store(options.level, std::memory_order_relaxed);
+    m_instance().m_linesPerSecond.store(options.linesPerSecond, std::memory_order_relaxed);
+}
+
+void Logger::setThreadName(std::string_view name) {
+    t_state.nameLength = std::min(name.size(), sizeof(t_state.name));
+    std::memcpy(t_state.name, name.data(), t_state.nameLength);
+}
+
+bool Logger::parseLevel(std::string_view name, LogLevel& level) {
+    if (name == "debug") {
+        level = LogLevel::DEBUG;
+    } else if (name == "info") {
+        level = LogLevel::INFO;
+    } else if (name == "warning") {
+        level = LogLevel::WARNING;
+    } else if (name == "error") {
+        level = LogLevel::ERROR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool Logger::m_admit(LogLevel level) {
+    unsigned int linesPerSecond = m_linesPerSecond.load(std::memory_order_relaxed);
+    if (linesPerSecond == 0 || level == LogLevel::ERROR) {
+        return true;
+    }
+
+    ThreadState& state = t_state;
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - state.refilled).count();
+    state.tokens = std::min<double>(linesPerSecond, state.tokens + elapsed * linesPerSecond);
+    state.refilled = now;
+    if (state.tokens < 1) {
+        state.suppressed++;
+        return false;
+    }
+    state.tokens--;
+
+    // Reported with the first line the thread may log again
+    if (state.suppressed > 0) {
+        char text[64];
+        int length = std::snprintf(text, sizeof(text), "Suppressed %llu log line(s) of this thread", static_cast<unsigned long long>(state.suppressed));
+        m_push(LogLevel::WARNING, std::string_view(text, length));
+        state.suppressed = 0;
+    }
+    return true;
+}
+
+void Logger::m_push(LogLevel level, std::string_view text) {
+    uint64_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &m_slots[position & (m_capacity - 1)];
+        int64_t difference = static_cast<int64_t>(slot->sequence.load(std::memory_order_acquire) - position);
+        if (difference == 0) {
+            if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // The writer did not free the slot of the previous round yet, the buffer is full
+            m_droppedLines.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = m_enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->timeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    slot->level = level;
+    slot->threadNameLength = t_state.nameLength;
+    std::memcpy(slot->threadName, t_state.name, t_state.nameLength);
+    slot->length = text.size();
+    std::memcpy(slot->text, text.data(), text.size());
+    if (text.size() == MAX_LINE_LENGTH) {
+        std::memcpy(slot->text + MAX_LINE_LENGTH - 3, "...", 3);
+    }
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+size_t Logger::m_drain(std::string& out, std::string& err) {
+    // Converting to local time is comparably slow, so the formatted second is reused until it changes
+    thread_local int64_t formattedSecond = -1;
+    thread_local char formattedTime[24];
+
+    size_t lines = 0;
+    while (true) {
+        Slot& slot = m_slots[m_dequeuePosition & (m_capacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != m_dequeuePosition + 1) {
+            break;
+        }
+
+        int64_t second = slot.timeUs / 1000000;
+        if (second != formattedSecond) {
+            time_t time = second;
+            tm local;
+            localtime_r(&time, &local);
+            std::strftime(formattedTime, sizeof(formattedTime), "%Y-%m-%d %H:%M:%S", &local);
+            formattedSecond = second;
+        }
+        char prefix[64];
+        int prefixLength = std::snprintf(prefix, sizeof(prefix), "%s.%06lld %s %-10.*s ", formattedTime, static_cast<long long>(slot.timeUs % 1000000),
+                                         levelNames[static_cast<size_t>(slot.level)], static_cast<int>(slot.threadNameLength), slot.threadName);
+
+        std::string& target = slot.level >= LogLevel::WARNING ? err : out;
+        target.append(prefix, prefixLength);
+        target.append(slot.text, slot.length);
+        target += '\n';
+
+        slot.sequence.store(m_dequeuePosition + m_capacity, std::memory_order_release);
+        m_dequeuePosition++;
+        lines++;
+    }
+
+    uint64_t dropped = m_droppedLines.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+        err += "Dropped " + std::to_string(dropped) + " log line(s), the log buffer was full\n";
+    }
+    return lines;
+}
+
+void Logger::m_run() {
+    std::string out;
+    std::string err;
+    while (true) {
+        // Read before draining, so nothing logged before the stop is left behind
+        bool stopping = m_stopping.load();
+        size_t lines = m_drain(out, err);
+        writeAll(STDOUT_FILENO, out);
+        writeAll(STDERR_FILENO, err);
+        out.clear();
+        err.clear();
+        if (lines == 0) {
+            if (stopping) {
+                return;
+            }
+            std::this_thread::sleep_for(m_pollInterval);
+        }
+    }
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+enum class LogLevel : uint8_t {
+    DEBUG,
+    INFO,
+    WARNING,
+    ERROR
+};
+
+struct LogOptions {
+    // Lines below this level are discarded before they are formatted
+    LogLevel level = LogLevel::INFO;
+
+    // Lines a single thread may log per second (errors excepted), further lines are only counted, 0 disables the limit
+    unsigned int linesPerSecond = 1000;
+};
+
+/*
+ * Asynchronous logger shared by all threads of the process
+ * A line is formatted on the stack of the logging thread and copied into a bounded lock-free ring buffer (multiple
+ * producers, one consumer). A background thread writes the lines in batches, warnings and errors to stderr and
+ * everything else to stdout, as
+ *   2026-01-31 12:34:56.789012 INFO  reactor-0  New connection from: 127.0.0.1:50000
+ * Logging never blocks: lines that find the buffer full are dropped and reported later, and every thread is limited
+ * to a number of lines per second.
+ */
+class Logger {
+   public:
+    // Longer lines are truncated
+    static constexpr size_t MAX_LINE_LENGTH = 464;
+
+   private:
+    struct Slot {
+        // Equal to the position of the producer while free, one more once it holds a line
+        std::atomic<uint64_t> sequence;
+        int64_t timeUs;
+        LogLevel level;
+        uint8_t threadNameLength;
+        uint16_t length;
+        char threadName[12];
+        char text[MAX_LINE_LENGTH];
+    };
+
+    // Power of two
+    static constexpr size_t m_capacity = 4096;
+    static constexpr std::chrono::milliseconds m_pollInterval{10};
+
+    std::unique_ptr<Slot[]> m_slots;
+    alignas(64) std::atomic<uint64_t> m_enqueuePosition;
+    // Only used by the writer
+    alignas(64) uint64_t m_dequeuePosition;
+
+    std::atomic<uint64_t> m_droppedLines;
+    std::atomic<LogLevel> m_level;
+    std::atomic<unsigned int> m_linesPerSecond;
+    std::atomic<bool> m_stopping;
+    std::thread m_writer;
+
+    Logger();
+    ~Logger();
+
+    static Logger& m_instance();
+
+    /*
+     * Applies the rate limit of the calling thread
+     * @return false if the line has to be suppressed
+     */
+    bool m_admit(LogLevel level);
+
+    void m_push(LogLevel level, std::string_view text);
+
+    /*
+     * Main loop of the writer thread, returns once stopping and the buffer is empty
+     */
+    void m_run();
+
+    /*
+     * Formats all lines that are ready
+     * @return number of lines taken from the buffer
+     */
+    size_t m_drain(std::string& out, std::string& err);
+
+    template <typename T>
+    static void m_append(char* buffer, size_t& length, const T& value) {
+        if constexpr (std::is_same_v<T, char>) {
+            if (length < MAX_LINE_LENGTH) {
+                buffer[length++] = value;
+            }
+        } else if constexpr (std::is_integral_v<T> || std::is_floating_point_v<T>) {
+            std::to_chars_result result = std::to_chars(buffer + length, buffer + MAX_LINE_LENGTH, value);
+            length = result.ec == std::errc() ? result.ptr - buffer : MAX_LINE_LENGTH;
+        } else {
+            std::string_view text(value);
+            size_t copied = std::min(text.size(), MAX_LINE_LENGTH - length);
+            std::memcpy(buffer + length, text.data(), copied);
+            length += copied;
+        }
+    }
+
+   public:
+    Logger(const Logger& other) = delete;
+    Logger& operator=(const Logger& other) = delete;
+
+    /*
+     * Sets the level and rate limit, may be called at any time
+     */
+    static void configure(const LogOptions& options);
+
+    /*
+     * Names the calling thread in its log lines, e.g. 'reactor-1' (at most 12 characters)
+     */
+    static void setThreadName(std::string_view name);
+
+    static bool isEnabled(LogLevel level) {
+        return level >= m_instance().m_level.load(std::memory_order_relaxed);
+    }
+
+    /*
+     * Logs the concatenation of the arguments: strings, characters and numbers
+     */
+    template <typename... Args>
+    static void log(LogLevel level, const Args&... args) {
+        if (!isEnabled(level) || !m_instance().m_admit(level)) {
+            return;
+        }
+        char buffer[MAX_LINE_LENGTH];
+        size_t length = 0;
+        (m_append(buffer, length, args), ...);
+        m_instance().m_push(level, std::string_view(buffer, length));
+    }
+
+    template <typename... Args>
+    static void debug(const Args&... args) {
+        log(LogLevel::DEBUG, args...);
+    }
+
+    template <typename... Args>
+    static void info(const Args&... args) {
+        log(LogLevel::INFO, args...);
+    }
+
+    template <typename... Args>
+    static void warning(const Args&... args) {
+        log(LogLevel::WARNING, args...);
+    }
+
+    template <typename... Args>
+    static void error(const Args&... args) {
+        log(LogLevel::ERROR, args...);
+    }
+
+    /*
+     * Parses 'debug', 'info', 'warning' or 'error'
+     * @return false for any other name
+     */
+    static bool parseLevel(std::string_view name, LogLevel& level);
+};
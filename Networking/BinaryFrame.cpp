@@ -0,0 +1,87 @@
+#include "BinaryFrame.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Lz4.hpp"
+
+namespace {
+
+// Header fields are mostly zero bytes and small lengths, the rest are the texts the server sends over and over
+constexpr char frameDictionaryData[] =
+    "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0"
+    "lobby joined the server left the server joined the room left the room"
+    "Recent messages in room You are now in room No messages in room  yet"
+    "Logged in as Session token: Session resumed in room Server shutdown"
+    "Invalid command, use /help to list the available commands"
+    " and  others  is not online http://https://www. the and that this with have you for not are was what"
+    " just like when will your about there they would here thanks :) :D lol ok yes no ";
+
+const Lz4& frameCodec() {
+    static const Lz4 codec{frameDictionary()};
+    return codec;
+}
+
+}  // namespace
+
+std::string_view FrameHeader::getRoom(std::string_view payload) const {
+    return payload.substr(0, roomLength);
+}
+
+std::string_view FrameHeader::getSender(std::string_view payload) const {
+    return payload.substr(std::min<size_t>(roomLength, payload.size()), senderLength);
+}
+
+std::string_view FrameHeader::getText(std::string_view payload) const {
+    return payload.substr(std::min<size_t>(roomLength + senderLength, payload.size()));
+}
+
+FrameHeader readFrameHeader(const char* data) {
+    FrameHeader header;
+    std::memcpy(&header, data, FrameHeader::SIZE);
+    return header;
+}
+
+std::string_view viewFrameHeader(const FrameHeader& header) {
+    return std::string_view(reinterpret_cast<const char*>(&header), FrameHeader::SIZE);
+}
+
+void appendFrame(std::string& out, FrameHeader header, std::string_view room, std::string_view sender, std::string_view text) {
+    room = room.substr(0, UINT8_MAX);
+    sender = sender.substr(0, UINT8_MAX);
+    header.roomLength = static_cast<uint8_t>(room.size());
+    header.senderLength = static_cast<uint8_t>(sender.size());
+    header.length = static_cast<uint32_t>(room.size() + sender.size() + text.size());
+    out.append(viewFrameHeader(header)).append(room).append(sender).append(text);
+}
+
+std::string_view frameDictionary() {
+    return std::string_view(frameDictionaryData, sizeof(frameDictionaryData) - 1);
+}
+
+bool appendCompressedFrame(std::string& out, std::string_view frames) {
+    size_t frameStart = out.size();
+    FrameHeader header;
+    header.type = FrameType::COMPRESSED;
+    header.flags = FRAME_DICTIONARY_VERSION;
+    out.append(viewFrameHeader(header));
+    uint32_t size = static_cast<uint32_t>(frames.size());
+    out.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    frameCodec().compress(frames, out);
+    if (out.size() - frameStart >= frames.size()) {
+        out.resize(frameStart);
+        return false;
+    }
+    header.length = static_cast<uint32_t>(out.size() - frameStart - FrameHeader::SIZE);
+    std::memcpy(out.data() + frameStart, &header, FrameHeader::SIZE);
+    return true;
+}
+
+bool decompressFrames(const FrameHeader& header, std::string_view payload, std::string& frames, size_t maxSize) {
+    uint32_t size;
+    if (header.type != FrameType::COMPRESSED || header.flags != FRAME_DICTIONARY_VERSION || payload.size() < sizeof(size)) {
+        return false;
+    }
+    std::memcpy(&size, payload.data(), sizeof(size));
+    return size <= maxSize && frameCodec().decompress(payload.substr(sizeof(size)), size, frames);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+ * Length-prefixed binary framing, the opt-in alternative to newline terminated text lines
+ * Every frame starts with a fixed 32 byte header in little endian byte order, followed by length bytes: the room name,
+ * the sender name and the text, whose lengths follow from the header. Decoding copies the header out of the receive
+ * buffer with a single memcpy and hands out the variable parts as views, so it never allocates. Texts carry no colors
+ * and no newline, those only exist in the text protocol.
+ */
+enum class FrameType : uint8_t {
+    // Server to client: a chat message of a room, a private message, a server notice (flags hold the TextColor),
+    // the reply to a command, a message of the room history, a keepalive, compressed frames (see appendCompressedFrame)
+    // and protocol control (flags hold the FrameControl)
+    CHAT = 1,
+    DIRECT = 2,
+    NOTICE = 3,
+    REPLY = 4,
+    HISTORY = 5,
+    PING = 6,
+    COMPRESSED = 7,
+    CONTROL = 8,
+
+    // Client to server: a line as in the text protocol (a chat message or a command) and the answer to a ping
+    MESSAGE = 16,
+    PONG = 17
+};
+
+enum class FrameControl : uint8_t {
+    // The last frame, text lines follow it
+    TEXT_PROTOCOL = 1
+};
+
+struct FrameHeader {
+    static constexpr size_t SIZE = 32;
+
+    // Bytes following the header
+    uint32_t length = 0;
+    FrameType type = FrameType::REPLY;
+    uint8_t flags = 0;
+    uint8_t roomLength = 0;
+    uint8_t senderLength = 0;
+    // 0 if the frame has no sender
+    uint64_t senderId = 0;
+    // Unique per message, the shard the message originated from in the top 8 bits, 0 if the frame is no message.
+    // HISTORY frames carry the history id of the room instead, the id '/resume' accepts as last seen id.
+    uint64_t messageId = 0;
+    // Microseconds since the Unix epoch, 0 if unknown
+    int64_t timestampUs = 0;
+
+    /*
+     * Splits the bytes following the header into room, sender and text
+     * @param payload - the length bytes following the header
+     */
+    std::string_view getRoom(std::string_view payload) const;
+    std::string_view getSender(std::string_view payload) const;
+    std::string_view getText(std::string_view payload) const;
+};
+
+static_assert(sizeof(FrameHeader) == FrameHeader::SIZE, "FrameHeader must not contain padding");
+static_assert(std::endian::native == std::endian::little, "Frame headers are copied as they are, which requires a little endian host");
+
+// First byte a client may send to switch to binary frames right away, instead of the command '/proto bin'
+inline constexpr char BINARY_PROTOCOL_MAGIC = '\xB1';
+
+// Line the server answers a switch to binary frames with, the frames start right after it.
+// Relayed chat lines always start with the sender's name, so no other line equals it.
+inline constexpr std::string_view BINARY_PROTOCOL_ACK = "/proto bin ok\n";
+
+/*
+ * Copies a header out of at least FrameHeader::SIZE bytes
+ */
+FrameHeader readFrameHeader(const char* data);
+
+/*
+ * Returns the bytes of a header
+ */
+std::string_view viewFrameHeader(const FrameHeader& header);
+
+/*
+ * Appends a complete frame, the length fields of the header are set from the parts
+ * Room and sender are truncated to 255 bytes.
+ */
+void appendFrame(std::string& out, FrameHeader header, std::string_view room, std::string_view sender, std::string_view text);
+
+// Version of the compression dictionary, sent in the flags of COMPRESSED frames
+inline constexpr uint8_t FRAME_DICTIONARY_VERSION = 1;
+
+/*
+ * Returns the dictionary COMPRESSED frames are compressed with, primed with the bytes frequent in chat frames
+ * (header fields, server notices and common words)
+ */
+std::string_view frameDictionary();
+
+/*
+ * Appends a COMPRESSED frame holding one or more complete frames, if that is smaller than the frames themselves
+ * Its text is the size of the frames (4 bytes, little endian) followed by their LZ4 block, compressed with frameDictionary.
+ * @return false if compressing did not pay off, nothing is appended then
+ */
+bool appendCompressedFrame(std::string& out, std::string_view frames);
+
+/*
+ * Appends the frames of a COMPRESSED frame
+ * @param payload - the bytes following the header
+ * @param maxSize - largest accepted size of the decompressed frames
+ * @return false if the frame is corrupt or too large
+ */
+bool decompressFrames(const FrameHeader& header, std::string_view payload, std::string& frames, size_t maxSize);
@@ -0,0 +1,38 @@
+#include "BufferPool.hpp"
+
+BufferPool::BufferPool(size_t chunkSize, size_t chunksPerSlab) : m_chunkSize{chunkSize}, m_chunksPerSlab{chunksPerSlab}, m_chunksInUse{0} {}
+
+void BufferPool::m_addSlab() {
+    m_slabs.push_back(std::make_unique_for_overwrite<char[]>(m_chunkSize * m_chunksPerSlab));
+    char* slab = m_slabs.back().get();
+    for (size_t chunkIdx = m_chunksPerSlab; chunkIdx > 0; chunkIdx--) {
+        m_freeChunks.push_back(slab + (chunkIdx - 1) * m_chunkSize);
+    }
+}
+
+char* BufferPool::acquire() {
+    if (m_freeChunks.empty()) {
+        m_addSlab();
+    }
+    char* chunk = m_freeChunks.back();
+    m_freeChunks.pop_back();
+    m_chunksInUse++;
+    return chunk;
+}
+
+void BufferPool::release(char* chunk) {
+    m_freeChunks.push_back(chunk);
+    m_chunksInUse--;
+}
+
+size_t BufferPool::getChunkSize() const {
+    return m_chunkSize;
+}
+
+size_t BufferPool::getChunksInUse() const {
+    return m_chunksInUse;
+}
+
+size_t BufferPool::getChunksAllocated() const {
+    return m_slabs.size() * m_chunksPerSlab;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/*
+ * Arena of fixed-size buffer chunks shared by all connections of one event loop thread (not thread-safe)
+ * Chunks are carved out of larger slabs and recycled through a free list, so acquiring and releasing a chunk never
+ * touches the heap once the pool has grown to the peak number of chunks in use
+ */
+class BufferPool {
+   private:
+    size_t m_chunkSize;
+    size_t m_chunksPerSlab;
+    std::vector<std::unique_ptr<char[]>> m_slabs;
+    std::vector<char*> m_freeChunks;
+    size_t m_chunksInUse;
+
+    void m_addSlab();
+
+   public:
+    /*
+     * Constructor
+     * @param chunkSize - size of every chunk in bytes
+     * @param chunksPerSlab - number of chunks allocated at once when the pool runs empty
+     */
+    BufferPool(size_t chunkSize, size_t chunksPerSlab = 64);
+    BufferPool(const BufferPool& other) = delete;
+
+    BufferPool& operator=(const BufferPool& other) = delete;
+
+    /*
+     * Returns a chunk of getChunkSize() bytes
+     */
+    char* acquire();
+
+    /*
+     * Returns a chunk to the pool, it must have been acquired from this pool
+     */
+    void release(char* chunk);
+
+    size_t getChunkSize() const;
+    size_t getChunksInUse() const;
+    size_t getChunksAllocated() const;
+};
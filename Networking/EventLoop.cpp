@@ -0,0 +1,394 @@
+#include "EventLoop.hpp"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+
+#include "IoUring.hpp"
+
+EventLoop::EventLoop(Backend backend, int maxEvents) : m_backend{backend},
+                                                       m_epollFd{-1},
+                                                       m_readyEvents(maxEvents),
+                                                       m_ringEnabled{false},
+                                                       m_nextOperationId{1},
+                                                       m_pendingSends{nullptr},
+                                                       m_pendingSendCount{0} {
+    if (m_backend == Backend::EPOLL) {
+        m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (m_epollFd == -1) {
+            throw std::runtime_error("Failed to create epoll instance, errno: " + std::to_string(errno));
+        }
+        return;
+    }
+#ifdef CHAT_IO_URING
+    m_ring = std::make_unique<IoUring>(m_ringEntries);
+    if (!m_ring->provideBuffers(0, m_receiveBufferCount, m_receiveBufferSize)) {
+        throw std::runtime_error("Failed to allocate the io_uring receive buffers");
+    }
+#else
+    throw std::runtime_error("The io_uring backend was not compiled in");
+#endif
+}
+
+EventLoop::~EventLoop() {
+    if (m_epollFd != -1) {
+        close(m_epollFd);
+    }
+}
+
+bool EventLoop::isIoUringSupported() {
+#ifdef CHAT_IO_URING
+    return IoUring::isSupported();
+#else
+    return false;
+#endif
+}
+
+EventLoop::Backend EventLoop::getBackend() const {
+    return m_backend;
+}
+
+bool EventLoop::add(int fd, uint32_t events, Callback callback, bool levelTriggered) {
+    if (m_backend == Backend::IO_URING) {
+        Operation operation{fd, levelTriggered ? Operation::Kind::POLL_LEVEL : Operation::Kind::POLL, events, std::move(callback), {}, {}, false, false};
+        m_addOperation(std::move(operation));
+        return true;
+    }
+
+    epoll_event event{};
+    event.events = levelTriggered ? events : events | EPOLLET;
+    event.data.fd = fd;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        return false;
+    }
+    m_callbacks[fd] = std::move(callback);
+    return true;
+}
+
+bool EventLoop::remove(int fd) {
+    if (m_backend == Backend::IO_URING) {
+        auto it = m_fdOperations.find(fd);
+        if (it == m_fdOperations.end()) {
+            return false;
+        }
+        // Completions of the cancelled requests that are still in flight find no operation and are ignored
+        for (uint64_t operationId : it->second) {
+            m_cancel(operationId);
+            m_operations.erase(operationId);
+        }
+        m_fdOperations.erase(it);
+        return true;
+    }
+
+    auto it = m_callbacks.find(fd);
+    if (it == m_callbacks.end()) {
+        return false;
+    }
+    m_callbacks.erase(it);
+    return epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr) == 0;
+}
+
+bool EventLoop::accept(int fd, AcceptCallback callback) {
+    if (m_backend != Backend::IO_URING) {
+        return false;
+    }
+    m_addOperation(Operation{fd, Operation::Kind::ACCEPT, 0, {}, std::move(callback), {}, false, false});
+    return true;
+}
+
+bool EventLoop::receive(int fd, ReceiveCallback callback) {
+    if (m_backend != Backend::IO_URING) {
+        return false;
+    }
+    m_addOperation(Operation{fd, Operation::Kind::RECEIVE, 0, {}, {}, std::move(callback), false, false});
+    return true;
+}
+
+bool EventLoop::watchWritable(int fd, Callback callback) {
+    if (m_backend != Backend::IO_URING) {
+        return false;
+    }
+    m_addOperation(Operation{fd, Operation::Kind::WRITABLE, POLLOUT, std::move(callback), {}, {}, false, false});
+    return true;
+}
+
+void EventLoop::pauseReceive(int fd) {
+    auto it = m_fdOperations.find(fd);
+    if (it == m_fdOperations.end()) {
+        return;
+    }
+    for (uint64_t operationId : it->second) {
+        Operation& operation = m_operations.at(operationId);
+        if (operation.kind == Operation::Kind::RECEIVE && !operation.paused) {
+            operation.paused = true;
+            if (operation.armed) {
+                m_cancel(operationId);
+            }
+        }
+    }
+}
+
+void EventLoop::resumeReceive(int fd) {
+    auto it = m_fdOperations.find(fd);
+    if (it == m_fdOperations.end()) {
+        return;
+    }
+    for (uint64_t operationId : it->second) {
+        Operation& operation = m_operations.at(operationId);
+        if (operation.kind == Operation::Kind::RECEIVE && operation.paused) {
+            operation.paused = false;
+            // Otherwise armed again once the cancelled request completed, two receives on one socket could reorder the data
+            if (!operation.armed) {
+                m_rearm.push_back(operationId);
+            }
+        }
+    }
+}
+
+#ifdef CHAT_IO_URING
+
+uint64_t EventLoop::m_addOperation(Operation operation) {
+    uint64_t operationId = m_nextOperationId++;
+    m_fdOperations[operation.fd].push_back(operationId);
+    Operation& added = m_operations.emplace(operationId, std::move(operation)).first->second;
+    m_arm(operationId, added);
+    return operationId;
+}
+
+void EventLoop::m_arm(uint64_t operationId, Operation& operation) {
+    operation.armed = true;
+    io_uring_sqe* entry = m_ring->getSubmissionEntry();
+    entry->fd = operation.fd;
+    entry->user_data = operationId;
+    switch (operation.kind) {
+        case Operation::Kind::POLL:
+            entry->opcode = IORING_OP_POLL_ADD;
+            entry->poll32_events = operation.events;
+            entry->len = IORING_POLL_ADD_MULTI;
+            break;
+        case Operation::Kind::POLL_LEVEL:
+        case Operation::Kind::WRITABLE:
+            entry->opcode = IORING_OP_POLL_ADD;
+            entry->poll32_events = operation.events;
+            break;
+        case Operation::Kind::ACCEPT:
+            entry->opcode = IORING_OP_ACCEPT;
+            entry->ioprio = IORING_ACCEPT_MULTISHOT;
+            entry->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+            break;
+        case Operation::Kind::RECEIVE:
+            entry->opcode = IORING_OP_RECV;
+            entry->ioprio = IORING_RECV_MULTISHOT;
+            entry->flags = IOSQE_BUFFER_SELECT;
+            entry->buf_group = m_ring->getBufferGroup();
+            break;
+    }
+}
+
+void EventLoop::m_cancel(uint64_t operationId) {
+    io_uring_sqe* entry = m_ring->getSubmissionEntry();
+    entry->opcode = IORING_OP_ASYNC_CANCEL;
+    entry->addr = operationId;
+    // The completion of the cancellation itself is ignored
+    entry->user_data = 0;
+}
+
+void EventLoop::m_complete(const Completion& completion) {
+    // The buffer only has to stay valid while the callback runs
+    bool hasBuffer = completion.flags & IORING_CQE_F_BUFFER;
+    uint16_t bufferId = completion.flags >> IORING_CQE_BUFFER_SHIFT;
+    struct BufferRecycler {
+        IoUring& ring;
+        bool hasBuffer;
+        uint16_t bufferId;
+        ~BufferRecycler() {
+            if (hasBuffer) {
+                ring.recycleBuffer(bufferId);
+            }
+        }
+    } recycler{*m_ring, hasBuffer, bufferId};
+
+    auto it = m_operations.find(completion.operationId);
+    if (it == m_operations.end()) {
+        return;
+    }
+    uint64_t operationId = it->first;
+    Operation& operation = it->second;
+    int fd = operation.fd;
+    bool more = completion.flags & IORING_CQE_F_MORE;
+    if (!more) {
+        operation.armed = false;
+    }
+
+    switch (operation.kind) {
+        case Operation::Kind::POLL:
+        case Operation::Kind::POLL_LEVEL: {
+            if (!more) {
+                m_rearm.push_back(operationId);
+            }
+            if (completion.result > 0) {
+                // Invoke a copy, the callback is allowed to remove its own descriptor
+                Callback callback = operation.callback;
+                callback(completion.result);
+            }
+            break;
+        }
+        case Operation::Kind::WRITABLE: {
+            Callback callback = std::move(operation.callback);
+            m_finish(operationId, fd);
+            callback(completion.result > 0 ? completion.result : POLLERR);
+            break;
+        }
+        case Operation::Kind::ACCEPT: {
+            if (!more) {
+                m_rearm.push_back(operationId);
+            }
+            AcceptCallback callback = operation.acceptCallback;
+            callback(completion.result);
+            break;
+        }
+        case Operation::Kind::RECEIVE: {
+            // Cancelled by a pause, or the kernel ran out of buffers (recycled meanwhile), neither ends the stream
+            bool interrupted = completion.result == -ECANCELED || completion.result == -ENOBUFS;
+            if (!more && (interrupted || completion.result > 0) && !operation.paused) {
+                m_rearm.push_back(operationId);
+            }
+            if (interrupted) {
+                break;
+            }
+            ReceiveCallback callback = operation.receiveCallback;
+            if (completion.result <= 0) {
+                m_finish(operationId, fd);
+            }
+            callback(completion.result, hasBuffer ? m_ring->getBuffer(bufferId, completion.result) : std::string_view());
+            break;
+        }
+    }
+}
+
+void EventLoop::m_finish(uint64_t operationId, int fd) {
+    m_operations.erase(operationId);
+    auto it = m_fdOperations.find(fd);
+    if (it != m_fdOperations.end()) {
+        std::erase(it->second, operationId);
+        if (it->second.empty()) {
+            m_fdOperations.erase(it);
+        }
+    }
+}
+
+void EventLoop::send(std::span<Send> sends) {
+    for (size_t offset = 0; offset < sends.size();) {
+        // At most a queue full at a time, so no entry is submitted before its batch starts
+        size_t batch = std::min<size_t>(sends.size() - offset, m_ringEntries / 2);
+        m_pendingSends = sends.data() + offset;
+        m_pendingSendCount = batch;
+        for (size_t sendIdx = 0; sendIdx < batch; sendIdx++) {
+            Send& send = sends[offset + sendIdx];
+            io_uring_sqe* entry = m_ring->getSubmissionEntry();
+            entry->opcode = IORING_OP_SENDMSG;
+            entry->fd = send.fd;
+            entry->addr = reinterpret_cast<uint64_t>(&send.message);
+            entry->len = 1;
+            // Completes with -EAGAIN instead of waiting for a full socket
+            entry->msg_flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+            entry->user_data = m_sendTag | sendIdx;
+            send.result = -EAGAIN;
+        }
+
+        int result = m_ring->submit(batch);
+        while (m_pendingSendCount > 0 && (result >= 0 || result == -EINTR)) {
+            m_ring->forEachCompletion([this](const io_uring_cqe& completion) {
+                if (!(completion.user_data & m_sendTag)) {
+                    // Dispatching now would run callbacks in the middle of the caller's batch
+                    m_deferred.push_back(Completion{completion.user_data, completion.res, completion.flags});
+                    return;
+                }
+                size_t sendIdx = completion.user_data & ~m_sendTag;
+                m_pendingSends[sendIdx].result = completion.res;
+                m_pendingSendCount--;
+            });
+            if (m_pendingSendCount > 0) {
+                result = m_ring->submit(1);
+            }
+        }
+        m_pendingSends = nullptr;
+        m_pendingSendCount = 0;
+        offset += batch;
+    }
+}
+
+#else
+
+uint64_t EventLoop::m_addOperation(Operation) {
+    return 0;
+}
+
+void EventLoop::m_arm(uint64_t, Operation&) {}
+
+void EventLoop::m_cancel(uint64_t) {}
+
+void EventLoop::m_complete(const Completion&) {}
+
+void EventLoop::m_finish(uint64_t, int) {}
+
+void EventLoop::send(std::span<Send>) {}
+
+#endif
+
+int EventLoop::poll(int timeoutMs) {
+    if (m_backend == Backend::IO_URING) {
+#ifdef CHAT_IO_URING
+        if (!m_ringEnabled) {
+            // Only the thread running the loop may submit from now on
+            if (!m_ring->enable()) {
+                throw std::runtime_error("Failed to enable io_uring, errno: " + std::to_string(errno));
+            }
+            m_ringEnabled = true;
+        }
+        int dispatched = m_deferred.size();
+        std::vector<Completion> deferred = std::move(m_deferred);
+        m_deferred.clear();
+        for (const Completion& completion : deferred) {
+            m_complete(completion);
+        }
+
+        for (uint64_t operationId : m_rearm) {
+            auto it = m_operations.find(operationId);
+            if (it != m_operations.end() && !it->second.armed && !it->second.paused) {
+                m_arm(operationId, it->second);
+            }
+        }
+        m_rearm.clear();
+
+        int result = m_ring->submit(timeoutMs == 0 || dispatched > 0 ? 0 : 1, timeoutMs);
+        if (result < 0 && result != -ETIME && result != -EINTR && result != -EBUSY) {
+            throw std::runtime_error("io_uring_enter failed, errno: " + std::to_string(-result));
+        }
+        return dispatched + m_ring->forEachCompletion([this](const io_uring_cqe& completion) { m_complete(Completion{completion.user_data, completion.res, completion.flags}); });
+#endif
+    }
+
+    int readyCount = epoll_wait(m_epollFd, m_readyEvents.data(), m_readyEvents.size(), timeoutMs);
+    if (readyCount == -1) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        throw std::runtime_error("epoll_wait failed, errno: " + std::to_string(errno));
+    }
+
+    for (int eventIdx = 0; eventIdx < readyCount; eventIdx++) {
+        // The descriptor might have been removed by a callback earlier in this batch
+        auto it = m_callbacks.find(m_readyEvents[eventIdx].data.fd);
+        if (it == m_callbacks.end()) {
+            continue;
+        }
+        // Invoke a copy, the callback is allowed to remove its own descriptor
+        Callback callback = it->second;
+        callback(m_readyEvents[eventIdx].events);
+    }
+    return readyCount;
+}
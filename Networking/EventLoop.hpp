@@ -0,0 +1,179 @@
+#pragma once
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class IoUring;
+
+/*
+ * Reactor of one thread, built on edge-triggered epoll or on io_uring
+ * With epoll, every file descriptor is registered once together with a callback, which is only invoked when the
+ * descriptor is ready. With io_uring, the same registrations are served by multishot polls, and sockets can in addition
+ * be accepted from and received from with multishot requests, which deliver connections and data instead of readiness
+ * and need no system call of their own. Received data is placed into provided buffers owned by the loop.
+ */
+class EventLoop {
+   public:
+    enum class Backend {
+        EPOLL,
+        IO_URING
+    };
+
+    using Callback = std::function<void(uint32_t events)>;
+
+    // Invoked with the descriptor of an accepted connection, or -errno
+    using AcceptCallback = std::function<void(int result)>;
+
+    // Invoked with received data, or with 0 once the peer closed the connection or -errno if it failed
+    using ReceiveCallback = std::function<void(int result, std::string_view data)>;
+
+    /*
+     * Message of a batched send, result receives the number of written bytes or -errno
+     */
+    struct Send {
+        int fd;
+        msghdr message;
+        int result;
+    };
+
+   private:
+    Backend m_backend;
+
+    int m_epollFd;
+    std::vector<epoll_event> m_readyEvents;
+    std::unordered_map<int, Callback> m_callbacks;
+
+    struct Operation {
+        enum class Kind {
+            POLL,
+            // Re-armed after each completion, so the descriptor behaves level-triggered
+            POLL_LEVEL,
+            WRITABLE,
+            ACCEPT,
+            RECEIVE
+        };
+
+        int fd;
+        Kind kind;
+        uint32_t events;
+        Callback callback;
+        AcceptCallback acceptCallback;
+        ReceiveCallback receiveCallback;
+        // Set while a request of the operation is in flight
+        bool armed;
+        // A paused receive still delivers the data received until its cancellation took effect
+        bool paused;
+    };
+
+    std::unique_ptr<IoUring> m_ring;
+    bool m_ringEnabled;
+    uint64_t m_nextOperationId;
+    std::unordered_map<uint64_t, Operation> m_operations;
+    std::unordered_map<int, std::vector<uint64_t>> m_fdOperations;
+    // Multishot requests that ended and have to be submitted again
+    std::vector<uint64_t> m_rearm;
+    struct Completion {
+        uint64_t operationId;
+        int result;
+        uint32_t flags;
+    };
+
+    // Completions that arrived during a batched send, they are dispatched by the next poll
+    std::vector<Completion> m_deferred;
+
+    // Batched sends are identified by this bit and their index
+    static constexpr uint64_t m_sendTag = uint64_t{1} << 63;
+    Send* m_pendingSends;
+    size_t m_pendingSendCount;
+
+    static constexpr unsigned m_ringEntries = 4096;
+    static constexpr unsigned m_receiveBufferCount = 1024;
+    static constexpr size_t m_receiveBufferSize = 4096;
+
+    uint64_t m_addOperation(Operation operation);
+    void m_arm(uint64_t operationId, Operation& operation);
+    void m_cancel(uint64_t operationId);
+    void m_complete(const Completion& completion);
+    void m_finish(uint64_t operationId, int fd);
+
+   public:
+    /*
+     * Constructor
+     * Throws a runtime_error if the backend can not be set up, check isIoUringSupported before choosing io_uring.
+     * @param backend - epoll or io_uring
+     * @param maxEvents - maximum number of ready events handled per epoll call
+     */
+    EventLoop(Backend backend = Backend::EPOLL, int maxEvents = 256);
+    EventLoop(const EventLoop& other) = delete;
+    ~EventLoop();
+
+    EventLoop& operator=(const EventLoop& other) = delete;
+
+    /*
+     * Returns true if the kernel supports everything the io_uring backend uses and it was compiled in
+     */
+    static bool isIoUringSupported();
+
+    Backend getBackend() const;
+
+    /*
+     * Registers a file descriptor
+     * Edge-triggered mode requires the callback to drain the descriptor until it would block
+     * @param fd - file descriptor to watch
+     * @param events - epoll events of interest (EPOLLIN, EPOLLOUT, ...)
+     * @param callback - invoked with the ready events
+     * @param levelTriggered - register without EPOLLET, for descriptors that can not be switched to non-blocking mode or are only partly drained per call
+     * @return false if the descriptor could not be registered
+     */
+    bool add(int fd, uint32_t events, Callback callback, bool levelTriggered = false);
+
+    /*
+     * Unregisters a file descriptor and cancels its requests, must be called before the descriptor is closed
+     */
+    bool remove(int fd);
+
+    /*
+     * Accepts connections of a listening socket until it is removed (io_uring only)
+     * Accepted sockets are non-blocking.
+     */
+    bool accept(int fd, AcceptCallback callback);
+
+    /*
+     * Receives from a socket until it is removed, the peer closes it or it fails (io_uring only)
+     * The data passed to the callback is only valid during the call.
+     */
+    bool receive(int fd, ReceiveCallback callback);
+
+    /*
+     * Stops receiving from a socket until resumed, data that arrived in the meantime is still delivered (io_uring only)
+     */
+    void pauseReceive(int fd);
+
+    void resumeReceive(int fd);
+
+    /*
+     * Invokes the callback once, as soon as the socket is writable (io_uring only)
+     */
+    bool watchWritable(int fd, Callback callback);
+
+    /*
+     * Writes a message to each of several non-blocking sockets with a single system call (io_uring only)
+     * Returns once all of them completed, a full socket reports -EAGAIN.
+     */
+    void send(std::span<Send> sends);
+
+    /*
+     * Waits for ready descriptors or completions and dispatches them to their callbacks
+     * @param timeoutMs - maximum time to wait, -1 waits indefinitely
+     * @return number of dispatched events
+     */
+    int poll(int timeoutMs = -1);
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+/*
+ * Periodic timer of an event loop thread
+ * The timerfd becomes readable once per interval and can be registered with the thread's EventLoop.
+ */
+class IntervalTimer {
+   private:
+    int m_timerFd;
+
+   public:
+    /*
+     * Constructor, the timer starts immediately
+     * Throws a runtime_error if the timerfd can not be created.
+     */
+    IntervalTimer(std::chrono::milliseconds interval) : m_timerFd{timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)} {
+        if (m_timerFd == -1) {
+            throw std::runtime_error("Failed to create timerfd, errno: " + std::to_string(errno));
+        }
+        itimerspec spec{};
+        spec.it_interval.tv_sec = interval.count() / 1000;
+        spec.it_interval.tv_nsec = (interval.count() % 1000) * 1000000;
+        spec.it_value = spec.it_interval;
+        timerfd_settime(m_timerFd, 0, &spec, nullptr);
+    }
+
+    IntervalTimer(const IntervalTimer& other) = delete;
+    IntervalTimer& operator=(const IntervalTimer& other) = delete;
+
+    ~IntervalTimer() {
+        close(m_timerFd);
+    }
+
+    /*
+     * Acknowledges the timer, called when its fd became readable
+     * @return number of intervals that elapsed since the last call
+     */
+    uint64_t acknowledge() {
+        uint64_t expirations = 0;
+        [[maybe_unused]] ssize_t bytesRead = ::read(m_timerFd, &expirations, sizeof(expirations));
+        return expirations;
+    }
+
+    int getFd() const {
+        return m_timerFd;
+    }
+};
@@ -0,0 +1,194 @@
+#include "IoUring.hpp"
+
+#ifdef CHAT_IO_URING
+
+#include <linux/time_types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+int setup(unsigned entries, io_uring_params& params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int registerRing(int ringFd, unsigned opcode, const void* argument, unsigned count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, ringFd, opcode, argument, count));
+}
+
+void* mapRing(int ringFd, size_t size, off_t offset) {
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, offset);
+    return memory == MAP_FAILED ? nullptr : memory;
+}
+
+// The receiving thread is the only one submitting, so completions can wait until it asks for them
+constexpr unsigned setupFlags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN |
+                                IORING_SETUP_R_DISABLED | IORING_SETUP_CQSIZE;
+
+}  // namespace
+
+IoUring::IoUring(unsigned entries) : m_ringFd{-1},
+                                     m_submissionRing{nullptr},
+                                     m_submissionRingSize{0},
+                                     m_completionRing{nullptr},
+                                     m_submissionEntries{nullptr},
+                                     m_submissionEntriesSize{0},
+                                     m_preparedTail{0},
+                                     m_buffers{nullptr},
+                                     m_bufferSize{0},
+                                     m_bufferGroup{0} {
+    io_uring_params params{};
+    params.flags = setupFlags;
+    params.cq_entries = entries * 4;
+    m_ringFd = setup(entries, params);
+    if (m_ringFd < 0) {
+        throw std::runtime_error("Failed to set up io_uring, errno: " + std::to_string(errno));
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        close(m_ringFd);
+        throw std::runtime_error("io_uring lacks required features");
+    }
+
+    // Both rings share one mapping
+    m_submissionRingSize = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned), params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    m_submissionRing = mapRing(m_ringFd, m_submissionRingSize, IORING_OFF_SQ_RING);
+    m_submissionEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_submissionEntries = m_submissionRing ? static_cast<io_uring_sqe*>(mapRing(m_ringFd, m_submissionEntriesSize, IORING_OFF_SQES)) : nullptr;
+    if (m_submissionEntries == nullptr) {
+        int error = errno;
+        if (m_submissionRing) {
+            munmap(m_submissionRing, m_submissionRingSize);
+        }
+        close(m_ringFd);
+        throw std::runtime_error("Failed to map io_uring, errno: " + std::to_string(error));
+    }
+    m_completionRing = m_submissionRing;
+
+    char* submissionRing = static_cast<char*>(m_submissionRing);
+    m_submissionHead = reinterpret_cast<unsigned*>(submissionRing + params.sq_off.head);
+    m_submissionTail = reinterpret_cast<unsigned*>(submissionRing + params.sq_off.tail);
+    m_submissionMask = *reinterpret_cast<unsigned*>(submissionRing + params.sq_off.ring_mask);
+    m_submissionCapacity = params.sq_entries;
+    m_preparedTail = *m_submissionTail;
+    // Entry i of the submission queue always uses submission entry i
+    unsigned* array = reinterpret_cast<unsigned*>(submissionRing + params.sq_off.array);
+    for (unsigned entryIdx = 0; entryIdx < params.sq_entries; entryIdx++) {
+        array[entryIdx] = entryIdx;
+    }
+
+    char* completionRing = static_cast<char*>(m_completionRing);
+    m_completionHead = reinterpret_cast<unsigned*>(completionRing + params.cq_off.head);
+    m_completionTail = reinterpret_cast<unsigned*>(completionRing + params.cq_off.tail);
+    m_completionMask = *reinterpret_cast<unsigned*>(completionRing + params.cq_off.ring_mask);
+    m_completionEntries = reinterpret_cast<io_uring_cqe*>(completionRing + params.cq_off.cqes);
+}
+
+IoUring::~IoUring() {
+    // Closing the ring cancels everything in flight, the buffers are unused afterwards
+    munmap(m_submissionEntries, m_submissionEntriesSize);
+    munmap(m_submissionRing, m_submissionRingSize);
+    close(m_ringFd);
+    std::free(m_buffers);
+}
+
+bool IoUring::isSupported() {
+    io_uring_params params{};
+    params.flags = setupFlags;
+    params.cq_entries = 8;
+    int ringFd = setup(4, params);
+    if (ringFd < 0) {
+        return false;
+    }
+
+    constexpr unsigned opCount = 64;
+    std::unique_ptr<char[]> probeMemory(new char[sizeof(io_uring_probe) + opCount * sizeof(io_uring_probe_op)]());
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(probeMemory.get());
+    bool supported = (params.features & IORING_FEAT_SINGLE_MMAP) && (params.features & IORING_FEAT_NODROP) && (params.features & IORING_FEAT_EXT_ARG) &&
+                     registerRing(ringFd, IORING_REGISTER_PROBE, probe, opCount) == 0;
+    for (unsigned opcode : {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG, IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL, IORING_OP_PROVIDE_BUFFERS}) {
+        supported = supported && opcode <= probe->last_op && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+    }
+    close(ringFd);
+    // Multishot receives (6.0) are implied by the setup flags, IORING_SETUP_DEFER_TASKRUN needs 6.1
+    return supported;
+}
+
+bool IoUring::enable() {
+    return registerRing(m_ringFd, IORING_REGISTER_ENABLE_RINGS, nullptr, 0) == 0;
+}
+
+bool IoUring::provideBuffers(uint16_t group, unsigned count, size_t size) {
+    m_buffers = static_cast<char*>(std::aligned_alloc(4096, count * size));
+    if (m_buffers == nullptr) {
+        return false;
+    }
+    m_bufferSize = size;
+    m_bufferGroup = group;
+    m_prepareProvide(m_buffers, count, 0);
+    return true;
+}
+
+void IoUring::recycleBuffer(uint16_t bufferId) {
+    m_prepareProvide(m_buffers + bufferId * m_bufferSize, 1, bufferId);
+}
+
+void IoUring::m_prepareProvide(char* buffers, unsigned count, uint16_t firstBufferId) {
+    // Buffer rings (IORING_REGISTER_PBUF_RING) would need no submission at all, but they are not reliably available
+    io_uring_sqe* entry = getSubmissionEntry();
+    entry->opcode = IORING_OP_PROVIDE_BUFFERS;
+    entry->fd = count;
+    entry->addr = reinterpret_cast<uint64_t>(buffers);
+    entry->len = m_bufferSize;
+    entry->off = firstBufferId;
+    entry->buf_group = m_bufferGroup;
+    // Not an operation of the EventLoop, only a failure posts a completion, which is ignored
+    entry->flags = IOSQE_CQE_SKIP_SUCCESS;
+    entry->user_data = 0;
+}
+
+std::string_view IoUring::getBuffer(uint16_t bufferId, size_t length) const {
+    return std::string_view(m_buffers + bufferId * m_bufferSize, length);
+}
+
+uint16_t IoUring::getBufferGroup() const {
+    return m_bufferGroup;
+}
+
+io_uring_sqe* IoUring::getSubmissionEntry() {
+    if (m_preparedTail - __atomic_load_n(m_submissionHead, __ATOMIC_ACQUIRE) == m_submissionCapacity) {
+        submit();
+    }
+    io_uring_sqe* entry = &m_submissionEntries[m_preparedTail & m_submissionMask];
+    std::memset(entry, 0, sizeof(*entry));
+    m_preparedTail++;
+    return entry;
+}
+
+int IoUring::m_enter(unsigned toSubmit, unsigned minComplete, unsigned flags, const void* argument, size_t argumentSize) {
+    int result = static_cast<int>(syscall(__NR_io_uring_enter, m_ringFd, toSubmit, minComplete, flags, argument, argumentSize));
+    return result < 0 ? -errno : result;
+}
+
+int IoUring::submit(unsigned minComplete, int timeoutMs) {
+    unsigned toSubmit = m_preparedTail - *m_submissionTail;
+    __atomic_store_n(m_submissionTail, m_preparedTail, __ATOMIC_RELEASE);
+
+    unsigned flags = IORING_ENTER_GETEVENTS;
+    if (timeoutMs < 0 || minComplete == 0) {
+        return m_enter(toSubmit, minComplete, flags, nullptr, 0);
+    }
+    __kernel_timespec timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000000LL};
+    io_uring_getevents_arg argument{};
+    argument.ts = reinterpret_cast<uint64_t>(&timeout);
+    return m_enter(toSubmit, minComplete, flags | IORING_ENTER_EXT_ARG, &argument, sizeof(argument));
+}
+
+#endif
@@ -0,0 +1,129 @@
+#pragma once
+
+#ifdef CHAT_IO_URING
+
+#include <linux/io_uring.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/*
+ * io_uring instance driven by raw system calls, so liburing is not required
+ * Submissions are prepared in the mmapped submission queue and handed to the kernel in batches by submit(), completions
+ * are read from the mmapped completion queue without any system call. The ring is created disabled and has to be
+ * enabled by the thread using it, as only that thread may submit (IORING_SETUP_SINGLE_ISSUER).
+ * Optionally owns a group of provided buffers, from which the kernel picks the buffer of each multishot receive.
+ */
+class IoUring {
+   private:
+    int m_ringFd;
+
+    void* m_submissionRing;
+    size_t m_submissionRingSize;
+    void* m_completionRing;
+    io_uring_sqe* m_submissionEntries;
+    size_t m_submissionEntriesSize;
+
+    unsigned* m_submissionHead;
+    unsigned* m_submissionTail;
+    unsigned m_submissionMask;
+    unsigned m_submissionCapacity;
+    // Tail including the prepared entries that were not handed to the kernel yet
+    unsigned m_preparedTail;
+
+    unsigned* m_completionHead;
+    unsigned* m_completionTail;
+    unsigned m_completionMask;
+    io_uring_cqe* m_completionEntries;
+
+    // Provided buffers, all of the same size
+    char* m_buffers;
+    size_t m_bufferSize;
+    uint16_t m_bufferGroup;
+
+    void m_prepareProvide(char* buffers, unsigned count, uint16_t firstBufferId);
+    int m_enter(unsigned toSubmit, unsigned minComplete, unsigned flags, const void* argument, size_t argumentSize);
+
+   public:
+    /*
+     * Constructor, sets up a disabled ring
+     * Throws a runtime_error if the kernel does not support io_uring or the required features.
+     * @param entries - capacity of the submission queue, the completion queue is four times as large
+     */
+    IoUring(unsigned entries);
+    IoUring(const IoUring& other) = delete;
+    ~IoUring();
+
+    IoUring& operator=(const IoUring& other) = delete;
+
+    /*
+     * Returns true if io_uring and all operations used by the EventLoop are available
+     */
+    static bool isSupported();
+
+    /*
+     * Enables the ring, the calling thread becomes the only one allowed to submit
+     */
+    bool enable();
+
+    /*
+     * Provides a group of buffers to the kernel, the request is submitted together with the first submission
+     * @param group - buffer group id selected by receives
+     * @param count - number of buffers
+     * @param size - size of every buffer
+     * @return false if the buffers could not be allocated
+     */
+    bool provideBuffers(uint16_t group, unsigned count, size_t size);
+
+    /*
+     * Provides a buffer to the kernel again after its data was consumed, submitted with the next submission
+     */
+    void recycleBuffer(uint16_t bufferId);
+
+    /*
+     * Data of a provided buffer
+     */
+    std::string_view getBuffer(uint16_t bufferId, size_t length) const;
+
+    uint16_t getBufferGroup() const;
+
+    /*
+     * Returns a cleared submission entry, prepared entries are submitted first if the queue is full
+     */
+    io_uring_sqe* getSubmissionEntry();
+
+    /*
+     * Submits the prepared entries and waits for completions
+     * @param minComplete - number of completions to wait for
+     * @param timeoutMs - maximum time to wait, -1 waits indefinitely
+     * @return number of submitted entries, -errno on failure (-ETIME if the timeout elapsed)
+     */
+    int submit(unsigned minComplete = 0, int timeoutMs = -1);
+
+    /*
+     * Invokes the handler for every available completion and consumes them
+     * The handler must not call forEachCompletion itself.
+     * @return number of handled completions
+     */
+    template <typename Handler>
+    unsigned forEachCompletion(Handler handler) {
+        unsigned head = *m_completionHead;
+        unsigned tail = __atomic_load_n(m_completionTail, __ATOMIC_ACQUIRE);
+        unsigned handled = 0;
+        for (; head != tail; head++, handled++) {
+            // Copied, so the slot can be released before the handler submits new work
+            io_uring_cqe completion = m_completionEntries[head & m_completionMask];
+            __atomic_store_n(m_completionHead, head + 1, __ATOMIC_RELEASE);
+            handler(completion);
+        }
+        return handled;
+    }
+};
+
+#else
+
+// Without io_uring support the EventLoop still owns an (always empty) pointer to a ring
+class IoUring {};
+
+#endif
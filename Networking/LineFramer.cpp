@@ -0,0 +1,177 @@
+#include "LineFramer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+LineFramer::LineFramer(BufferPool& pool, size_t maxLineLength) : m_pool{&pool},
+                                                                 m_buffer{nullptr},
+                                                                 m_maxLineLength{maxLineLength},
+                                                                 m_readPos{0},
+                                                                 m_scanPos{0},
+                                                                 m_writePos{0},
+                                                                 m_discarding{false},
+                                                                 m_discardBytes{0} {
+    if (pool.getChunkSize() <= maxLineLength) {
+        throw std::invalid_argument("Buffer pool chunks must be larger than the maximum line length");
+    }
+}
+
+LineFramer::LineFramer(LineFramer&& other) : m_pool{other.m_pool},
+                                             m_buffer{other.m_buffer},
+                                             m_maxLineLength{other.m_maxLineLength},
+                                             m_readPos{other.m_readPos},
+                                             m_scanPos{other.m_scanPos},
+                                             m_writePos{other.m_writePos},
+                                             m_discarding{other.m_discarding},
+                                             m_discardBytes{other.m_discardBytes} {
+    other.m_buffer = nullptr;
+    other.m_readPos = other.m_scanPos = other.m_writePos = 0;
+}
+
+LineFramer::~LineFramer() {
+    if (m_buffer != nullptr) {
+        m_pool->release(m_buffer);
+    }
+}
+
+LineFramer& LineFramer::operator=(LineFramer&& other) {
+    if (this != &other) {
+        if (m_buffer != nullptr) {
+            m_pool->release(m_buffer);
+        }
+        m_pool = other.m_pool;
+        m_buffer = other.m_buffer;
+        m_maxLineLength = other.m_maxLineLength;
+        m_readPos = other.m_readPos;
+        m_scanPos = other.m_scanPos;
+        m_writePos = other.m_writePos;
+        m_discarding = other.m_discarding;
+        m_discardBytes = other.m_discardBytes;
+        other.m_buffer = nullptr;
+        other.m_readPos = other.m_scanPos = other.m_writePos = 0;
+    }
+    return *this;
+}
+
+std::span<char> LineFramer::writableSpace() {
+    if (m_buffer == nullptr) {
+        m_buffer = m_pool->acquire();
+    }
+    if (m_readPos == m_writePos) {
+        m_readPos = m_scanPos = m_writePos = 0;
+    } else if (m_writePos == m_pool->getChunkSize()) {
+        // At most one partial line (shorter than the maximum line length) is buffered, move it to the front
+        size_t buffered = m_writePos - m_readPos;
+        std::memmove(m_buffer, m_buffer + m_readPos, buffered);
+        m_scanPos -= m_readPos;
+        m_readPos = 0;
+        m_writePos = buffered;
+    }
+    return std::span<char>(m_buffer + m_writePos, m_pool->getChunkSize() - m_writePos);
+}
+
+void LineFramer::releaseIfEmpty() {
+    if (m_buffer != nullptr && m_readPos == m_writePos) {
+        m_pool->release(m_buffer);
+        m_buffer = nullptr;
+        m_readPos = m_scanPos = m_writePos = 0;
+    }
+}
+
+void LineFramer::commit(size_t bytes) {
+    m_writePos += bytes;
+}
+
+LineFramer::Result LineFramer::nextLine(std::string_view& line) {
+    while (true) {
+        // memchr is vectorized by the C library, so scanning costs far less than a byte per cycle
+        if (m_buffer == nullptr) {
+            return Result::NEED_MORE_DATA;
+        }
+        const char* begin = m_buffer;
+        const char* delimiter = static_cast<const char*>(std::memchr(begin + m_scanPos, '\n', m_writePos - m_scanPos));
+
+        if (m_discarding) {
+            m_readPos = m_scanPos = delimiter != nullptr ? delimiter - begin + 1 : m_writePos;
+            if (delimiter == nullptr) {
+                return Result::NEED_MORE_DATA;
+            }
+            m_discarding = false;
+            continue;
+        }
+
+        if (delimiter == nullptr) {
+            m_scanPos = m_writePos;
+            if (m_writePos - m_readPos > m_maxLineLength) {
+                // Drop what was received so far and skip the rest of the line once its delimiter arrives
+                m_readPos = m_scanPos = m_writePos;
+                m_discarding = true;
+                return Result::LINE_TOO_LONG;
+            }
+            return Result::NEED_MORE_DATA;
+        }
+
+        size_t lineStart = m_readPos;
+        size_t lineLength = delimiter - begin - lineStart;
+        m_readPos = m_scanPos = delimiter - begin + 1;
+        if (lineLength > m_maxLineLength) {
+            return Result::LINE_TOO_LONG;
+        }
+        if (lineLength > 0 && begin[lineStart + lineLength - 1] == '\r') {
+            lineLength--;
+        }
+        line = std::string_view(begin + lineStart, lineLength);
+        return Result::LINE;
+    }
+}
+
+LineFramer::Result LineFramer::nextFrame(FrameHeader& header, std::string_view& payload) {
+    // A partial frame has to fit into the chunk once it was moved to the front
+    size_t maxPayload = std::min(m_maxLineLength, m_pool->getChunkSize() - FrameHeader::SIZE);
+    while (true) {
+        if (m_buffer == nullptr) {
+            return Result::NEED_MORE_DATA;
+        }
+
+        if (m_discardBytes > 0) {
+            size_t skipped = std::min(m_discardBytes, m_writePos - m_readPos);
+            m_readPos = m_scanPos = m_readPos + skipped;
+            m_discardBytes -= skipped;
+            if (m_discardBytes > 0) {
+                return Result::NEED_MORE_DATA;
+            }
+            continue;
+        }
+
+        if (m_writePos - m_readPos < FrameHeader::SIZE) {
+            return Result::NEED_MORE_DATA;
+        }
+        header = readFrameHeader(m_buffer + m_readPos);
+        if (header.length > maxPayload) {
+            m_readPos = m_scanPos = m_readPos + FrameHeader::SIZE;
+            m_discardBytes = header.length;
+            return Result::LINE_TOO_LONG;
+        }
+        if (m_writePos - m_readPos - FrameHeader::SIZE < header.length) {
+            return Result::NEED_MORE_DATA;
+        }
+
+        payload = std::string_view(m_buffer + m_readPos + FrameHeader::SIZE, header.length);
+        m_readPos = m_scanPos = m_readPos + FrameHeader::SIZE + header.length;
+        return Result::LINE;
+    }
+}
+
+bool LineFramer::skipByte(char byte) {
+    if (m_buffer == nullptr || m_readPos == m_writePos || m_buffer[m_readPos] != byte) {
+        return false;
+    }
+    m_readPos++;
+    m_scanPos = std::max(m_scanPos, m_readPos);
+    return true;
+}
+
+size_t LineFramer::getBufferedBytes() const {
+    return m_writePos - m_readPos;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+#include "BinaryFrame.hpp"
+#include "BufferPool.hpp"
+
+/*
+ * Splits a byte stream into newline terminated lines, or into binary frames once the peer switched to those
+ * Received bytes are written directly into the framer's buffer and complete lines are handed out as views into that
+ * buffer, so framing neither allocates nor copies. A view stays valid until writable space is requested again.
+ * The buffer is a chunk of a shared BufferPool, which is only held while data is buffered.
+ */
+class LineFramer {
+   public:
+    enum class Result {
+        // A complete line (or frame) was extracted
+        LINE,
+        // No complete line is buffered, more data has to be received
+        NEED_MORE_DATA,
+        // A line (or the payload of a frame) exceeded the maximum line length and was discarded
+        LINE_TOO_LONG
+    };
+
+   private:
+    BufferPool* m_pool;
+    char* m_buffer;
+    size_t m_maxLineLength;
+
+    // Start of the first unconsumed line
+    size_t m_readPos;
+    // Everything before this position was already searched for a delimiter
+    size_t m_scanPos;
+    // End of the received data
+    size_t m_writePos;
+
+    // Set while skipping the rest of a line that was too long
+    bool m_discarding;
+    // Remaining payload bytes of a frame that was too long
+    size_t m_discardBytes;
+
+   public:
+    /*
+     * Constructor
+     * @param pool - pool providing the receive buffer, its chunks must be larger than maxLineLength
+     * @param maxLineLength - longest accepted line, excluding the delimiter
+     */
+    LineFramer(BufferPool& pool, size_t maxLineLength);
+    LineFramer(const LineFramer& other) = delete;
+    LineFramer(LineFramer&& other);
+    ~LineFramer();
+
+    LineFramer& operator=(const LineFramer& other) = delete;
+    LineFramer& operator=(LineFramer&& other);
+
+    /*
+     * Returns the free space behind the buffered data, acquiring a buffer or compacting it if necessary
+     * Invalidates all views handed out by nextLine
+     */
+    std::span<char> writableSpace();
+
+    /*
+     * Returns the buffer to the pool if no data is buffered
+     * Invalidates all views handed out by nextLine
+     */
+    void releaseIfEmpty();
+
+    /*
+     * Marks bytes written into the writable space as received
+     */
+    void commit(size_t bytes);
+
+    /*
+     * Extracts the next complete line
+     * @param line - set to the line without its delimiter (a trailing '\r' is removed as well)
+     */
+    Result nextLine(std::string_view& line);
+
+    /*
+     * Extracts the next complete binary frame
+     * Payloads longer than the maximum line length (or than fits into a chunk next to the header) are skipped.
+     * @param header - set to the header of the frame
+     * @param payload - set to the header.length bytes following the header
+     */
+    Result nextFrame(FrameHeader& header, std::string_view& payload);
+
+    /*
+     * Consumes the next buffered byte if it equals the given one
+     * @return true if it was consumed
+     */
+    bool skipByte(char byte);
+
+    /*
+     * Number of received bytes that were not yet consumed as a line
+     */
+    size_t getBufferedBytes() const;
+};
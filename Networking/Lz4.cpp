@@ -0,0 +1,172 @@
+#include "Lz4.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+inline uint32_t read32(const char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// Lengths of 15 and more continue in bytes of 255 after the token
+void appendLength(std::string& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+// Reads the continuation of a length whose token nibble was 15
+bool readLength(std::string_view block, size_t& pos, size_t& length) {
+    uint8_t byte;
+    do {
+        if (pos == block.size()) {
+            return false;
+        }
+        byte = static_cast<uint8_t>(block[pos++]);
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+}  // namespace
+
+Lz4::Lz4(std::string_view dictionary) : m_dictionary{dictionary.substr(dictionary.size() - std::min(dictionary.size(), MAX_OFFSET))} {
+    m_dictionaryTable.fill(m_noPosition);
+    for (size_t pos = 0; pos + m_minMatch <= m_dictionary.size(); pos++) {
+        m_dictionaryTable[m_hash(m_dictionary.data() + pos)] = static_cast<uint32_t>(pos);
+    }
+}
+
+uint32_t Lz4::m_hash(const char* data) {
+    return (read32(data) * 2654435761u) >> (32 - m_hashBits);
+}
+
+size_t Lz4::compress(std::string_view input, std::string& out) const {
+    size_t outStart = out.size();
+    // Matches may reach from the input into the dictionary, so both are searched as one buffer
+    thread_local std::string window;
+    window.assign(m_dictionary).append(input);
+    const char* src = window.data();
+    size_t base = m_dictionary.size();
+    size_t end = window.size();
+    out.reserve(outStart + maxCompressedSize(input.size()));
+
+    auto emit = [&](size_t anchor, size_t literalEnd, size_t offset, size_t matchLength) {
+        size_t literalLength = literalEnd - anchor;
+        size_t tokenPos = out.size();
+        out.push_back(static_cast<char>(std::min<size_t>(literalLength, 15) << 4));
+        if (literalLength >= 15) {
+            appendLength(out, literalLength - 15);
+        }
+        out.append(src + anchor, literalLength);
+        if (matchLength == 0) {
+            return;
+        }
+        out.push_back(static_cast<char>(offset & 0xFF));
+        out.push_back(static_cast<char>(offset >> 8));
+        size_t extraLength = matchLength - m_minMatch;
+        out[tokenPos] = static_cast<char>(static_cast<uint8_t>(out[tokenPos]) | std::min<size_t>(extraLength, 15));
+        if (extraLength >= 15) {
+            appendLength(out, extraLength - 15);
+        }
+    };
+
+    size_t anchor = base;
+    if (input.size() > m_matchStartLimit) {
+        std::array<uint32_t, 1 << m_hashBits> table = m_dictionaryTable;
+        size_t matchEnd = end - m_lastLiterals;
+        size_t pos = base;
+        while (pos < end - m_matchStartLimit) {
+            uint32_t hash = m_hash(src + pos);
+            uint32_t candidate = table[hash];
+            table[hash] = static_cast<uint32_t>(pos);
+            if (candidate == m_noPosition || pos - candidate > MAX_OFFSET || read32(src + candidate) != read32(src + pos)) {
+                // Skips faster through data without matches
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+
+            // Extends the match backwards into the pending literals, then forwards
+            size_t matchStart = pos;
+            while (matchStart > anchor && candidate > 0 && src[matchStart - 1] == src[candidate - 1]) {
+                matchStart--;
+                candidate--;
+            }
+            size_t matchLength = pos - matchStart + m_minMatch;
+            while (matchStart + matchLength < matchEnd && src[candidate + matchLength] == src[matchStart + matchLength]) {
+                matchLength++;
+            }
+            emit(anchor, matchStart, matchStart - candidate, matchLength);
+            pos = anchor = matchStart + matchLength;
+        }
+    }
+    emit(anchor, end, 0, 0);
+    return out.size() - outStart;
+}
+
+bool Lz4::decompress(std::string_view block, size_t size, std::string& out) const {
+    // Matches may refer to the dictionary, which precedes the output while decoding
+    thread_local std::string window;
+    size_t base = m_dictionary.size();
+    window.resize(base + size);
+    std::memcpy(window.data(), m_dictionary.data(), base);
+    char* dst = window.data();
+    size_t outPos = base;
+    size_t outEnd = base + size;
+
+    size_t pos = 0;
+    while (pos < block.size()) {
+        uint8_t token = static_cast<uint8_t>(block[pos++]);
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(block, pos, literalLength)) {
+            return false;
+        }
+        if (block.size() - pos < literalLength || outEnd - outPos < literalLength) {
+            return false;
+        }
+        std::memcpy(dst + outPos, block.data() + pos, literalLength);
+        outPos += literalLength;
+        pos += literalLength;
+        if (pos == block.size()) {
+            // The last sequence has no match
+            break;
+        }
+
+        if (block.size() - pos < 2) {
+            return false;
+        }
+        size_t offset = static_cast<uint8_t>(block[pos]) | (static_cast<size_t>(static_cast<uint8_t>(block[pos + 1])) << 8);
+        pos += 2;
+        size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !readLength(block, pos, matchLength)) {
+            return false;
+        }
+        matchLength += m_minMatch;
+        if (offset == 0 || offset > outPos || outEnd - outPos < matchLength) {
+            return false;
+        }
+        if (offset >= matchLength) {
+            std::memcpy(dst + outPos, dst + outPos - offset, matchLength);
+        } else {
+            // The match overlaps the bytes it produces (a repetition), so it is copied bytewise
+            for (size_t byteIdx = 0; byteIdx < matchLength; byteIdx++) {
+                dst[outPos + byteIdx] = dst[outPos - offset + byteIdx];
+            }
+        }
+        outPos += matchLength;
+    }
+    if (outPos != outEnd) {
+        return false;
+    }
+    out.append(window, base, size);
+    return true;
+}
+
+size_t Lz4::maxCompressedSize(size_t inputSize) {
+    return inputSize + inputSize / 255 + 16;
+}
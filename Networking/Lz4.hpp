@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+ * LZ4 block format compression, bundled so compressed frames need no compression library
+ * A dictionary acts as data preceding the input, so even short inputs find matches in it. Its hash table is built once
+ * on construction and copied per call, so compress is const and one compressor can be shared by all threads.
+ * The compressor is greedy and single pass, trading ratio for speed like the reference implementation's fast mode.
+ */
+class Lz4 {
+   public:
+    // Longest distance a match may refer back, dictionaries are limited to it
+    static constexpr size_t MAX_OFFSET = 65535;
+
+   private:
+    static constexpr unsigned int m_hashBits = 12;
+    static constexpr uint32_t m_noPosition = UINT32_MAX;
+    // The last 5 bytes are always literals and the last match starts at least 12 bytes before the end
+    static constexpr size_t m_lastLiterals = 5;
+    static constexpr size_t m_matchStartLimit = 12;
+    static constexpr size_t m_minMatch = 4;
+
+    std::string m_dictionary;
+    // Position within the dictionary of the last sequence of 4 bytes with every hash
+    std::array<uint32_t, 1 << m_hashBits> m_dictionaryTable;
+
+    static uint32_t m_hash(const char* data);
+
+   public:
+    /*
+     * Constructor
+     * @param dictionary - data the compressed blocks may refer to, only its last MAX_OFFSET bytes are used
+     */
+    explicit Lz4(std::string_view dictionary = {});
+
+    /*
+     * Appends the compressed block of the input
+     * @return number of appended bytes, at most maxCompressedSize(input.size())
+     */
+    size_t compress(std::string_view input, std::string& out) const;
+
+    /*
+     * Appends the decompressed data of a block compressed with the same dictionary
+     * @param size - size of the decompressed data
+     * @return false if the block is corrupt or does not decompress to exactly size bytes
+     */
+    bool decompress(std::string_view block, size_t size, std::string& out) const;
+
+    /*
+     * Size of a block in the worst case, i.e. of incompressible data
+     */
+    static size_t maxCompressedSize(size_t inputSize);
+};
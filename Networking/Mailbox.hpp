@@ -0,0 +1,74 @@
+#pragma once
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "MpscQueue.hpp"
+
+/*
+ * Lock-free inbound queue of an event loop thread
+ * Other threads post values, the owning thread is woken up through an eventfd, which can be registered with its EventLoop
+ */
+template <typename T>
+class Mailbox {
+   private:
+    MpscQueue<T> m_queue;
+    int m_eventFd;
+
+    // Set while a wakeup is pending, so a burst of posts only costs a single eventfd write
+    std::atomic<bool> m_signaled;
+
+   public:
+    Mailbox() : m_eventFd{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)}, m_signaled{false} {
+        if (m_eventFd == -1) {
+            throw std::runtime_error("Failed to create eventfd, errno: " + std::to_string(errno));
+        }
+    }
+
+    Mailbox(const Mailbox& other) = delete;
+    Mailbox& operator=(const Mailbox& other) = delete;
+
+    ~Mailbox() {
+        close(m_eventFd);
+    }
+
+    /*
+     * Posts a value to the owning thread, safe to call from any thread
+     */
+    void post(T value) {
+        m_queue.push(std::move(value));
+        if (!m_signaled.exchange(true)) {
+            uint64_t one = 1;
+            [[maybe_unused]] ssize_t written = ::write(m_eventFd, &one, sizeof(one));
+        }
+    }
+
+    /*
+     * Hands all pending values to the handler, must only be called by the owning thread
+     * @param handler - callable invoked with every value in posting order
+     */
+    template <typename Handler>
+    void drain(Handler&& handler) {
+        uint64_t count;
+        [[maybe_unused]] ssize_t bytesRead = ::read(m_eventFd, &count, sizeof(count));
+        m_signaled.exchange(false);
+
+        T value;
+        while (m_queue.pop(value)) {
+            handler(std::move(value));
+        }
+    }
+
+    /*
+     * File descriptor that becomes readable when values were posted
+     */
+    int getFd() const {
+        return m_eventFd;
+    }
+};
@@ -0,0 +1,133 @@
+#include "MessageBuffer.hpp"
+
+#include <cstring>
+#include <new>
+
+/*
+    MessageBuffer class implementation
+*/
+
+MessageBuffer::MessageBuffer(uint32_t size) : m_refCount{1}, m_size{size} {}
+
+char* MessageBuffer::m_data() {
+    return reinterpret_cast<char*>(this + 1);
+}
+
+void MessageBuffer::m_addRef() {
+    m_refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MessageBuffer::m_release() {
+    if (m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        this->~MessageBuffer();
+        ::operator delete(this);
+    }
+}
+
+MessageRef MessageBuffer::create(std::initializer_list<std::string_view> parts) {
+    size_t size = 0;
+    for (const auto& part : parts) {
+        size += part.size();
+    }
+
+    // Header and bytes share one allocation
+    void* memory = ::operator new(sizeof(MessageBuffer) + size);
+    MessageBuffer* buffer = new (memory) MessageBuffer(static_cast<uint32_t>(size));
+    char* data = buffer->m_data();
+    for (const auto& part : parts) {
+        // Views of empty references have no data pointer
+        if (!part.empty()) {
+            std::memcpy(data, part.data(), part.size());
+            data += part.size();
+        }
+    }
+
+    MessageRef ref;
+    ref.m_buffer = buffer;
+    ref.m_data = buffer->m_data();
+    ref.m_size = size;
+    return ref;
+}
+
+/*
+    MessageRef class implementation
+*/
+
+MessageRef::MessageRef() : m_buffer{nullptr}, m_data{nullptr}, m_size{0} {}
+
+MessageRef::MessageRef(const MessageRef& other) : m_buffer{other.m_buffer}, m_data{other.m_data}, m_size{other.m_size} {
+    if (m_buffer != nullptr) {
+        m_buffer->m_addRef();
+    }
+}
+
+MessageRef::MessageRef(MessageRef&& other) : m_buffer{other.m_buffer}, m_data{other.m_data}, m_size{other.m_size} {
+    other.m_buffer = nullptr;
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+MessageRef::~MessageRef() {
+    if (m_buffer != nullptr) {
+        m_buffer->m_release();
+    }
+}
+
+MessageRef& MessageRef::operator=(const MessageRef& other) {
+    if (this != &other) {
+        MessageRef copy{other};
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+MessageRef& MessageRef::operator=(MessageRef&& other) {
+    if (this != &other) {
+        if (m_buffer != nullptr) {
+            m_buffer->m_release();
+        }
+        m_buffer = other.m_buffer;
+        m_data = other.m_data;
+        m_size = other.m_size;
+        other.m_buffer = nullptr;
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+MessageRef MessageRef::fromStatic(std::string_view data) {
+    MessageRef ref;
+    ref.m_data = data.data();
+    ref.m_size = data.size();
+    return ref;
+}
+
+MessageRef MessageRef::suffix(size_t offset) const {
+    MessageRef ref{*this};
+    ref.m_data += offset;
+    ref.m_size -= offset;
+    return ref;
+}
+
+MessageRef MessageRef::prefix(size_t size) const {
+    MessageRef ref{*this};
+    ref.m_size = size;
+    return ref;
+}
+
+const char* MessageRef::data() const {
+    return m_data;
+}
+
+size_t MessageRef::size() const {
+    return m_size;
+}
+
+bool MessageRef::empty() const {
+    return m_size == 0;
+}
+
+std::string_view MessageRef::view() const {
+    return std::string_view(m_data, m_size);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+
+class MessageRef;
+
+/*
+ * Immutable, reference counted message bytes
+ * The header and the bytes live in a single allocation, so creating a buffer costs exactly one allocation no matter
+ * how many connections (or threads) reference it afterwards
+ */
+class MessageBuffer {
+   private:
+    std::atomic<uint32_t> m_refCount;
+    uint32_t m_size;
+
+    MessageBuffer(uint32_t size);
+
+    char* m_data();
+
+    void m_addRef();
+    void m_release();
+
+    friend class MessageRef;
+
+   public:
+    MessageBuffer(const MessageBuffer& other) = delete;
+    MessageBuffer& operator=(const MessageBuffer& other) = delete;
+
+    /*
+     * Creates a buffer holding the concatenation of all parts
+     */
+    static MessageRef create(std::initializer_list<std::string_view> parts);
+};
+
+/*
+ * Reference to (a slice of) a MessageBuffer, or to static data that outlives every connection
+ * Copying a reference only increments the reference count of the buffer, the bytes are never copied
+ */
+class MessageRef {
+   private:
+    MessageBuffer* m_buffer;
+    const char* m_data;
+    size_t m_size;
+
+    friend class MessageBuffer;
+
+   public:
+    MessageRef();
+    MessageRef(const MessageRef& other);
+    MessageRef(MessageRef&& other);
+    ~MessageRef();
+
+    MessageRef& operator=(const MessageRef& other);
+    MessageRef& operator=(MessageRef&& other);
+
+    /*
+     * References static data (e.g. string literals), which is never freed
+     */
+    static MessageRef fromStatic(std::string_view data);
+
+    /*
+     * Returns a reference to the bytes starting at offset, sharing the same buffer
+     */
+    MessageRef suffix(size_t offset) const;
+
+    /*
+     * Returns a reference to the first size bytes, sharing the same buffer
+     */
+    MessageRef prefix(size_t size) const;
+
+    const char* data() const;
+    size_t size() const;
+    bool empty() const;
+    std::string_view view() const;
+};
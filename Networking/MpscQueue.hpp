@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+/*
+ * Unbounded lock-free multi-producer single-consumer queue (Vyukov)
+ * Any thread may push, only the owning thread may pop
+ */
+template <typename T>
+class MpscQueue {
+   private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value{};
+    };
+
+    // Producers append at the head, the consumer removes from the tail, which always points to a consumed stub node
+    std::atomic<Node*> m_head;
+    Node* m_tail;
+
+   public:
+    MpscQueue() {
+        Node* stub = new Node();
+        m_head.store(stub, std::memory_order_relaxed);
+        m_tail = stub;
+    }
+
+    MpscQueue(const MpscQueue& other) = delete;
+    MpscQueue& operator=(const MpscQueue& other) = delete;
+
+    ~MpscQueue() {
+        while (m_tail != nullptr) {
+            Node* next = m_tail->next.load(std::memory_order_relaxed);
+            delete m_tail;
+            m_tail = next;
+        }
+    }
+
+    /*
+     * Appends a value, safe to call from any thread
+     */
+    void push(T value) {
+        Node* node = new Node();
+        node->value = std::move(value);
+        Node* previous = m_head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    /*
+     * Removes the oldest value, must only be called by the consumer thread
+     * @param value - receives the removed value
+     * @return false if the queue is empty
+     */
+    bool pop(T& value) {
+        Node* next = m_tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+        value = std::move(next->value);
+        delete m_tail;
+        m_tail = next;
+        return true;
+    }
+};
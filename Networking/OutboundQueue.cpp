@@ -0,0 +1,133 @@
+#include "OutboundQueue.hpp"
+
+#include <sys/uio.h>
+
+#include <cerrno>
+
+OutboundQueue::OutboundQueue() : m_head{0}, m_count{0}, m_bytes{0} {}
+
+OutboundQueue::Segment& OutboundQueue::m_at(size_t index) {
+    return m_segments[(m_head + index) & (m_segments.size() - 1)];
+}
+
+void OutboundQueue::m_grow() {
+    std::vector<Segment> segments(m_segments.empty() ? 8 : m_segments.size() * 2);
+    for (size_t segmentIdx = 0; segmentIdx < m_count; segmentIdx++) {
+        segments[segmentIdx] = std::move(m_at(segmentIdx));
+    }
+    m_segments = std::move(segments);
+    m_head = 0;
+}
+
+void OutboundQueue::m_popFront() {
+    m_at(0).data = MessageRef();
+    m_head = (m_head + 1) & (m_segments.size() - 1);
+    m_count--;
+}
+
+void OutboundQueue::push(std::span<const MessageRef> segments, size_t firstOffset) {
+    for (size_t segmentIdx = 0; segmentIdx < segments.size(); segmentIdx++) {
+        if (m_count == m_segments.size()) {
+            m_grow();
+        }
+        MessageRef data = segmentIdx == 0 && firstOffset > 0 ? segments[0].suffix(firstOffset) : segments[segmentIdx];
+        m_bytes += data.size();
+        m_at(m_count) = Segment{std::move(data), segmentIdx + 1 == segments.size()};
+        m_count++;
+    }
+}
+
+bool OutboundQueue::flush(TCPSocket& socket) {
+    iovec iov[m_maxSegmentsPerWrite];
+    while (m_count > 0) {
+        size_t iovCount = gather(iov, m_maxSegmentsPerWrite);
+        size_t offeredBytes = 0;
+        for (size_t iovIdx = 0; iovIdx < iovCount; iovIdx++) {
+            offeredBytes += iov[iovIdx].iov_len;
+        }
+
+        ssize_t written = socket.sendv(iov, iovCount);
+        if (written == -1) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+
+        consume(written);
+        if (static_cast<size_t>(written) < offeredBytes) {
+            // Short write, the socket is full
+            return true;
+        }
+    }
+    return true;
+}
+
+size_t OutboundQueue::gather(iovec* iov, size_t maxCount) {
+    size_t iovCount = 0;
+    for (; iovCount < m_count && iovCount < maxCount; iovCount++) {
+        const MessageRef& data = m_at(iovCount).data;
+        iov[iovCount].iov_base = const_cast<char*>(data.data());
+        iov[iovCount].iov_len = data.size();
+    }
+    return iovCount;
+}
+
+void OutboundQueue::consume(size_t written) {
+    m_bytes -= written;
+    while (written > 0 && written >= m_at(0).data.size()) {
+        written -= m_at(0).data.size();
+        m_popFront();
+    }
+    if (written > 0) {
+        // The front segment was written partially, keep referencing the rest of the same buffer
+        m_at(0).data = m_at(0).data.suffix(written);
+    }
+}
+
+size_t OutboundQueue::dropOldest(size_t targetBytes) {
+    if (m_bytes <= targetBytes || m_count == 0) {
+        return 0;
+    }
+
+    // The front message might be partially written (its first segment would have been shortened), so it is kept.
+    // Segments are compacted behind the kept message.
+    size_t keptCount = 0;
+    while (keptCount < m_count && !m_at(keptCount).endOfMessage) {
+        keptCount++;
+    }
+    keptCount = keptCount < m_count ? keptCount + 1 : keptCount;
+
+    size_t dropEnd = keptCount;
+    size_t dropCount = 0;
+    while (m_bytes > targetBytes && dropEnd < m_count) {
+        m_bytes -= m_at(dropEnd).data.size();
+        if (m_at(dropEnd).endOfMessage) {
+            dropCount++;
+        }
+        dropEnd++;
+    }
+    // Never stop in the middle of a message
+    while (dropEnd < m_count && !m_at(dropEnd - 1).endOfMessage) {
+        m_bytes -= m_at(dropEnd).data.size();
+        if (m_at(dropEnd).endOfMessage) {
+            dropCount++;
+        }
+        dropEnd++;
+    }
+
+    size_t moveCount = m_count - dropEnd;
+    for (size_t segmentIdx = 0; segmentIdx < moveCount; segmentIdx++) {
+        m_at(keptCount + segmentIdx) = std::move(m_at(dropEnd + segmentIdx));
+    }
+    for (size_t segmentIdx = keptCount + moveCount; segmentIdx < m_count; segmentIdx++) {
+        m_at(segmentIdx).data = MessageRef();
+    }
+    m_count = keptCount + moveCount;
+    return dropCount;
+}
+
+size_t OutboundQueue::getBytes() const {
+    return m_bytes;
+}
+
+bool OutboundQueue::empty() const {
+    return m_count == 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "MessageBuffer.hpp"
+#include "TCPSocket.hpp"
+
+/*
+ * What happens to a connection whose outbound queue grows beyond the high watermark
+ */
+enum class SlowConsumerPolicy {
+    // Discard the oldest queued messages until the queue is back at the low watermark
+    DROP_OLDEST,
+    // Close the connection
+    DISCONNECT,
+    // Stop queueing new messages and stop reading from the client until the queue drained to the low watermark
+    PAUSE
+};
+
+struct OutboundLimits {
+    size_t highWatermark = 1024 * 1024;
+    size_t lowWatermark = 256 * 1024;
+    SlowConsumerPolicy policy = SlowConsumerPolicy::DROP_OLDEST;
+};
+
+/*
+ * Messages waiting to be written to a non-blocking socket
+ * A message consists of one or more segments (e.g. sender prefix and payload), which reference shared buffers and are
+ * written with a single vectored send
+ */
+class OutboundQueue {
+   private:
+    struct Segment {
+        MessageRef data;
+        // Set on the last segment of a message, messages are only ever dropped as a whole
+        bool endOfMessage;
+    };
+
+    // Ring buffer of segments, its capacity is always a power of two
+    std::vector<Segment> m_segments;
+    size_t m_head;
+    size_t m_count;
+
+    // Bytes that still have to be written
+    size_t m_bytes;
+
+    // Maximum number of segments handed to a single sendmsg call
+    static constexpr size_t m_maxSegmentsPerWrite = 256;
+
+    Segment& m_at(size_t index);
+    void m_grow();
+    void m_popFront();
+
+   public:
+    OutboundQueue();
+
+    /*
+     * Appends a message to the end of the queue
+     * @param segments - segments of the message, only their references are stored
+     * @param firstOffset - number of bytes of the first segment that were already written
+     */
+    void push(std::span<const MessageRef> segments, size_t firstOffset = 0);
+
+    /*
+     * Writes queued data until the queue is empty or the socket would block
+     * @param socket - non-blocking socket to write to
+     * @return false if the socket failed
+     */
+    bool flush(TCPSocket& socket);
+
+    /*
+     * Describes the queued data from the front, for writing it with a request of its own (e.g. a batched send)
+     * @param iov - receives the segments
+     * @param maxCount - capacity of iov
+     * @return number of filled entries
+     */
+    size_t gather(iovec* iov, size_t maxCount);
+
+    /*
+     * Removes bytes that were written from the front of the queue
+     */
+    void consume(size_t written);
+
+    /*
+     * Discards the oldest messages until at most targetBytes are queued
+     * The front message is never discarded, as it might be partially written and dropping it would corrupt the stream
+     * @return number of discarded messages
+     */
+    size_t dropOldest(size_t targetBytes);
+
+    size_t getBytes() const;
+    bool empty() const;
+};
@@ -2,12 +2,15 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
 #include <unistd.h>
 #include <poll.h>
 
-#include <iostream>
 #include <stdexcept>
 
+#include "../Logging/Logger.hpp"
+
 /*
     SockAddr class implementation
 */
@@ -38,6 +41,10 @@ uint16_t SockAddr::getPort() const {
     return ntohs(m_addr.sin_port);
 }
 
+uint32_t SockAddr::getAddress() const {
+    return m_addr.sin_addr.s_addr;
+}
+
 SockAddr::operator std::string() const {
     return getIp() + ":" + std::to_string(getPort());
 }
@@ -110,13 +117,12 @@ bool TCPSocket::connect(const std::string& ip, uint16_t port) {
     return true;
 }
 
-bool TCPSocket::bind(uint16_t port) {
+bool TCPSocket::bind(uint16_t port, bool loopbackOnly) {
     sockaddr_in addr;
     addr.sin_family = AF_INET;
     addr.sin_port = htons(port);
-    addr.sin_addr.s_addr = INADDR_ANY;
-    int ret = ::bind(m_sockfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
-    if (ret == -1) {
+    addr.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+    if (::bind(m_sockfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
         return false;
     }
     m_localAddr = SockAddr(addr);
@@ -127,12 +133,12 @@ bool TCPSocket::listen(int backlog) {
     return ::listen(m_sockfd, backlog) == 0;
 }
 
-TCPSocket TCPSocket::accept() {
+TCPSocket TCPSocket::accept(bool nonBlocking) {
     sockaddr_in remoteAddr;
     socklen_t remoteAddrLen = sizeof(remoteAddr);
-    int newSockFd = ::accept(m_sockfd, reinterpret_cast<sockaddr*>(&remoteAddr), &remoteAddrLen);
+    int newSockFd = ::accept4(m_sockfd, reinterpret_cast<sockaddr*>(&remoteAddr), &remoteAddrLen, nonBlocking ? SOCK_NONBLOCK | SOCK_CLOEXEC : SOCK_CLOEXEC);
     if (newSockFd == -1) {
-        throw std::runtime_error("Failed to accept connection, errno: " + std::to_string(errno));
+        return TCPSocket();
     }
     TCPSocket newTCPSocket;
     newTCPSocket.m_setSockFd(newSockFd);
@@ -141,20 +147,73 @@ TCPSocket TCPSocket::accept() {
 }
 
 bool TCPSocket::send(const std::string& data) {
-    return ::send(m_sockfd, data.c_str(), data.size(), 0) == static_cast<int>(data.size());
+    return ::send(m_sockfd, data.c_str(), data.size(), MSG_NOSIGNAL) == static_cast<int>(data.size());
+}
+
+ssize_t TCPSocket::sendSome(const char* data, size_t size) {
+    return ::send(m_sockfd, data, size, MSG_NOSIGNAL);
+}
+
+ssize_t TCPSocket::sendv(const iovec* iov, size_t iovCount) {
+    // sendmsg instead of writev, as writev has no way to suppress SIGPIPE
+    msghdr message{};
+    message.msg_iov = const_cast<iovec*>(iov);
+    message.msg_iovlen = iovCount;
+    return ::sendmsg(m_sockfd, &message, MSG_NOSIGNAL);
+}
+
+ssize_t TCPSocket::sendFile(int fileFd, off_t& offset, size_t count) {
+    return ::sendfile(m_sockfd, fileFd, &offset, count);
 }
 
 std::string TCPSocket::recv(int size) {
-    std::vector<char> buffer(size);
-    int bytesReceived = ::recv(m_sockfd, buffer.data(), size, 0);
+    // Receives straight into the string, recvSome is the allocation free alternative
+    std::string data(size, '\0');
+    ssize_t bytesReceived = recvSome(data.data(), size);
     if (bytesReceived == -1) {
-        std::cout << "Failed to receive data, error number: " << errno << std::endl;
+        Logger::warning("Failed to receive data, error number: ", errno);
         return std::string();
     }
-    if (bytesReceived == 0) {
-        return std::string();
+    data.resize(bytesReceived);
+    return data;
+}
+
+ssize_t TCPSocket::recvSome(char* buffer, size_t size) {
+    return ::recv(m_sockfd, buffer, size, 0);
+}
+
+bool TCPSocket::recvNonBlocking(std::string& data, int size) {
+    data.resize(size);
+    ssize_t bytesReceived = ::recv(m_sockfd, data.data(), size, MSG_DONTWAIT);
+    if (bytesReceived == -1) {
+        data.clear();
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
     }
-    return std::string(buffer.data(), bytesReceived);
+    data.resize(bytesReceived);
+    return bytesReceived > 0;
+}
+
+bool TCPSocket::setNonBlocking(bool nonBlocking) {
+    int flags = fcntl(m_sockfd, F_GETFL, 0);
+    if (flags == -1) {
+        return false;
+    }
+    flags = nonBlocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+    return fcntl(m_sockfd, F_SETFL, flags) == 0;
+}
+
+bool TCPSocket::setReusePort(bool reusePort) {
+    int value = reusePort ? 1 : 0;
+    return ::setsockopt(m_sockfd, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value)) == 0;
+}
+
+bool TCPSocket::setReuseAddress(bool reuseAddress) {
+    int value = reuseAddress ? 1 : 0;
+    return ::setsockopt(m_sockfd, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value)) == 0;
+}
+
+bool TCPSocket::isValid() const {
+    return m_sockfd != -1;
 }
 
 int TCPSocket::getSockFd() const {
@@ -198,3 +257,14 @@ TCPSocket TCPSocket::stdinSocket() {
     socket.m_setSockFd(STDIN_FILENO);
     return socket;
 }
+
+TCPSocket TCPSocket::adopt(int sockFd) {
+    TCPSocket socket;
+    socket.m_setSockFd(sockFd);
+    sockaddr_in remoteAddr;
+    socklen_t remoteAddrLen = sizeof(remoteAddr);
+    if (::getpeername(sockFd, reinterpret_cast<sockaddr*>(&remoteAddr), &remoteAddrLen) == 0) {
+        socket.m_setRemoteAddr(SockAddr(remoteAddr));
+    }
+    return socket;
+}
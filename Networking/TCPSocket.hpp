@@ -1,6 +1,7 @@
 #pragma once
 
 #include <arpa/inet.h>
+#include <sys/uio.h>
 
 #include <string>
 #include <vector>
@@ -21,6 +22,11 @@ class SockAddr {
     std::string getIp() const;
     uint16_t getPort() const;
 
+    /*
+     * IPv4 address in network byte order
+     */
+    uint32_t getAddress() const;
+
     operator std::string() const;
     friend std::ostream& operator<<(std::ostream& os, const SockAddr& addr);
 };
@@ -45,12 +51,75 @@ class TCPSocket {
 
 
     bool connect(const std::string& ip, uint16_t port);
-    bool bind(uint16_t port);
+    /*
+     * Binds the socket to a port on all interfaces, or only on the loopback interface
+     */
+    bool bind(uint16_t port, bool loopbackOnly = false);
     bool listen(int backlog);
-    TCPSocket accept();
+    /*
+     * Accepts a pending connection, the accepted socket is not inherited by child processes
+     * @param nonBlocking - put the accepted socket into non-blocking mode
+     * @return invalid socket if no connection is pending or accepting failed, errno tells which (EAGAIN, EMFILE, ...)
+     */
+    TCPSocket accept(bool nonBlocking = false);
     bool send(const std::string& data);
     std::string recv(int size = 1024);
 
+    /*
+     * Writes as many bytes as the socket accepts with a single call
+     * @return number of written bytes, -1 on failure (errno is set, EAGAIN for a full non-blocking socket)
+     */
+    ssize_t sendSome(const char* data, size_t size);
+
+    /*
+     * Writes the given buffers in order with a single call (gather write)
+     * @return number of written bytes, -1 on failure (errno is set, EAGAIN for a full non-blocking socket)
+     */
+    ssize_t sendv(const iovec* iov, size_t iovCount);
+
+    /*
+     * Writes bytes of a file to the socket without copying them to user space (sendfile)
+     * @param offset - file offset to start at, advanced by the number of written bytes
+     * @return number of written bytes, -1 on failure (errno is set, EAGAIN for a full non-blocking socket)
+     */
+    ssize_t sendFile(int fileFd, off_t& offset, size_t count);
+
+    /*
+     * Receives up to size bytes directly into the given buffer
+     * @return number of received bytes, 0 if the peer closed the connection, -1 on failure (errno is set, EAGAIN for an empty non-blocking socket)
+     */
+    ssize_t recvSome(char* buffer, size_t size);
+
+    /*
+     * Receives up to size bytes without blocking, even if the socket itself is in blocking mode
+     * @param data - set to the received bytes, empty if nothing was pending
+     * @param size - maximum number of bytes to receive
+     * @return false if the connection was closed by the peer or failed
+     */
+    bool recvNonBlocking(std::string& data, int size = 1024);
+
+    /*
+     * Switches the socket between blocking and non-blocking mode
+     */
+    bool setNonBlocking(bool nonBlocking);
+
+    /*
+     * Enables SO_REUSEPORT, so several sockets can listen on the same port and the kernel balances connections between them
+     * Must be called before bind
+     */
+    bool setReusePort(bool reusePort);
+
+    /*
+     * Enables SO_REUSEADDR, so the port can be bound again while connections closed by this side are in TIME_WAIT
+     * Must be called before bind
+     */
+    bool setReuseAddress(bool reuseAddress);
+
+    /*
+     * Returns true if the socket holds an open file descriptor
+     */
+    bool isValid() const;
+
     int getSockFd() const;
     const SockAddr& getLocalAddr() const;
     const SockAddr& getRemoteAddr() const;
@@ -62,4 +131,9 @@ class TCPSocket {
     void m_updateDataAvailable();
 
     static TCPSocket stdinSocket();
+
+    /*
+     * Takes ownership of a connected socket that was accepted elsewhere (e.g. by io_uring)
+     */
+    static TCPSocket adopt(int sockFd);
 };
\ No newline at end of file
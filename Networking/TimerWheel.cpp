@@ -0,0 +1,193 @@
+#include "TimerWheel.hpp"
+
+#include <algorithm>
+#include <bit>
+
+TimerWheel::TimerWheel(std::chrono::milliseconds resolution, Clock::time_point now) : m_resolution{std::max<Clock::duration>(resolution, std::chrono::milliseconds(1))},
+                                                                                      m_epoch{now},
+                                                                                      m_tick{0},
+                                                                                      m_freeHead{m_none},
+                                                                                      m_count{0},
+                                                                                      m_occupied{} {
+    m_slots.fill(m_none);
+}
+
+uint64_t TimerWheel::m_tickOf(Clock::time_point time) const {
+    if (time <= m_epoch) {
+        return 0;
+    }
+    return (time - m_epoch) / m_resolution;
+}
+
+void TimerWheel::m_link(uint32_t index, uint16_t slot) {
+    Timer& timer = m_timers[index];
+    timer.slot = slot;
+    timer.prev = m_none;
+    timer.next = m_slots[slot];
+    if (timer.next != m_none) {
+        m_timers[timer.next].prev = index;
+    }
+    m_slots[slot] = index;
+    if (slot < m_overflowSlot) {
+        m_occupied[slot / m_slotsPerLevel] |= uint64_t{1} << (slot % m_slotsPerLevel);
+    }
+}
+
+void TimerWheel::m_unlink(uint32_t index) {
+    Timer& timer = m_timers[index];
+    if (timer.prev != m_none) {
+        m_timers[timer.prev].next = timer.next;
+    } else {
+        m_slots[timer.slot] = timer.next;
+    }
+    if (timer.next != m_none) {
+        m_timers[timer.next].prev = timer.prev;
+    }
+    if (m_slots[timer.slot] == m_none && timer.slot < m_overflowSlot) {
+        m_occupied[timer.slot / m_slotsPerLevel] &= ~(uint64_t{1} << (timer.slot % m_slotsPerLevel));
+    }
+    timer.slot = m_noSlot;
+}
+
+void TimerWheel::m_place(uint32_t index) {
+    uint64_t expiry = m_timers[index].expiry;
+    for (unsigned level = 0; level < m_levels; level++) {
+        // The lowest level whose slots still share everything above them with the current tick
+        unsigned shift = m_levelBits * (level + 1);
+        if ((expiry >> shift) == (m_tick >> shift)) {
+            uint64_t slotIdx = (expiry >> (m_levelBits * level)) & (m_slotsPerLevel - 1);
+            m_link(index, static_cast<uint16_t>(level * m_slotsPerLevel + slotIdx));
+            return;
+        }
+    }
+    m_link(index, m_overflowSlot);
+}
+
+void TimerWheel::m_cascade(uint16_t slot) {
+    uint32_t index = m_slots[slot];
+    m_slots[slot] = m_none;
+    if (slot < m_overflowSlot) {
+        m_occupied[slot / m_slotsPerLevel] &= ~(uint64_t{1} << (slot % m_slotsPerLevel));
+    }
+    while (index != m_none) {
+        uint32_t next = m_timers[index].next;
+        m_place(index);
+        index = next;
+    }
+}
+
+uint64_t TimerWheel::m_nextTick() const {
+    for (unsigned level = 0; level < m_levels; level++) {
+        unsigned shift = m_levelBits * level;
+        uint64_t slotIdx = (m_tick >> shift) & (m_slotsPerLevel - 1);
+        // Slots of a level at or before the current one are empty, their timers were moved down already
+        uint64_t ahead = slotIdx + 1 == m_slotsPerLevel ? 0 : m_occupied[level] & (~uint64_t{0} << (slotIdx + 1));
+        if (ahead != 0) {
+            uint64_t blockStart = (m_tick >> (shift + m_levelBits)) << (shift + m_levelBits);
+            return blockStart + (static_cast<uint64_t>(std::countr_zero(ahead)) << shift);
+        }
+    }
+    if (m_slots[m_overflowSlot] != m_none) {
+        unsigned shift = m_levelBits * m_levels;
+        return ((m_tick >> shift) + 1) << shift;
+    }
+    return m_tick;
+}
+
+bool TimerWheel::m_advance(uint64_t target) {
+    if (m_tick >= target) {
+        return false;
+    }
+    uint64_t next = m_nextTick();
+    if (next == m_tick || next > target) {
+        // Nothing happens in between
+        m_tick = target;
+        return false;
+    }
+    m_tick = next;
+
+    // Higher levels first, so their timers reach the lower levels before those are moved down in turn
+    if ((m_tick & ((uint64_t{1} << (m_levelBits * m_levels)) - 1)) == 0) {
+        m_cascade(m_overflowSlot);
+    }
+    for (unsigned level = m_levels - 1; level > 0; level--) {
+        unsigned shift = m_levelBits * level;
+        if ((m_tick & ((uint64_t{1} << shift) - 1)) == 0) {
+            m_cascade(static_cast<uint16_t>(level * m_slotsPerLevel + ((m_tick >> shift) & (m_slotsPerLevel - 1))));
+        }
+    }
+
+    uint16_t slot = static_cast<uint16_t>(m_tick & (m_slotsPerLevel - 1));
+    while (m_slots[slot] != m_none) {
+        uint32_t index = m_slots[slot];
+        m_unlink(index);
+        m_link(index, m_expiringSlot);
+    }
+    return m_tick < target;
+}
+
+void TimerWheel::m_release(uint32_t index) {
+    m_unlink(index);
+    Timer& timer = m_timers[index];
+    timer.generation++;
+    timer.next = m_freeHead;
+    m_freeHead = index;
+    m_count--;
+}
+
+uint64_t TimerWheel::m_popExpiring() {
+    uint32_t index = m_slots[m_expiringSlot];
+    m_release(index);
+    return m_timers[index].payload;
+}
+
+TimerHandle TimerWheel::schedule(Clock::time_point deadline, uint64_t payload) {
+    uint64_t expiry = 0;
+    if (deadline > m_epoch) {
+        expiry = (deadline - m_epoch + m_resolution - Clock::duration(1)) / m_resolution;
+    }
+
+    uint32_t index;
+    if (m_freeHead != m_none) {
+        index = m_freeHead;
+        m_freeHead = m_timers[index].next;
+    } else {
+        index = static_cast<uint32_t>(m_timers.size());
+        m_timers.push_back(Timer{0, 0, m_none, m_none, 0, m_noSlot});
+    }
+    Timer& timer = m_timers[index];
+    // The current tick was processed already
+    timer.expiry = std::max(expiry, m_tick + 1);
+    timer.payload = payload;
+    m_place(index);
+    m_count++;
+    return TimerHandle{index, timer.generation};
+}
+
+bool TimerWheel::cancel(TimerHandle handle) {
+    if (handle.index >= m_timers.size()) {
+        return false;
+    }
+    Timer& timer = m_timers[handle.index];
+    if (timer.generation != handle.generation || timer.slot == m_noSlot) {
+        return false;
+    }
+    m_release(handle.index);
+    return true;
+}
+
+size_t TimerWheel::size() const {
+    return m_count;
+}
+
+int TimerWheel::getTimeoutMs(Clock::time_point now) const {
+    if (m_count == 0) {
+        return -1;
+    }
+    uint64_t next = m_nextTick();
+    if (next == m_tick) {
+        return 0;
+    }
+    auto remaining = std::chrono::ceil<std::chrono::milliseconds>(m_epoch + next * m_resolution - now);
+    return static_cast<int>(std::clamp<int64_t>(remaining.count(), 0, std::numeric_limits<int>::max()));
+}
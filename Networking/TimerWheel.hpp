@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/*
+ * Reference to a timer of a TimerWheel, a default constructed handle refers to no timer
+ * The generation changes whenever the timer fires or is cancelled, so a handle never refers to a later timer.
+ */
+struct TimerHandle {
+    static constexpr uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+
+    uint32_t index = NO_INDEX;
+    uint32_t generation = 0;
+
+    bool operator==(const TimerHandle& other) const = default;
+};
+
+/*
+ * Hierarchical timing wheel of one event loop thread (not thread-safe)
+ * Time is divided into ticks of a fixed resolution. A timer is linked into one of 64 slots of the level whose range
+ * covers its deadline, so scheduling and cancelling are O(1). Whenever the lower level wraps around, the timers of the
+ * next slot of the level above are moved down, every timer is moved at most once per level. Occupancy bitmaps let
+ * expire skip the empty ticks, so an idle wheel costs nothing and 100k timers are never scanned as a whole.
+ * Timers fire at the first tick at or after their deadline, i.e. up to one resolution late but never early.
+ */
+class TimerWheel {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+   private:
+    struct Timer {
+        uint64_t expiry;
+        uint64_t payload;
+        uint32_t prev;
+        uint32_t next;
+        uint32_t generation;
+        // Slot the timer is linked into, m_noSlot while it is free
+        uint16_t slot;
+    };
+
+    static constexpr unsigned m_levelBits = 6;
+    static constexpr unsigned m_slotsPerLevel = 1 << m_levelBits;
+    static constexpr unsigned m_levels = 4;
+    // Timers beyond the range of the top level wait in an extra slot, which is sorted again whenever the top level wraps around
+    static constexpr uint16_t m_overflowSlot = m_levels * m_slotsPerLevel;
+    // Fired timers are moved here first, so callbacks may cancel any timer, including the ones about to fire
+    static constexpr uint16_t m_expiringSlot = m_overflowSlot + 1;
+    static constexpr uint16_t m_noSlot = std::numeric_limits<uint16_t>::max();
+    static constexpr uint32_t m_none = std::numeric_limits<uint32_t>::max();
+
+    Clock::duration m_resolution;
+    Clock::time_point m_epoch;
+    // Last tick that was processed
+    uint64_t m_tick;
+
+    std::vector<Timer> m_timers;
+    uint32_t m_freeHead;
+    size_t m_count;
+
+    std::array<uint32_t, m_expiringSlot + 1> m_slots;
+    std::array<uint64_t, m_levels> m_occupied;
+
+    uint64_t m_tickOf(Clock::time_point time) const;
+    void m_link(uint32_t index, uint16_t slot);
+    void m_unlink(uint32_t index);
+
+    /*
+     * Links a timer into the slot covering its expiry relative to the current tick
+     */
+    void m_place(uint32_t index);
+
+    /*
+     * Moves the timers of a slot down to the slots matching the current tick
+     */
+    void m_cascade(uint16_t slot);
+
+    /*
+     * First tick after the current one at which timers fire or have to be moved down, the current tick if the wheel is empty
+     */
+    uint64_t m_nextTick() const;
+
+    /*
+     * Advances the current tick by one step towards target and moves the timers that fire at it into the expiring slot
+     * @return false if target was reached
+     */
+    bool m_advance(uint64_t target);
+
+    /*
+     * Unlinks a timer and puts it on the free list
+     */
+    void m_release(uint32_t index);
+
+    /*
+     * Unlinks the first expiring timer and frees it
+     * @return its payload
+     */
+    uint64_t m_popExpiring();
+
+   public:
+    /*
+     * Constructor
+     * @param resolution - duration of a tick
+     * @param now - start of the first tick
+     */
+    TimerWheel(std::chrono::milliseconds resolution, Clock::time_point now = Clock::now());
+
+    /*
+     * Schedules a timer
+     * @param deadline - time at which the timer fires, timers in the past fire at the next tick
+     * @param payload - value passed to the function of expire
+     * @return handle to cancel the timer with
+     */
+    TimerHandle schedule(Clock::time_point deadline, uint64_t payload);
+
+    /*
+     * Cancels a timer, handles of timers that fired or were cancelled already are ignored
+     * @return true if the timer was pending
+     */
+    bool cancel(TimerHandle handle);
+
+    /*
+     * Number of pending timers
+     */
+    size_t size() const;
+
+    /*
+     * Time until expire has to be called next in milliseconds, -1 if no timer is pending
+     */
+    int getTimeoutMs(Clock::time_point now = Clock::now()) const;
+
+    /*
+     * Fires all timers whose deadline passed, by calling function(payload) for each of them
+     * The function may schedule and cancel timers, the ones it schedules fire at the next tick at the earliest.
+     * @return number of fired timers
+     */
+    template <typename Function>
+    size_t expire(Clock::time_point now, Function function) {
+        uint64_t target = m_tickOf(now);
+        size_t fired = 0;
+        bool advancing = true;
+        while (advancing) {
+            advancing = m_advance(target);
+            while (m_slots[m_expiringSlot] != m_none) {
+                function(m_popExpiring());
+                fired++;
+            }
+        }
+        return fired;
+    }
+};
@@ -0,0 +1,167 @@
+#include "PasswordHasher.hpp"
+
+#include <sys/random.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "Sha256.hpp"
+
+namespace {
+
+std::string toHex(std::span<const uint8_t> bytes) {
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(2 * bytes.size());
+    for (uint8_t byte : bytes) {
+        hex += digits[byte >> 4];
+        hex += digits[byte & 0x0f];
+    }
+    return hex;
+}
+
+bool fromHex(std::string_view hex, std::vector<uint8_t>& bytes) {
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        return -1;
+    };
+    bytes.clear();
+    for (size_t charIdx = 0; charIdx < hex.size(); charIdx += 2) {
+        int high = nibble(hex[charIdx]);
+        int low = nibble(hex[charIdx + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        bytes.push_back(static_cast<uint8_t>(high << 4 | low));
+    }
+    return true;
+}
+
+struct ParsedHash {
+    unsigned int iterations;
+    std::vector<uint8_t> salt;
+    std::vector<uint8_t> key;
+};
+
+bool parseHash(std::string_view storedHash, std::string_view scheme, ParsedHash& parsed) {
+    if (!storedHash.starts_with(scheme)) {
+        return false;
+    }
+    storedHash.remove_prefix(scheme.size());
+    size_t iterationsEnd = storedHash.find('$');
+    size_t saltEnd = storedHash.find('$', iterationsEnd + 1);
+    if (iterationsEnd == std::string_view::npos || saltEnd == std::string_view::npos) {
+        return false;
+    }
+    std::string_view iterations = storedHash.substr(0, iterationsEnd);
+    if (iterations.empty() || iterations.size() > 9 || iterations.find_first_not_of("0123456789") != std::string_view::npos) {
+        return false;
+    }
+    parsed.iterations = std::stoul(std::string(iterations));
+    return parsed.iterations > 0 && fromHex(storedHash.substr(iterationsEnd + 1, saltEnd - iterationsEnd - 1), parsed.salt) && fromHex(storedHash.substr(saltEnd + 1), parsed.key) &&
+           !parsed.key.empty() && parsed.key.size() <= Sha256::DIGEST_SIZE;
+}
+
+}  // namespace
+
+PasswordHasher::PasswordHasher(unsigned int iterations) : m_iterations{iterations} {
+    if (m_iterations == 0) {
+        throw std::invalid_argument("PBKDF2 needs at least one iteration");
+    }
+}
+
+std::string PasswordHasher::hash(std::string_view password) const {
+    uint8_t salt[m_saltSize];
+    if (getrandom(salt, sizeof(salt), 0) != static_cast<ssize_t>(sizeof(salt))) {
+        throw std::runtime_error("Failed to generate a salt, errno: " + std::to_string(errno));
+    }
+    uint8_t key[m_keySize];
+    pbkdf2(password, salt, m_iterations, key);
+    return std::string(m_scheme) + std::to_string(m_iterations) + "$" + toHex(salt) + "$" + toHex(key);
+}
+
+bool PasswordHasher::verify(std::string_view password, std::string_view storedHash) const {
+    ParsedHash parsed;
+    if (!parseHash(storedHash, m_scheme, parsed)) {
+        return false;
+    }
+    std::vector<uint8_t> key(parsed.key.size());
+    pbkdf2(password, parsed.salt, parsed.iterations, key);
+
+    uint8_t difference = 0;
+    for (size_t byteIdx = 0; byteIdx < key.size(); byteIdx++) {
+        difference |= key[byteIdx] ^ parsed.key[byteIdx];
+    }
+    return difference == 0;
+}
+
+bool PasswordHasher::needsRehash(std::string_view storedHash) const {
+    ParsedHash parsed;
+    return !parseHash(storedHash, m_scheme, parsed) || parsed.iterations < m_iterations;
+}
+
+unsigned int PasswordHasher::getIterations() const {
+    return m_iterations;
+}
+
+bool PasswordHasher::isHash(std::string_view storedValue) {
+    return storedValue.starts_with(m_scheme);
+}
+
+void PasswordHasher::pbkdf2(std::string_view password, std::span<const uint8_t> salt, unsigned int iterations, std::span<uint8_t> key) {
+    // HMAC key: passwords longer than a block are hashed first, shorter ones zero padded
+    uint8_t hmacKey[Sha256::BLOCK_SIZE] = {};
+    if (password.size() > Sha256::BLOCK_SIZE) {
+        Sha256::Digest digest = Sha256::digest(password);
+        std::memcpy(hmacKey, digest.data(), digest.size());
+    } else {
+        std::memcpy(hmacKey, password.data(), password.size());
+    }
+
+    // The keyed inner and outer states are the same for every iteration, so they are computed once and copied
+    uint8_t pad[Sha256::BLOCK_SIZE];
+    Sha256 inner;
+    Sha256 outer;
+    for (size_t byteIdx = 0; byteIdx < Sha256::BLOCK_SIZE; byteIdx++) {
+        pad[byteIdx] = hmacKey[byteIdx] ^ 0x36;
+    }
+    inner.update(pad, sizeof(pad));
+    for (size_t byteIdx = 0; byteIdx < Sha256::BLOCK_SIZE; byteIdx++) {
+        pad[byteIdx] = hmacKey[byteIdx] ^ 0x5c;
+    }
+    outer.update(pad, sizeof(pad));
+
+    auto hmac = [&inner, &outer](const uint8_t* first, size_t firstSize, const uint8_t* second, size_t secondSize) {
+        Sha256 innerHash = inner;
+        innerHash.update(first, firstSize);
+        if (secondSize > 0) {
+            innerHash.update(second, secondSize);
+        }
+        Sha256::Digest innerDigest = innerHash.finish();
+        Sha256 outerHash = outer;
+        outerHash.update(innerDigest.data(), innerDigest.size());
+        return outerHash.finish();
+    };
+
+    // A single block suffices for keys up to the digest size: U1 = HMAC(P, S || INT(1)), Ui = HMAC(P, Ui-1)
+    const uint8_t blockIndex[4] = {0, 0, 0, 1};
+    Sha256::Digest block = hmac(salt.data(), salt.size(), blockIndex, sizeof(blockIndex));
+    Sha256::Digest result = block;
+    for (unsigned int iterationIdx = 1; iterationIdx < iterations; iterationIdx++) {
+        block = hmac(block.data(), block.size(), nullptr, 0);
+        for (size_t byteIdx = 0; byteIdx < result.size(); byteIdx++) {
+            result[byteIdx] ^= block[byteIdx];
+        }
+    }
+    std::memcpy(key.data(), result.data(), std::min(key.size(), result.size()));
+}
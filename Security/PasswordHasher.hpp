@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+/*
+ * Derives and verifies password hashes with PBKDF2-HMAC-SHA256
+ * Hashes are stored as 'pbkdf2-sha256$<iterations>$<salt>$<key>' with salt and key hex encoded. The iteration count
+ * is part of every hash, so raising it only affects new hashes and existing ones are upgraded on the next login.
+ */
+class PasswordHasher {
+   private:
+    unsigned int m_iterations;
+
+    static constexpr std::string_view m_scheme = "pbkdf2-sha256$";
+    static constexpr size_t m_saltSize = 16;
+    static constexpr size_t m_keySize = 32;
+
+   public:
+    /*
+     * Constructor
+     * @param iterations - PBKDF2 iteration count of new hashes, every iteration costs two SHA-256 compressions
+     */
+    PasswordHasher(unsigned int iterations);
+
+    /*
+     * Hashes a password with a new random salt
+     */
+    std::string hash(std::string_view password) const;
+
+    /*
+     * Checks a password against a stored hash in constant time
+     * @return false if the password does not match or the hash is malformed
+     */
+    bool verify(std::string_view password, std::string_view storedHash) const;
+
+    /*
+     * Returns true if the stored value is no hash of this scheme (a plaintext password of an older version) or uses
+     * fewer iterations than configured
+     */
+    bool needsRehash(std::string_view storedHash) const;
+
+    unsigned int getIterations() const;
+
+    /*
+     * Returns true if the stored value is a hash of this scheme
+     */
+    static bool isHash(std::string_view storedValue);
+
+    /*
+     * PBKDF2-HMAC-SHA256 (RFC 8018) with a key of at most 32 bytes
+     * @param key - receives the derived key
+     */
+    static void pbkdf2(std::string_view password, std::span<const uint8_t> salt, unsigned int iterations, std::span<uint8_t> key);
+};
@@ -0,0 +1,117 @@
+#include "Sha256.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr std::array<uint32_t, 64> roundConstants = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+inline uint32_t rotateRight(uint32_t value, unsigned int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+}  // namespace
+
+Sha256::Sha256() : m_state{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19},
+                   m_block{},
+                   m_blockSize{0},
+                   m_totalBytes{0} {}
+
+void Sha256::m_compress(const uint8_t* block) {
+    uint32_t schedule[64];
+    for (int wordIdx = 0; wordIdx < 16; wordIdx++) {
+        schedule[wordIdx] = (uint32_t(block[4 * wordIdx]) << 24) | (uint32_t(block[4 * wordIdx + 1]) << 16) | (uint32_t(block[4 * wordIdx + 2]) << 8) | uint32_t(block[4 * wordIdx + 3]);
+    }
+    for (int wordIdx = 16; wordIdx < 64; wordIdx++) {
+        uint32_t s0 = rotateRight(schedule[wordIdx - 15], 7) ^ rotateRight(schedule[wordIdx - 15], 18) ^ (schedule[wordIdx - 15] >> 3);
+        uint32_t s1 = rotateRight(schedule[wordIdx - 2], 17) ^ rotateRight(schedule[wordIdx - 2], 19) ^ (schedule[wordIdx - 2] >> 10);
+        schedule[wordIdx] = schedule[wordIdx - 16] + s0 + schedule[wordIdx - 7] + s1;
+    }
+
+    uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+    uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+    for (int roundIdx = 0; roundIdx < 64; roundIdx++) {
+        uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+        uint32_t choice = (e & f) ^ (~e & g);
+        uint32_t temp1 = h + s1 + choice + roundConstants[roundIdx] + schedule[roundIdx];
+        uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t temp2 = s0 + majority;
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+    m_state[0] += a;
+    m_state[1] += b;
+    m_state[2] += c;
+    m_state[3] += d;
+    m_state[4] += e;
+    m_state[5] += f;
+    m_state[6] += g;
+    m_state[7] += h;
+}
+
+void Sha256::update(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    m_totalBytes += size;
+
+    if (m_blockSize > 0) {
+        size_t copied = std::min(size, BLOCK_SIZE - m_blockSize);
+        std::memcpy(m_block.data() + m_blockSize, bytes, copied);
+        m_blockSize += copied;
+        bytes += copied;
+        size -= copied;
+        if (m_blockSize < BLOCK_SIZE) {
+            return;
+        }
+        m_compress(m_block.data());
+        m_blockSize = 0;
+    }
+    // Full blocks are compressed straight from the input
+    while (size >= BLOCK_SIZE) {
+        m_compress(bytes);
+        bytes += BLOCK_SIZE;
+        size -= BLOCK_SIZE;
+    }
+    std::memcpy(m_block.data(), bytes, size);
+    m_blockSize = size;
+}
+
+Sha256::Digest Sha256::finish() {
+    uint64_t totalBits = m_totalBytes * 8;
+    uint8_t padding[BLOCK_SIZE + 8] = {0x80};
+    size_t paddingSize = (m_blockSize < 56 ? 56 : 120) - m_blockSize;
+    for (int byteIdx = 0; byteIdx < 8; byteIdx++) {
+        padding[paddingSize + byteIdx] = static_cast<uint8_t>(totalBits >> (56 - 8 * byteIdx));
+    }
+    update(padding, paddingSize + 8);
+
+    Digest digest;
+    for (int wordIdx = 0; wordIdx < 8; wordIdx++) {
+        digest[4 * wordIdx] = static_cast<uint8_t>(m_state[wordIdx] >> 24);
+        digest[4 * wordIdx + 1] = static_cast<uint8_t>(m_state[wordIdx] >> 16);
+        digest[4 * wordIdx + 2] = static_cast<uint8_t>(m_state[wordIdx] >> 8);
+        digest[4 * wordIdx + 3] = static_cast<uint8_t>(m_state[wordIdx]);
+    }
+    return digest;
+}
+
+Sha256::Digest Sha256::digest(std::string_view data) {
+    Sha256 sha;
+    sha.update(data.data(), data.size());
+    return sha.finish();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/*
+ * SHA-256 (FIPS 180-4), bundled so password hashing needs no crypto library
+ * The state can be copied, which lets HMAC precompute the keyed inner and outer states once per password.
+ */
+class Sha256 {
+   public:
+    static constexpr size_t DIGEST_SIZE = 32;
+    static constexpr size_t BLOCK_SIZE = 64;
+
+    using Digest = std::array<uint8_t, DIGEST_SIZE>;
+
+   private:
+    std::array<uint32_t, 8> m_state;
+    std::array<uint8_t, BLOCK_SIZE> m_block;
+    size_t m_blockSize;
+    uint64_t m_totalBytes;
+
+    /*
+     * Compresses one 64 byte block into the state
+     */
+    void m_compress(const uint8_t* block);
+
+   public:
+    Sha256();
+
+    /*
+     * Appends data to the hashed message
+     */
+    void update(const void* data, size_t size);
+
+    /*
+     * Pads the message and returns its digest, the object must not be updated afterwards
+     */
+    Digest finish();
+
+    /*
+     * Digest of a complete message
+     */
+    static Digest digest(std::string_view data);
+};
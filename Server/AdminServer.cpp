@@ -0,0 +1,101 @@
+#include "AdminServer.hpp"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+
+#include "../Logging/Logger.hpp"
+
+AdminServer::AdminServer(uint16_t port, Metrics& metrics) : m_metrics{metrics},
+                                                            m_listeningSocket(TCPSocketType::TCP),
+                                                            m_stopFd{eventfd(0, EFD_CLOEXEC)} {
+    if (m_stopFd == -1) {
+        throw std::runtime_error("Failed to create eventfd, errno: " + std::to_string(errno));
+    }
+    // Every response is closed by the server, so a restart would otherwise find the port blocked by TIME_WAIT
+    m_listeningSocket.setReuseAddress(true);
+    // A client that resets before it is accepted must not leave the thread blocked in accept
+    if (!m_listeningSocket.bind(port, true) || !m_listeningSocket.listen(16) || !m_listeningSocket.setNonBlocking(true)) {
+        int error = errno;
+        close(m_stopFd);
+        throw std::runtime_error("Failed to listen on admin port " + std::to_string(port) + ", errno: " + std::to_string(error));
+    }
+    m_thread = std::thread(&AdminServer::m_run, this);
+    Logger::info("Serving metrics on http://127.0.0.1:", port, "/metrics");
+}
+
+AdminServer::~AdminServer() {
+    stop();
+    close(m_stopFd);
+}
+
+void AdminServer::stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = ::write(m_stopFd, &one, sizeof(one));
+    m_thread.join();
+}
+
+void AdminServer::m_run() {
+    pollfd fds[] = {{m_listeningSocket.getSockFd(), POLLIN, 0}, {m_stopFd, POLLIN, 0}};
+    while (true) {
+        if (poll(fds, 2, -1) == -1) {
+            // revents still hold the results of the previous call
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        if (fds[1].revents != 0) {
+            return;
+        }
+        if (fds[0].revents != 0) {
+            TCPSocket client = m_listeningSocket.accept();
+            if (client.isValid()) {
+                m_handle(client);
+            }
+        }
+    }
+}
+
+void AdminServer::m_handle(TCPSocket& client) {
+    // A client that stalls must not block the next scrape for long
+    timeval timeout{1, 0};
+    setsockopt(client.getSockFd(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client.getSockFd(), SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        ssize_t received = client.recvSome(buffer, sizeof(buffer));
+        if (received <= 0) {
+            return;
+        }
+        request.append(buffer, received);
+    }
+
+    // 'GET <path> HTTP/1.1'
+    std::string path = request.substr(0, request.find("\r\n"));
+    bool found = path.rfind("GET /metrics ", 0) == 0 || path.rfind("GET / ", 0) == 0;
+    std::string body = found ? m_metrics.formatPrometheus() : "Not found, the metrics are served at /metrics\n";
+    std::string response = std::string(found ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n") +
+                           "Content-Type: text/plain; version=0.0.4\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: close\r\n\r\n" + body;
+
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t written = client.sendSome(response.data() + sent, response.size() - sent);
+        if (written <= 0) {
+            return;
+        }
+        sent += written;
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <thread>
+
+#include "../Networking/TCPSocket.hpp"
+#include "Metrics.hpp"
+
+/*
+ * Serves the metrics in Prometheus text format over HTTP on a port of the loopback interface
+ * Requests are answered one at a time on a thread of their own, so a scrape never delays the reactors.
+ */
+class AdminServer {
+   private:
+    Metrics& m_metrics;
+    TCPSocket m_listeningSocket;
+    // Written to wake the thread up when stopping
+    int m_stopFd;
+    std::thread m_thread;
+
+    void m_run();
+    void m_handle(TCPSocket& client);
+
+   public:
+    /*
+     * Constructor, starts listening and the serving thread
+     * Throws a runtime_error if the port can not be bound.
+     */
+    AdminServer(uint16_t port, Metrics& metrics);
+    AdminServer(const AdminServer& other) = delete;
+    ~AdminServer();
+
+    AdminServer& operator=(const AdminServer& other) = delete;
+
+    /*
+     * Stops the serving thread
+     */
+    void stop();
+};
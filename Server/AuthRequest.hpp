@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "../Database/UserData.hpp"
+#include "../Networking/Mailbox.hpp"
+#include "ConnectionHandle.hpp"
+
+struct AuthResult;
+
+/*
+ * Login or registration handed from a reactor thread to the AuthService
+ */
+struct AuthRequest {
+    enum class Type {
+        REGISTER,
+        LOGIN
+    };
+
+    Type type = Type::LOGIN;
+    std::string name;
+    std::string password;
+
+    // Requesting connection within the slab of its reactor thread
+    ConnectionHandle connection;
+
+    // IP address of the client, used to limit the requests of a single address
+    std::string remoteAddress;
+
+    // Inbox of the requesting reactor thread, receives the AuthResult
+    Mailbox<AuthResult>* completions = nullptr;
+};
+
+/*
+ * Outcome of an AuthRequest, posted back to the requesting reactor thread
+ */
+struct AuthResult {
+    enum class Status {
+        REGISTERED,
+        LOGGED_IN,
+        NAME_TAKEN,
+        INVALID_CREDENTIALS,
+        FAILED
+    };
+
+    Status status = Status::FAILED;
+    ConnectionHandle connection;
+
+    // Data of the logged in user, UserData::empty() for all other results
+    UserData userData = UserData::empty();
+};
@@ -0,0 +1,152 @@
+#include "AuthService.hpp"
+
+#include "../Logging/Logger.hpp"
+
+namespace {
+
+/*
+ * Runs a database call and records its latency
+ */
+template <typename Call>
+auto timed(Call call) {
+    ScopedLatency latency(Histogram::DATABASE_CALL_NS);
+    return call();
+}
+
+}  // namespace
+
+AuthService::AuthService(const std::string& databasePath, const AuthOptions& options, Metrics* metrics) : m_databasePath{databasePath},
+                                                                                                           m_options{options},
+                                                                                                           m_hasher{options.kdfIterations},
+                                                                                                           m_metrics{metrics},
+                                                                                                           m_dummyHash{m_hasher.hash("")},
+                                                                                                           m_userCache{options.userCacheSize > 0 ? std::make_unique<UserCache>(options.userCacheSize) : nullptr},
+                                                                                                           m_stopping{false},
+                                                                                                           m_nextClientId{0} {
+    {
+        UserDatabase userDatabase{m_databasePath, m_userCache.get()};
+        m_nextClientId = userDatabase.findMaxId() + 1;
+        if (m_userCache) {
+            size_t loaded = userDatabase.warmCache();
+            Logger::info("Loaded ", loaded, " user(s) into the cache", m_userCache->isComplete() ? "" : ", further users are loaded on demand");
+        }
+    }
+
+    for (unsigned int workerIdx = 0; workerIdx < m_options.workers; workerIdx++) {
+        m_workers.emplace_back([this]() { m_work(); });
+    }
+}
+
+AuthService::~AuthService() {
+    stop();
+}
+
+AuthService::Admission AuthService::submit(AuthRequest request) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_requests.size() >= m_options.queueSize) {
+            return Admission::QUEUE_FULL;
+        }
+        unsigned int& inFlight = m_requestsInFlight[request.remoteAddress];
+        if (inFlight >= m_options.requestsPerAddress) {
+            return Admission::ADDRESS_LIMIT;
+        }
+        inFlight++;
+        m_requests.push_back(std::move(request));
+    }
+    m_condition.notify_one();
+    return Admission::ACCEPTED;
+}
+
+void AuthService::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_requests.clear();
+    }
+    m_condition.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+void AuthService::m_work() {
+    Logger::setThreadName("auth");
+    if (m_metrics) {
+        m_metrics->registerThread();
+    }
+    UserDatabase userDatabase{m_databasePath, m_userCache.get()};
+
+    while (true) {
+        AuthRequest request;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || !m_requests.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            request = std::move(m_requests.front());
+            m_requests.pop_front();
+        }
+
+        AuthResult result = request.type == AuthRequest::Type::REGISTER ? m_register(userDatabase, request) : m_login(userDatabase, request);
+        result.connection = request.connection;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_requestsInFlight.find(request.remoteAddress);
+            if (--it->second == 0) {
+                m_requestsInFlight.erase(it);
+            }
+        }
+        request.completions->post(std::move(result));
+    }
+}
+
+AuthResult AuthService::m_register(UserDatabase& userDatabase, const AuthRequest& request) {
+    AuthResult result;
+    if (timed([&]() { return userDatabase.findByName(request.name); }).getName() == request.name) {
+        result.status = AuthResult::Status::NAME_TAKEN;
+        return result;
+    }
+    // Another worker may have registered the same name since the lookup, the UNIQUE constraint rejects the insert then
+    UserData userData(m_nextClientId++, request.name, m_hasher.hash(request.password));
+    if (!timed([&]() { return userDatabase.insert(userData); })) {
+        result.status = timed([&]() { return userDatabase.findByName(request.name); }).getName() == request.name ? AuthResult::Status::NAME_TAKEN : AuthResult::Status::FAILED;
+        return result;
+    }
+    result.status = AuthResult::Status::REGISTERED;
+    return result;
+}
+
+AuthResult AuthService::m_login(UserDatabase& userDatabase, const AuthRequest& request) {
+    AuthResult result;
+    result.status = AuthResult::Status::INVALID_CREDENTIALS;
+
+    UserData userData = timed([&]() { return userDatabase.findByName(request.name); });
+    if (userData == UserData::empty()) {
+        m_hasher.verify(request.password, m_dummyHash);
+        return result;
+    }
+
+    // Older versions stored the plain password, accounts registered before lines were framed even including the line break
+    const std::string& stored = userData.getPassword();
+    bool valid = PasswordHasher::isHash(stored) ? m_hasher.verify(request.password, stored) : stored == request.password || stored == request.password + "\n";
+    if (!valid) {
+        return result;
+    }
+
+    // Plain passwords and hashes with fewer iterations than configured are replaced as soon as the password is known
+    if (m_hasher.needsRehash(stored)) {
+        userData.setPassword(m_hasher.hash(request.password));
+        if (timed([&]() { return userDatabase.update(userData); })) {
+            Logger::info("Upgraded the password hash of ", userData.getName());
+        }
+    }
+
+    result.status = AuthResult::Status::LOGGED_IN;
+    result.userData = userData;
+    return result;
+}
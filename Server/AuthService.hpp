@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../Database/UserDatabase.hpp"
+#include "../Security/PasswordHasher.hpp"
+#include "AuthRequest.hpp"
+#include "Metrics.hpp"
+
+struct AuthOptions {
+    // Worker threads, each one owns a database connection and derives password hashes
+    unsigned int workers = 2;
+
+    // Requests waiting for a worker, further requests are rejected until the queue shrinks
+    size_t queueSize = 256;
+
+    // Requests of a single client address that may be queued or handled at the same time
+    unsigned int requestsPerAddress = 4;
+
+    // PBKDF2 iteration count of new password hashes
+    unsigned int kdfIterations = 100000;
+
+    // Users kept in memory by the UserCache, 0 disables the cache
+    size_t userCacheSize = 100000;
+};
+
+/*
+ * Worker pool running the database work and password hashing of logins and registrations
+ * SQLite reads, commits and the key derivation block for a long time, so the reactor threads only validate a request,
+ * submit it and continue serving their clients. The pool has a fixed size and a bounded queue, and every client
+ * address may only occupy a few of its slots, so a login flood is rejected instead of delaying everyone else.
+ * Results are posted to the inbox of the requesting reactor thread.
+ */
+class AuthService {
+   public:
+    enum class Admission {
+        ACCEPTED,
+        // The queue is full
+        QUEUE_FULL,
+        // The client address has too many requests in flight
+        ADDRESS_LIMIT
+    };
+
+   private:
+    std::string m_databasePath;
+    AuthOptions m_options;
+    PasswordHasher m_hasher;
+
+    // Receives the latency of the database calls of the workers, optional
+    Metrics* m_metrics;
+
+    // Verified for unknown names, so a failed login takes as long whether the name exists or not
+    std::string m_dummyHash;
+
+    // Shared by the database connections of all workers, so lookups of known users and names skip SQLite
+    std::unique_ptr<UserCache> m_userCache;
+
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<AuthRequest> m_requests;
+    std::unordered_map<std::string, unsigned int> m_requestsInFlight;
+    bool m_stopping;
+
+    std::atomic<unsigned int> m_nextClientId;
+
+    /*
+     * Main loop of a worker thread, handles requests until the service is stopped
+     */
+    void m_work();
+
+    AuthResult m_register(UserDatabase& userDatabase, const AuthRequest& request);
+    AuthResult m_login(UserDatabase& userDatabase, const AuthRequest& request);
+
+   public:
+    /*
+     * Constructor, starts the workers
+     * @param databasePath - database file, opened once per worker
+     * @param options - size of the pool and its queue, admission limit and hashing cost
+     * @param metrics - metrics the workers record into, optional
+     */
+    AuthService(const std::string& databasePath, const AuthOptions& options, Metrics* metrics = nullptr);
+    AuthService(const AuthService& other) = delete;
+    ~AuthService();
+
+    AuthService& operator=(const AuthService& other) = delete;
+
+    /*
+     * Queues a request unless the queue or the request's client address is at its limit, safe to call from any thread
+     */
+    Admission submit(AuthRequest request);
+
+    /*
+     * Stops the workers and waits for them, requests that are still queued are discarded
+     */
+    void stop();
+};
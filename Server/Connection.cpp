@@ -1,12 +1,85 @@
 #include "Connection.hpp"
 
-Connection::Connection(TCPSocket&& socket, UserData clientData) : m_socket(std::move(socket)), m_clientData(clientData) {}
+#include <sys/uio.h>
 
-Connection::Connection(Connection&& other) : m_socket(std::move(other.m_socket)), m_clientData(other.m_clientData) {}
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "Metrics.hpp"
+
+Connection::Connection(TCPSocket&& socket, UserData clientData, BufferPool& receivePool, OutboundLimits outboundLimits, size_t maxLineLength) : m_socket(std::move(socket)),
+                                                                                                                                               m_clientData(clientData),
+                                                                                                                                               m_lineFramer(receivePool, maxLineLength),
+                                                                                                                                               m_outboundLimits(outboundLimits),
+                                                                                                                                               m_paused{false},
+                                                                                                                                               m_closing{false},
+                                                                                                                                               m_droppedMessages{0},
+                                                                                                                                               m_authPending{false},
+                                                                                                                                               m_flushScheduled{false},
+                                                                                                                                               m_completionInput{false},
+                                                                                                                                               m_receivedOffset{0},
+                                                                                                                                               m_inputClosed{false},
+                                                                                                                                               m_receivePaused{false},
+                                                                                                                                               m_writeWatched{false},
+                                                                                                                                               m_lastInput{std::chrono::steady_clock::now()},
+                                                                                                                                               m_lastActivity{m_lastInput},
+                                                                                                                                               m_binary{false},
+                                                                                                                                               m_protocolChosen{false},
+                                                                                                                                               m_compressionThreshold{0} {}
+
+Connection::Connection(Connection&& other) : m_socket(std::move(other.m_socket)),
+                                             m_clientData(other.m_clientData),
+                                             m_senderPrefix(std::move(other.m_senderPrefix)),
+                                             m_lineFramer(std::move(other.m_lineFramer)),
+                                             m_outboundQueue(std::move(other.m_outboundQueue)),
+                                             m_outboundLimits(other.m_outboundLimits),
+                                             m_paused{other.m_paused},
+                                             m_closing{other.m_closing},
+                                             m_droppedMessages{other.m_droppedMessages},
+                                             m_authPending{other.m_authPending},
+                                             m_flushScheduled{other.m_flushScheduled},
+                                             m_sessionToken(std::move(other.m_sessionToken)),
+                                             m_completionInput{other.m_completionInput},
+                                             m_received(std::move(other.m_received)),
+                                             m_receivedOffset{other.m_receivedOffset},
+                                             m_inputClosed{other.m_inputClosed},
+                                             m_receivePaused{other.m_receivePaused},
+                                             m_writeWatched{other.m_writeWatched},
+                                             m_timer{other.m_timer},
+                                             m_lastInput{other.m_lastInput},
+                                             m_lastActivity{other.m_lastActivity},
+                                             m_pingSent{other.m_pingSent},
+                                             m_binary{other.m_binary},
+                                             m_protocolChosen{other.m_protocolChosen},
+                                             m_compressionThreshold{other.m_compressionThreshold} {}
 
 Connection& Connection::operator=(Connection&& other) {
     m_socket = std::move(other.m_socket);
     m_clientData = other.m_clientData;
+    m_senderPrefix = std::move(other.m_senderPrefix);
+    m_lineFramer = std::move(other.m_lineFramer);
+    m_outboundQueue = std::move(other.m_outboundQueue);
+    m_outboundLimits = other.m_outboundLimits;
+    m_paused = other.m_paused;
+    m_closing = other.m_closing;
+    m_droppedMessages = other.m_droppedMessages;
+    m_authPending = other.m_authPending;
+    m_flushScheduled = other.m_flushScheduled;
+    m_sessionToken = std::move(other.m_sessionToken);
+    m_completionInput = other.m_completionInput;
+    m_received = std::move(other.m_received);
+    m_receivedOffset = other.m_receivedOffset;
+    m_inputClosed = other.m_inputClosed;
+    m_receivePaused = other.m_receivePaused;
+    m_writeWatched = other.m_writeWatched;
+    m_timer = other.m_timer;
+    m_lastInput = other.m_lastInput;
+    m_lastActivity = other.m_lastActivity;
+    m_pingSent = other.m_pingSent;
+    m_binary = other.m_binary;
+    m_protocolChosen = other.m_protocolChosen;
+    m_compressionThreshold = other.m_compressionThreshold;
     return *this;
 }
 
@@ -24,20 +97,457 @@ UserData& Connection::getClientData() {
 
 void Connection::setClientData(const UserData& clientData) {
     m_clientData = clientData;
+    m_senderPrefix = MessageBuffer::create({clientData.getName(), ": "});
+}
+
+const MessageRef& Connection::getSenderPrefix() const {
+    return m_senderPrefix;
 }
 
 std::string Connection::getRemoteAddr() const {
     return m_socket.getRemoteAddr();
 }
 
-bool Connection::send(const std::string& data) {
-    return m_socket.send(data);
+bool Connection::send(std::string_view data) {
+    if (m_binary) {
+        if (!data.empty() && data.back() == '\n') {
+            data.remove_suffix(1);
+        }
+        return m_sendFrame(FrameType::REPLY, 0, data);
+    }
+    return sendRaw(data);
+}
+
+bool Connection::sendNotice(std::string_view text, TextColor color) {
+    if (m_binary) {
+        return m_sendFrame(FrameType::NOTICE, static_cast<uint8_t>(color), text);
+    }
+    return sendRaw(decorateText(text, color));
+}
+
+bool Connection::sendPing() {
+    if (m_binary) {
+        return m_sendFrame(FrameType::PING, 0, {});
+    }
+    return sendRaw("/ping\n");
+}
+
+bool Connection::m_sendFrame(FrameType type, uint8_t flags, std::string_view text) {
+    FrameHeader header;
+    header.type = type;
+    header.flags = flags;
+    std::string frame;
+    frame.reserve(FrameHeader::SIZE + text.size());
+    appendFrame(frame, header, {}, {}, text);
+    return sendFrames(frame);
+}
+
+bool Connection::sendFrames(std::string_view frames) {
+    if (m_compressionThreshold > 0 && frames.size() >= m_compressionThreshold) {
+        std::string compressed;
+        if (appendCompressedFrame(compressed, frames)) {
+            Metrics::count(Counter::COMPRESSION_SAVED_BYTES, frames.size() - compressed.size());
+            return sendRaw(compressed);
+        }
+    }
+    return sendRaw(frames);
+}
+
+bool Connection::sendRaw(std::string_view data) {
+    if (m_closing) {
+        return false;
+    }
+    if (m_paused) {
+        m_drop(1);
+        return true;
+    }
+
+    // The caller's bytes are borrowed for the direct write and only copied into a buffer if something has to be queued
+    MessageRef borrowed = MessageRef::fromStatic(data);
+    ssize_t written = 0;
+    if (m_outboundQueue.empty()) {
+        written = m_writeDirect(std::span<const MessageRef>(&borrowed, 1));
+        if (written == -1) {
+            return false;
+        }
+        if (static_cast<size_t>(written) == data.size()) {
+            return true;
+        }
+    }
+
+    MessageRef owned = MessageBuffer::create({data.substr(written)});
+    m_enqueue(std::span<const MessageRef>(&owned, 1), 0);
+    return !m_closing;
+}
+
+bool Connection::send(std::span<const MessageRef> segments) {
+    if (m_closing) {
+        return false;
+    }
+    if (m_paused) {
+        m_drop(1);
+        return true;
+    }
+
+    ssize_t written = 0;
+    if (m_outboundQueue.empty()) {
+        written = m_writeDirect(segments);
+        if (written == -1) {
+            return false;
+        }
+    }
+    m_enqueue(segments, written);
+    return !m_closing;
+}
+
+bool Connection::post(std::span<const MessageRef> segments) {
+    if (m_closing) {
+        return false;
+    }
+    if (m_paused) {
+        m_drop(1);
+        return true;
+    }
+    m_enqueue(segments, 0);
+    return !m_closing;
+}
+
+bool Connection::sendFile(int fileFd, off_t offset, std::string_view mapped) {
+    if (m_closing) {
+        return false;
+    }
+    if (m_paused) {
+        m_drop(1);
+        return true;
+    }
+
+    size_t written = 0;
+    while (m_outboundQueue.empty() && written < mapped.size()) {
+        ssize_t result = m_socket.sendFile(fileFd, offset, mapped.size() - written);
+        if (result == -1 && errno == EINTR) {
+            continue;
+        }
+        if (result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (result <= 0) {
+            m_closing = true;
+            return false;
+        }
+        written += result;
+        Metrics::count(Counter::BYTES_SENT, result);
+    }
+    if (written == mapped.size()) {
+        return true;
+    }
+
+    MessageRef owned = MessageBuffer::create({mapped.substr(written)});
+    m_enqueue(std::span<const MessageRef>(&owned, 1), 0);
+    return !m_closing;
+}
+
+ssize_t Connection::m_writeDirect(std::span<const MessageRef> segments) {
+    constexpr size_t maxSegments = 8;
+    iovec iov[maxSegments];
+    size_t iovCount = 0;
+    for (; iovCount < segments.size() && iovCount < maxSegments; iovCount++) {
+        iov[iovCount].iov_base = const_cast<char*>(segments[iovCount].data());
+        iov[iovCount].iov_len = segments[iovCount].size();
+    }
+
+    ssize_t written = m_socket.sendv(iov, iovCount);
+    if (written == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+        m_closing = true;
+        return written;
+    }
+    Metrics::count(Counter::BYTES_SENT, written);
+    return written;
+}
+
+void Connection::m_drop(size_t messages) {
+    m_droppedMessages += messages;
+    Metrics::count(Counter::MESSAGES_DROPPED, messages);
+}
+
+void Connection::m_enqueue(std::span<const MessageRef> segments, size_t written) {
+    // Skip the segments that were written completely
+    size_t firstSegment = 0;
+    while (firstSegment < segments.size() && written >= segments[firstSegment].size()) {
+        written -= segments[firstSegment].size();
+        firstSegment++;
+    }
+    if (firstSegment == segments.size()) {
+        return;
+    }
+    m_outboundQueue.push(segments.subspan(firstSegment), written);
+
+    if (m_outboundQueue.getBytes() <= m_outboundLimits.highWatermark) {
+        return;
+    }
+    switch (m_outboundLimits.policy) {
+        case SlowConsumerPolicy::DROP_OLDEST:
+            m_drop(m_outboundQueue.dropOldest(m_outboundLimits.lowWatermark));
+            break;
+        case SlowConsumerPolicy::DISCONNECT:
+            m_closing = true;
+            break;
+        case SlowConsumerPolicy::PAUSE:
+            m_paused = true;
+            break;
+    }
+}
+
+bool Connection::flush() {
+    if (m_closing) {
+        return false;
+    }
+    size_t queuedBytes = m_outboundQueue.getBytes();
+    if (!m_outboundQueue.flush(m_socket)) {
+        m_closing = true;
+        return false;
+    }
+    Metrics::count(Counter::BYTES_SENT, queuedBytes - m_outboundQueue.getBytes());
+    if (m_paused && m_outboundQueue.getBytes() <= m_outboundLimits.lowWatermark) {
+        m_paused = false;
+    }
+    return true;
+}
+
+bool Connection::isPaused() const {
+    return m_paused;
+}
+
+bool Connection::isClosing() const {
+    return m_closing;
+}
+
+size_t Connection::getDroppedMessages() const {
+    return m_droppedMessages;
+}
+
+size_t Connection::getQueuedBytes() const {
+    return m_outboundQueue.getBytes();
+}
+
+bool Connection::isAuthPending() const {
+    return m_authPending;
+}
+
+void Connection::setAuthPending(bool authPending) {
+    m_authPending = authPending;
+}
+
+bool Connection::isFlushScheduled() const {
+    return m_flushScheduled;
+}
+
+void Connection::setFlushScheduled(bool flushScheduled) {
+    m_flushScheduled = flushScheduled;
+}
+
+const std::string& Connection::getSessionToken() const {
+    return m_sessionToken;
+}
+
+void Connection::setSessionToken(const std::string& sessionToken) {
+    m_sessionToken = sessionToken;
 }
 
 std::string Connection::recv(int size) {
     return m_socket.recv(size);
 }
 
+bool Connection::recvNonBlocking(std::string& data, int size) {
+    return m_socket.recvNonBlocking(data, size);
+}
+
+Connection::ReadResult Connection::readInput() {
+    if (m_completionInput) {
+        if (m_receivedOffset == m_received.size()) {
+            m_lineFramer.releaseIfEmpty();
+            return m_inputClosed ? ReadResult::CLOSED : ReadResult::WOULD_BLOCK;
+        }
+        std::span<char> space = m_lineFramer.writableSpace();
+        if (space.empty()) {
+            return ReadResult::WOULD_BLOCK;
+        }
+        size_t bytes = std::min(space.size(), m_received.size() - m_receivedOffset);
+        std::memcpy(space.data(), m_received.data() + m_receivedOffset, bytes);
+        m_lineFramer.commit(bytes);
+        m_receivedOffset += bytes;
+        if (m_receivedOffset == m_received.size()) {
+            // Keeps the capacity, so the next receive does not allocate
+            m_received.clear();
+            m_receivedOffset = 0;
+        }
+        return ReadResult::DATA;
+    }
+
+    std::span<char> space = m_lineFramer.writableSpace();
+    if (space.empty()) {
+        return ReadResult::WOULD_BLOCK;
+    }
+    ssize_t bytesReceived = m_socket.recvSome(space.data(), space.size());
+    if (bytesReceived > 0) {
+        Metrics::count(Counter::BYTES_RECEIVED, bytesReceived);
+        m_lineFramer.commit(bytesReceived);
+        return ReadResult::DATA;
+    }
+    m_lineFramer.releaseIfEmpty();
+    if (bytesReceived == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return ReadResult::WOULD_BLOCK;
+    }
+    return ReadResult::CLOSED;
+}
+
+void Connection::setCompletionInput(bool completionInput) {
+    m_completionInput = completionInput;
+}
+
+void Connection::receive(std::string_view data) {
+    Metrics::count(Counter::BYTES_RECEIVED, data.size());
+    m_received.append(data);
+}
+
+void Connection::closeInput() {
+    m_inputClosed = true;
+}
+
+size_t Connection::getReceivedBytes() const {
+    return m_received.size() - m_receivedOffset;
+}
+
+bool Connection::isReceivePaused() const {
+    return m_receivePaused;
+}
+
+void Connection::setReceivePaused(bool receivePaused) {
+    m_receivePaused = receivePaused;
+}
+
+size_t Connection::gatherOutput(iovec* iov, size_t maxCount) {
+    if (m_closing) {
+        return 0;
+    }
+    return m_outboundQueue.gather(iov, maxCount);
+}
+
+bool Connection::completeOutput(int result) {
+    if (result == -EAGAIN || result == -EWOULDBLOCK || result == -EINTR) {
+        return true;
+    }
+    if (result < 0) {
+        m_closing = true;
+        return false;
+    }
+    m_outboundQueue.consume(result);
+    Metrics::count(Counter::BYTES_SENT, result);
+    if (m_paused && m_outboundQueue.getBytes() <= m_outboundLimits.lowWatermark) {
+        m_paused = false;
+    }
+    return true;
+}
+
+bool Connection::isWriteWatched() const {
+    return m_writeWatched;
+}
+
+void Connection::setWriteWatched(bool writeWatched) {
+    m_writeWatched = writeWatched;
+}
+
+TimerHandle Connection::getTimer() const {
+    return m_timer;
+}
+
+void Connection::setTimer(TimerHandle timer) {
+    m_timer = timer;
+}
+
+std::chrono::steady_clock::time_point Connection::getLastInput() const {
+    return m_lastInput;
+}
+
+void Connection::setLastInput(std::chrono::steady_clock::time_point lastInput) {
+    m_lastInput = lastInput;
+}
+
+std::chrono::steady_clock::time_point Connection::getLastActivity() const {
+    return m_lastActivity;
+}
+
+void Connection::setLastActivity(std::chrono::steady_clock::time_point lastActivity) {
+    m_lastActivity = lastActivity;
+}
+
+std::chrono::steady_clock::time_point Connection::getPingSent() const {
+    return m_pingSent;
+}
+
+void Connection::setPingSent(std::chrono::steady_clock::time_point pingSent) {
+    m_pingSent = pingSent;
+}
+
+bool Connection::isBinary() const {
+    return m_binary;
+}
+
+void Connection::setBinary(bool binary) {
+    m_protocolChosen = true;
+    if (binary && !m_binary) {
+        // Still written as text, everything after it is framed
+        sendRaw(BINARY_PROTOCOL_ACK);
+    } else if (!binary && m_binary) {
+        // The last frame, everything after it are text lines
+        m_sendFrame(FrameType::CONTROL, static_cast<uint8_t>(FrameControl::TEXT_PROTOCOL), {});
+    }
+    m_binary = binary;
+    if (!binary) {
+        m_compressionThreshold = 0;
+    }
+}
+
+size_t Connection::getCompressionThreshold() const {
+    return m_compressionThreshold;
+}
+
+void Connection::setCompressionThreshold(size_t compressionThreshold) {
+    m_compressionThreshold = compressionThreshold;
+}
+
+LineFramer::Result Connection::nextLine(std::string_view& line) {
+    if (!m_protocolChosen && m_lineFramer.getBufferedBytes() > 0) {
+        m_protocolChosen = true;
+        if (m_lineFramer.skipByte(BINARY_PROTOCOL_MAGIC)) {
+            setBinary(true);
+        }
+    }
+    if (!m_binary) {
+        return m_lineFramer.nextLine(line);
+    }
+
+    FrameHeader header;
+    std::string_view payload;
+    LineFramer::Result result;
+    while ((result = m_lineFramer.nextFrame(header, payload)) == LineFramer::Result::LINE) {
+        switch (header.type) {
+            case FrameType::MESSAGE:
+                line = header.getText(payload);
+                return result;
+            case FrameType::PONG:
+                line = "/pong";
+                return result;
+            default:
+                // Frames only the server sends are ignored
+                break;
+        }
+    }
+    return result;
+}
+
 bool Connection::dataAvailable() {
     return m_socket.dataAvailable();
 }
\ No newline at end of file
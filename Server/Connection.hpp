@@ -1,15 +1,111 @@
 #pragma once
 
+#include <chrono>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "../Networking/BinaryFrame.hpp"
+#include "../Networking/BufferPool.hpp"
+#include "../Networking/LineFramer.hpp"
+#include "../Networking/MessageBuffer.hpp"
+#include "../Networking/OutboundQueue.hpp"
 #include "../Networking/TCPSocket.hpp"
+#include "../Networking/TimerWheel.hpp"
 #include "../Database/UserData.hpp"
+#include "TextColor.hpp"
 
 class Connection {
+   public:
+    enum class ReadResult {
+        // Data was received
+        DATA,
+        // Nothing is pending on the socket
+        WOULD_BLOCK,
+        // The peer closed the connection or the connection failed
+        CLOSED
+    };
+
    private:
     TCPSocket m_socket;
     UserData m_clientData;
 
+    // '<name>: ' prefix of the messages sent by this client, created once on login and shared by all recipients
+    MessageRef m_senderPrefix;
+
+    LineFramer m_lineFramer;
+    OutboundQueue m_outboundQueue;
+    OutboundLimits m_outboundLimits;
+    bool m_paused;
+    bool m_closing;
+    size_t m_droppedMessages;
+
+    // Set while a login or registration is handled by the AuthService, no further input is handled meanwhile
+    bool m_authPending;
+
+    // Set while the connection is registered to be flushed at the end of the current event loop iteration
+    bool m_flushScheduled;
+
+    // Token of the session issued on login, empty if the client has none
+    std::string m_sessionToken;
+
+    // With io_uring, input is handed over by the event loop and buffered here until the line framer has room for it
+    bool m_completionInput;
+    std::string m_received;
+    size_t m_receivedOffset;
+    bool m_inputClosed;
+    bool m_receivePaused;
+
+    // Set while waiting for the socket to become writable again after a batched send could not write everything
+    bool m_writeWatched;
+
+    // Login deadline or next keepalive check of the connection in the TimerWheel of its shard
+    TimerHandle m_timer;
+    // Last time anything was received, and a line other than '/pong'
+    std::chrono::steady_clock::time_point m_lastInput;
+    std::chrono::steady_clock::time_point m_lastActivity;
+    // Time the unanswered '/ping' was sent, the epoch if none is outstanding
+    std::chrono::steady_clock::time_point m_pingSent;
+
+    // Set once the client talks in binary frames, chosen by its first byte or with '/proto'
+    bool m_binary;
+    bool m_protocolChosen;
+    // Frames sent to a binary client that enabled compression are compressed from this size on, 0 while disabled
+    size_t m_compressionThreshold;
+
+    /*
+     * Writes a frame without room and sender
+     */
+    bool m_sendFrame(FrameType type, uint8_t flags, std::string_view text);
+
+    /*
+     * Writes the segments directly to the socket, only valid while nothing is queued
+     * @return number of written bytes, -1 if the connection failed
+     */
+    ssize_t m_writeDirect(std::span<const MessageRef> segments);
+
+    /*
+     * Queues the unwritten part of a message and applies the slow consumer policy
+     * @param segments - segments of the message
+     * @param written - number of bytes of the message that were already written
+     */
+    void m_enqueue(std::span<const MessageRef> segments, size_t written);
+
+    /*
+     * Counts messages dropped by the slow consumer policy
+     */
+    void m_drop(size_t messages);
+
    public:
-    Connection(TCPSocket&& socket, UserData clientData);
+    /*
+     * Constructor
+     * @param socket - connected non-blocking socket
+     * @param clientData - data of the logged in user, UserData::empty() before login
+     * @param receivePool - pool providing the receive buffer while a partial line is buffered
+     * @param outboundLimits - watermarks and slow consumer policy of the outbound queue
+     * @param maxLineLength - longest line accepted from the client, must be smaller than the pool's chunks
+     */
+    Connection(TCPSocket&& socket, UserData clientData, BufferPool& receivePool, OutboundLimits outboundLimits = OutboundLimits{}, size_t maxLineLength = 4096);
     Connection(const Connection& other) = delete;
     Connection(Connection&& other);
 
@@ -23,9 +119,180 @@ class Connection {
     UserData& getClientData();
     void setClientData(const UserData& clientData);
 
+    /*
+     * Returns the shared '<name>: ' prefix for messages of this client
+     */
+    const MessageRef& getSenderPrefix() const;
+
     std::string getRemoteAddr() const;
-    bool send(const std::string& data);
+
+    /*
+     * Writes a reply without blocking, the data is only copied if part of it has to be queued
+     * Binary clients receive it as a REPLY frame without the trailing line break.
+     * @return false if the connection failed or was marked for closing by the slow consumer policy
+     */
+    bool send(std::string_view data);
+
+    /*
+     * Writes bytes that are in the connection's protocol already (e.g. prepared frames) without blocking
+     * @return false if the connection failed or was marked for closing by the slow consumer policy
+     */
+    bool sendRaw(std::string_view data);
+
+    /*
+     * Writes complete frames, as a single COMPRESSED frame if compression is enabled, they are large enough and it pays off
+     * @return false if the connection failed or was marked for closing by the slow consumer policy
+     */
+    bool sendFrames(std::string_view frames);
+
+    /*
+     * Writes a server notice, decorated with its color and label for text clients and as a NOTICE frame for binary ones
+     * @return false if the connection failed or was marked for closing by the slow consumer policy
+     */
+    bool sendNotice(std::string_view text, TextColor color);
+
+    /*
+     * Writes a keepalive ping, '/ping' or a PING frame
+     * @return false if the connection failed or was marked for closing by the slow consumer policy
+     */
+    bool sendPing();
+
+    /*
+     * Writes a message consisting of shared segments with a single vectored send, the remainder is queued by reference
+     * @return false if the connection failed or was marked for closing by the slow consumer policy
+     */
+    bool send(std::span<const MessageRef> segments);
+
+    /*
+     * Queues a message consisting of shared segments without writing it, see setFlushScheduled
+     * All messages a client receives within one event loop iteration are written with a single call this way.
+     * @return false if the connection failed or was marked for closing by the slow consumer policy
+     */
+    bool post(std::span<const MessageRef> segments);
+
+    /*
+     * Writes a range of a file with sendfile while nothing is queued, the unwritten rest is copied into the queue
+     * @param fileFd - file to send from
+     * @param offset - offset of the range within the file
+     * @param mapped - the same range mapped into memory, used for the copy
+     * @return false if the connection failed or was marked for closing by the slow consumer policy
+     */
+    bool sendFile(int fileFd, off_t offset, std::string_view mapped);
+
+    /*
+     * Writes queued data until the socket would block, called when the socket becomes writable
+     * @return false if the connection failed
+     */
+    bool flush();
+
+    /*
+     * Returns true while the client is paused by the slow consumer policy, its input should not be read
+     */
+    bool isPaused() const;
+
+    /*
+     * Returns true if the connection failed or has to be closed due to the slow consumer policy
+     */
+    bool isClosing() const;
+
+    /*
+     * Number of messages that were dropped for this client due to the slow consumer policy
+     */
+    size_t getDroppedMessages() const;
+
+    size_t getQueuedBytes() const;
+
+    bool isAuthPending() const;
+    void setAuthPending(bool authPending);
+
+    bool isFlushScheduled() const;
+    void setFlushScheduled(bool flushScheduled);
+
+    const std::string& getSessionToken() const;
+    void setSessionToken(const std::string& sessionToken);
+
     std::string recv(int size = 1024);
+    bool recvNonBlocking(std::string& data, int size = 1024);
+
+    /*
+     * Receives pending data into the line framer without blocking
+     * All complete lines have to be consumed with nextLine before reading again. Once the socket is drained and no
+     * partial line is left, the receive buffer goes back to the pool.
+     */
+    ReadResult readInput();
+
+    /*
+     * Switches to input handed over by receive instead of being read from the socket (io_uring)
+     */
+    void setCompletionInput(bool completionInput);
+
+    /*
+     * Buffers received data until readInput moves it into the line framer (io_uring)
+     */
+    void receive(std::string_view data);
+
+    /*
+     * Marks the input as ended, readInput reports CLOSED once the buffered data was consumed (io_uring)
+     */
+    void closeInput();
+
+    /*
+     * Number of received bytes that readInput did not move into the line framer yet
+     */
+    size_t getReceivedBytes() const;
+
+    bool isReceivePaused() const;
+    void setReceivePaused(bool receivePaused);
+
+    /*
+     * Describes the queued output for a batched send
+     * @param iov - receives the segments
+     * @param maxCount - capacity of iov
+     * @return number of filled entries, 0 if nothing is queued or the connection is closing
+     */
+    size_t gatherOutput(iovec* iov, size_t maxCount);
+
+    /*
+     * Applies the result of a batched send of the gathered output
+     * @param result - number of written bytes or -errno
+     * @return false if the connection failed
+     */
+    bool completeOutput(int result);
+
+    bool isWriteWatched() const;
+    void setWriteWatched(bool writeWatched);
+
+    TimerHandle getTimer() const;
+    void setTimer(TimerHandle timer);
+
+    std::chrono::steady_clock::time_point getLastInput() const;
+    void setLastInput(std::chrono::steady_clock::time_point lastInput);
+
+    std::chrono::steady_clock::time_point getLastActivity() const;
+    void setLastActivity(std::chrono::steady_clock::time_point lastActivity);
+
+    std::chrono::steady_clock::time_point getPingSent() const;
+    void setPingSent(std::chrono::steady_clock::time_point pingSent);
+
+    bool isBinary() const;
+
+    /*
+     * Switches the protocol of both directions
+     * The switch to binary frames is announced with the line BINARY_PROTOCOL_ACK, the switch to text with a CONTROL frame.
+     * Switching to text disables compression.
+     */
+    void setBinary(bool binary);
+
+    size_t getCompressionThreshold() const;
+    void setCompressionThreshold(size_t compressionThreshold);
+
+    /*
+     * Extracts the next complete line received from the client
+     * A first byte of BINARY_PROTOCOL_MAGIC switches to binary frames. Binary clients send their lines as MESSAGE frames
+     * and answer pings with PONG frames, which is reported as '/pong'.
+     * @param line - set to a view of the line, valid until the next call of readInput
+     */
+    LineFramer::Result nextLine(std::string_view& line);
 
     bool dataAvailable();
 };
\ No newline at end of file
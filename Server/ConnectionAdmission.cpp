@@ -0,0 +1,71 @@
+#include "ConnectionAdmission.hpp"
+
+#include <algorithm>
+#include <bit>
+
+ConnectionAdmission::ConnectionAdmission(unsigned int ratePerSecond, unsigned int burst) : m_tokensPerMs{ratePerSecond / 1000.0},
+                                                                                          m_burst{static_cast<float>(std::max(burst, 1u))},
+                                                                                          m_buckets(m_minimumCapacity),
+                                                                                          m_count{0},
+                                                                                          m_shift{64 - static_cast<unsigned int>(std::countr_zero(m_minimumCapacity))},
+                                                                                          m_epoch{std::chrono::steady_clock::now()} {}
+
+size_t ConnectionAdmission::m_slot(uint32_t address) const {
+    // Fibonacci hashing, addresses of one subnet only differ in their last bits
+    size_t slot = (address * 0x9E3779B97F4A7C15ull) >> m_shift;
+    while (m_buckets[slot].address != 0 && m_buckets[slot].address != address) {
+        slot = (slot + 1) & (m_buckets.size() - 1);
+    }
+    return slot;
+}
+
+float ConnectionAdmission::m_refilled(const Bucket& bucket, uint64_t nowMs) const {
+    return std::min<float>(m_burst, bucket.tokens + (nowMs - bucket.refilledMs) * m_tokensPerMs);
+}
+
+void ConnectionAdmission::m_rebuild(uint64_t nowMs) {
+    std::vector<Bucket> kept;
+    for (const Bucket& bucket : m_buckets) {
+        if (bucket.address != 0 && m_refilled(bucket, nowMs) < m_burst) {
+            kept.push_back(bucket);
+        }
+    }
+
+    size_t capacity = std::max(m_minimumCapacity, std::bit_ceil(2 * (kept.size() + 1)));
+    m_buckets.assign(capacity, Bucket{});
+    m_shift = 64 - std::countr_zero(capacity);
+    m_count = kept.size();
+    for (const Bucket& bucket : kept) {
+        m_buckets[m_slot(bucket.address)] = bucket;
+    }
+}
+
+bool ConnectionAdmission::admit(uint32_t address, std::chrono::steady_clock::time_point now) {
+    if (m_tokensPerMs == 0) {
+        return true;
+    }
+    uint64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_epoch).count();
+
+    size_t slot = m_slot(address);
+    if (m_buckets[slot].address == 0) {
+        if (2 * (m_count + 1) > m_buckets.size()) {
+            m_rebuild(nowMs);
+            slot = m_slot(address);
+        }
+        m_buckets[slot] = Bucket{address, m_burst, nowMs};
+        m_count++;
+    }
+
+    Bucket& bucket = m_buckets[slot];
+    bucket.tokens = m_refilled(bucket, nowMs);
+    bucket.refilledMs = nowMs;
+    if (bucket.tokens < 1) {
+        return false;
+    }
+    bucket.tokens--;
+    return true;
+}
+
+size_t ConnectionAdmission::size() const {
+    return m_count;
+}
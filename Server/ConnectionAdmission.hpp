@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Limits the rate at which a single IPv4 address may open connections, with one token bucket per address (not thread-safe)
+ * The buckets live in an open addressing hash table of 16 byte entries. A bucket that refilled completely is the same
+ * as a new one, so such buckets are purged whenever the table would have to grow, which keeps the table proportional
+ * to the addresses that connected recently.
+ */
+class ConnectionAdmission {
+   private:
+    struct Bucket {
+        // IPv4 address in network byte order, 0 marks an empty slot (0.0.0.0 never connects)
+        uint32_t address;
+        float tokens;
+        // Milliseconds since m_epoch of the last refill
+        uint64_t refilledMs;
+    };
+
+    double m_tokensPerMs;
+    float m_burst;
+
+    // Capacity is a power of two, at most half of the slots are used
+    std::vector<Bucket> m_buckets;
+    size_t m_count;
+    unsigned int m_shift;
+
+    std::chrono::steady_clock::time_point m_epoch;
+
+    static constexpr size_t m_minimumCapacity = 1024;
+
+    size_t m_slot(uint32_t address) const;
+    float m_refilled(const Bucket& bucket, uint64_t nowMs) const;
+
+    /*
+     * Drops the full buckets and resizes the table, so it has room for at least one more bucket
+     */
+    void m_rebuild(uint64_t nowMs);
+
+   public:
+    /*
+     * Constructor
+     * @param ratePerSecond - connections an address may open per second on average, 0 admits every connection
+     * @param burst - connections an address may open at once
+     */
+    ConnectionAdmission(unsigned int ratePerSecond, unsigned int burst);
+
+    /*
+     * Takes a token from the bucket of the address
+     * @param address - IPv4 address in network byte order
+     * @return false if the address opened too many connections recently
+     */
+    bool admit(uint32_t address, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+    /*
+     * Number of addresses with a bucket
+     */
+    size_t size() const;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+/*
+ * Stable reference to a connection within the ConnectionSlab of its shard
+ * The generation changes whenever the slot is freed, so a handle never refers to a later connection using the same slot.
+ * A default constructed handle refers to no connection.
+ */
+struct ConnectionHandle {
+    static constexpr uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+
+    uint32_t index = NO_INDEX;
+    uint32_t generation = 0;
+
+    bool operator==(const ConnectionHandle& other) const = default;
+};
@@ -0,0 +1,88 @@
+#include "ConnectionSlab.hpp"
+
+#include <new>
+
+ConnectionSlab::ConnectionSlab() : m_freeHead{ConnectionHandle::NO_INDEX}, m_size{0} {}
+
+ConnectionSlab::~ConnectionSlab() {
+    for (uint32_t index = 0; index < m_slots.size(); index++) {
+        if (m_slots[index].state != State::FREE) {
+            std::destroy_at(m_connection(index));
+        }
+    }
+}
+
+Connection* ConnectionSlab::m_connection(uint32_t index) {
+    return std::launder(reinterpret_cast<Connection*>(m_chunks[index / CHUNK_SIZE][index % CHUNK_SIZE].bytes));
+}
+
+ConnectionHandle ConnectionSlab::insert(Connection&& connection) {
+    uint32_t index = m_freeHead;
+    if (index == ConnectionHandle::NO_INDEX) {
+        index = m_slots.size();
+        if (index % CHUNK_SIZE == 0) {
+            m_chunks.push_back(std::make_unique<Storage[]>(CHUNK_SIZE));
+        }
+        m_slots.push_back(Slot{-1, 0, ConnectionHandle::NO_INDEX, State::FREE});
+    } else {
+        m_freeHead = m_slots[index].nextFree;
+    }
+
+    Slot& slot = m_slots[index];
+    slot.fd = connection.getSocket().getSockFd();
+    slot.state = State::NEW;
+    new (m_chunks[index / CHUNK_SIZE][index % CHUNK_SIZE].bytes) Connection(std::move(connection));
+    m_size++;
+    return ConnectionHandle{index, slot.generation};
+}
+
+void ConnectionSlab::remove(ConnectionHandle handle) {
+    Connection* connection = get(handle);
+    if (connection == nullptr) {
+        return;
+    }
+    std::destroy_at(connection);
+
+    Slot& slot = m_slots[handle.index];
+    slot.fd = -1;
+    slot.generation++;
+    slot.state = State::FREE;
+    slot.nextFree = m_freeHead;
+    m_freeHead = handle.index;
+    m_size--;
+}
+
+Connection* ConnectionSlab::get(ConnectionHandle handle) {
+    if (handle.index >= m_slots.size()) {
+        return nullptr;
+    }
+    const Slot& slot = m_slots[handle.index];
+    if (slot.state == State::FREE || slot.generation != handle.generation) {
+        return nullptr;
+    }
+    return m_connection(handle.index);
+}
+
+Connection& ConnectionSlab::at(uint32_t index) {
+    return *m_connection(index);
+}
+
+ConnectionHandle ConnectionSlab::getHandle(uint32_t index) const {
+    return ConnectionHandle{index, m_slots[index].generation};
+}
+
+int ConnectionSlab::getFd(uint32_t index) const {
+    return m_slots[index].fd;
+}
+
+ConnectionSlab::State ConnectionSlab::getState(uint32_t index) const {
+    return m_slots[index].state;
+}
+
+void ConnectionSlab::setState(uint32_t index, State state) {
+    m_slots[index].state = state;
+}
+
+size_t ConnectionSlab::getSize() const {
+    return m_size;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Connection.hpp"
+#include "ConnectionHandle.hpp"
+
+/*
+ * Slab of the connections of one shard (not thread-safe)
+ * Insertion and removal are O(1): freed slots are kept in a free list and reused, no other connection is moved.
+ * The data needed to find and filter connections (file descriptor, state, generation) is kept in a dense array of
+ * slots, separate from the Connection objects with their buffers, names and addresses. The Connection objects live in
+ * fixed-size chunks, so references to them stay valid when the slab grows.
+ */
+class ConnectionSlab {
+   public:
+    enum class State : uint8_t {
+        FREE,
+        // Connected, but not logged in
+        NEW,
+        // Logged in
+        APPROVED
+    };
+
+   private:
+    struct Slot {
+        int fd;
+        uint32_t generation;
+        // Next free slot while this one is free
+        uint32_t nextFree;
+        State state;
+    };
+
+    struct alignas(Connection) Storage {
+        std::byte bytes[sizeof(Connection)];
+    };
+
+    static constexpr size_t CHUNK_SIZE = 256;
+
+    std::vector<Slot> m_slots;
+    std::vector<std::unique_ptr<Storage[]>> m_chunks;
+    uint32_t m_freeHead;
+    size_t m_size;
+
+    Connection* m_connection(uint32_t index);
+
+   public:
+    ConnectionSlab();
+    ConnectionSlab(const ConnectionSlab& other) = delete;
+    ~ConnectionSlab();
+
+    ConnectionSlab& operator=(const ConnectionSlab& other) = delete;
+
+    /*
+     * Stores a connection in a free slot, its state is NEW
+     * @return handle of the stored connection
+     */
+    ConnectionHandle insert(Connection&& connection);
+
+    /*
+     * Destroys a connection (closing its socket) and frees its slot, stale handles are ignored
+     */
+    void remove(ConnectionHandle handle);
+
+    /*
+     * Returns the connection of a handle, nullptr if it was removed meanwhile
+     */
+    Connection* get(ConnectionHandle handle);
+
+    /*
+     * Returns the connection in an occupied slot
+     */
+    Connection& at(uint32_t index);
+
+    ConnectionHandle getHandle(uint32_t index) const;
+    int getFd(uint32_t index) const;
+
+    State getState(uint32_t index) const;
+    void setState(uint32_t index, State state);
+
+    /*
+     * Number of stored connections
+     */
+    size_t getSize() const;
+
+    /*
+     * Calls function(handle, connection) for every connection in the given state
+     * The function must not insert or remove connections.
+     */
+    template <typename Function>
+    void forEach(State state, Function function) {
+        for (uint32_t index = 0; index < m_slots.size(); index++) {
+            if (m_slots[index].state == state) {
+                function(ConnectionHandle{index, m_slots[index].generation}, *m_connection(index));
+            }
+        }
+    }
+};
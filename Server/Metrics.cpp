@@ -0,0 +1,177 @@
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <limits>
+
+namespace {
+
+struct MetricInfo {
+    const char* name;
+    const char* help;
+};
+
+const MetricInfo counterInfos[] = {
+    {"accepted_connections", "Connections accepted by the reactors"},
+    {"closed_connections", "Connections closed by the reactors"},
+    {"rejected_connections", "Connections closed right after accepting them, due to the per-address limit or a lack of file descriptors"},
+    {"timed_out_connections", "Connections closed because the client did not log in, stayed idle or did not answer a ping in time"},
+    {"logins", "Successful logins"},
+    {"failed_logins", "Logins rejected due to invalid credentials or database errors"},
+    {"registrations", "Registered users"},
+    {"resumed_sessions", "Sessions resumed after a reconnect"},
+    {"received_bytes", "Bytes received from clients"},
+    {"sent_bytes", "Bytes written to clients"},
+    {"compression_saved_bytes", "Bytes clients did not have to receive because frames were sent compressed"},
+    {"received_messages", "Chat messages received from clients"},
+    {"delivered_messages", "Messages queued for a recipient (fan-out)"},
+    {"dropped_messages", "Messages dropped by the slow consumer policy"},
+};
+static_assert(std::size(counterInfos) == static_cast<size_t>(Counter::COUNT));
+
+struct HistogramInfo {
+    const char* name;
+    const char* help;
+    // Factor converting recorded values to the unit of the Prometheus metric
+    double scale;
+};
+
+const HistogramInfo histogramInfos[] = {
+    {"loop_iteration_seconds", "Time a reactor spends handling the events of one poll call", 1e-9},
+    {"database_call_seconds", "Time of a single user database call", 1e-9},
+    {"outbound_queue_bytes", "Outbound queue of a connection after flushing it", 1},
+};
+static_assert(std::size(histogramInfos) == static_cast<size_t>(Histogram::COUNT));
+
+// Text names keep the recorded unit
+const char* histogramTextNames[] = {"loop_iteration_ns", "database_call_ns", "outbound_queue_bytes"};
+
+}  // namespace
+
+thread_local MetricsShard* Metrics::t_shard = nullptr;
+
+uint64_t MetricsShard::bucketStart(size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    unsigned int exponent = bucket / SUB_BUCKETS + 3;
+    return (SUB_BUCKETS + bucket % SUB_BUCKETS) << (exponent - 4);
+}
+
+uint64_t MetricsShard::getCounter(Counter counter) const {
+    return m_counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+}
+
+const MetricsShard::HistogramData& MetricsShard::getHistogram(Histogram histogram) const {
+    return m_histograms[static_cast<size_t>(histogram)];
+}
+
+uint64_t Metrics::HistogramSnapshot::quantile(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    // Nearest rank, so the quantiles of a few samples are samples and not interpolated
+    uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(q * count)), 1);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < buckets.size(); bucket++) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            uint64_t end = bucket + 1 < buckets.size() ? MetricsShard::bucketStart(bucket + 1) - 1 : std::numeric_limits<uint64_t>::max();
+            return std::min(end, max);
+        }
+    }
+    return max;
+}
+
+void Metrics::registerThread() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_shards.push_back(std::make_unique<MetricsShard>());
+    t_shard = m_shards.back().get();
+}
+
+Metrics::Snapshot Metrics::snapshot() const {
+    Snapshot snapshot;
+    for (HistogramSnapshot& histogram : snapshot.histograms) {
+        histogram.buckets.assign(MetricsShard::BUCKETS, 0);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const std::unique_ptr<MetricsShard>& shard : m_shards) {
+        for (size_t counter = 0; counter < snapshot.counters.size(); counter++) {
+            snapshot.counters[counter] += shard->getCounter(static_cast<Counter>(counter));
+        }
+        for (size_t histogram = 0; histogram < snapshot.histograms.size(); histogram++) {
+            const MetricsShard::HistogramData& data = shard->getHistogram(static_cast<Histogram>(histogram));
+            HistogramSnapshot& total = snapshot.histograms[histogram];
+            for (size_t bucket = 0; bucket < MetricsShard::BUCKETS; bucket++) {
+                total.buckets[bucket] += data.buckets[bucket].load(std::memory_order_relaxed);
+            }
+            total.count += data.count.load(std::memory_order_relaxed);
+            total.sum += data.sum.load(std::memory_order_relaxed);
+            total.max = std::max(total.max, data.max.load(std::memory_order_relaxed));
+        }
+    }
+    return snapshot;
+}
+
+std::string Metrics::formatText() const {
+    Snapshot snapshot = this->snapshot();
+    char line[160];
+    std::string text = "Counters:\n";
+    for (size_t counter = 0; counter < snapshot.counters.size(); counter++) {
+        std::snprintf(line, sizeof(line), "  %-24s %llu\n", counterInfos[counter].name, static_cast<unsigned long long>(snapshot.counters[counter]));
+        text += line;
+    }
+    std::snprintf(line, sizeof(line), "Histograms:%25s %12s %12s %12s %12s\n", "count", "p50", "p99", "p99.9", "max");
+    text += line;
+    for (size_t histogram = 0; histogram < snapshot.histograms.size(); histogram++) {
+        const HistogramSnapshot& data = snapshot.histograms[histogram];
+        std::snprintf(line, sizeof(line), "  %-24s %10llu %12llu %12llu %12llu %12llu\n", histogramTextNames[histogram], static_cast<unsigned long long>(data.count),
+                      static_cast<unsigned long long>(data.quantile(0.5)), static_cast<unsigned long long>(data.quantile(0.99)),
+                      static_cast<unsigned long long>(data.quantile(0.999)), static_cast<unsigned long long>(data.max));
+        text += line;
+    }
+    return text;
+}
+
+std::string Metrics::formatPrometheus() const {
+    Snapshot snapshot = this->snapshot();
+    std::string text;
+    char line[160];
+    for (size_t counter = 0; counter < snapshot.counters.size(); counter++) {
+        const MetricInfo& info = counterInfos[counter];
+        text += std::string("# HELP chat_") + info.name + "_total " + info.help + "\n";
+        text += std::string("# TYPE chat_") + info.name + "_total counter\n";
+        std::snprintf(line, sizeof(line), "chat_%s_total %llu\n", info.name, static_cast<unsigned long long>(snapshot.counters[counter]));
+        text += line;
+    }
+
+    // Buckets at every power of two keep the set of bounds the same between scrapes
+    constexpr unsigned int maxExponent = 40;
+    for (size_t histogram = 0; histogram < snapshot.histograms.size(); histogram++) {
+        const HistogramInfo& info = histogramInfos[histogram];
+        const HistogramSnapshot& data = snapshot.histograms[histogram];
+        text += std::string("# HELP chat_") + info.name + " " + info.help + "\n";
+        text += std::string("# TYPE chat_") + info.name + " histogram\n";
+
+        uint64_t cumulative = 0;
+        size_t bucket = 0;
+        for (unsigned int exponent = 0; exponent <= maxExponent; exponent++) {
+            uint64_t bound = uint64_t{1} << exponent;
+            for (; bucket < MetricsShard::BUCKETS && MetricsShard::bucketStart(bucket) < bound; bucket++) {
+                cumulative += data.buckets[bucket];
+            }
+            std::snprintf(line, sizeof(line), "chat_%s_bucket{le=\"%.9g\"} %llu\n", info.name, (bound - 1) * info.scale, static_cast<unsigned long long>(cumulative));
+            text += line;
+        }
+        std::snprintf(line, sizeof(line), "chat_%s_bucket{le=\"+Inf\"} %llu\n", info.name, static_cast<unsigned long long>(data.count));
+        text += line;
+        std::snprintf(line, sizeof(line), "chat_%s_sum %.9g\n", info.name, data.sum * info.scale);
+        text += line;
+        std::snprintf(line, sizeof(line), "chat_%s_count %llu\n", info.name, static_cast<unsigned long long>(data.count));
+        text += line;
+    }
+    return text;
+}
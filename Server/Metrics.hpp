@@ -0,0 +1,185 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class Counter : size_t {
+    ACCEPTED_CONNECTIONS,
+    CLOSED_CONNECTIONS,
+    REJECTED_CONNECTIONS,
+    TIMED_OUT_CONNECTIONS,
+    LOGINS,
+    FAILED_LOGINS,
+    REGISTRATIONS,
+    RESUMED_SESSIONS,
+    BYTES_RECEIVED,
+    BYTES_SENT,
+    COMPRESSION_SAVED_BYTES,
+    MESSAGES_RECEIVED,
+    MESSAGES_DELIVERED,
+    MESSAGES_DROPPED,
+    COUNT
+};
+
+enum class Histogram : size_t {
+    // Time a reactor spends handling the events of one poll call
+    LOOP_ITERATION_NS,
+    // Time of a single user database call of the AuthService
+    DATABASE_CALL_NS,
+    // Outbound queue of a connection after it was flushed
+    OUTBOUND_QUEUE_BYTES,
+    COUNT
+};
+
+/*
+ * Counters and histograms written by a single thread
+ * Only the owning thread writes, so an update is a relaxed load and store (a plain add) instead of an atomic
+ * read-modify-write. Other threads read the values at any time and see every update eventually.
+ * Histograms use log-linear buckets like HdrHistogram: 16 linear sub-buckets per power of two, so every recorded
+ * value is known with a relative error below 1/16.
+ */
+class MetricsShard {
+   public:
+    static constexpr size_t SUB_BUCKETS = 16;
+    static constexpr size_t BUCKETS = (64 - 3) * SUB_BUCKETS;
+
+    struct HistogramData {
+        std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+    };
+
+   private:
+    alignas(64) std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::COUNT)> m_counters{};
+    std::array<HistogramData, static_cast<size_t>(Histogram::COUNT)> m_histograms{};
+
+    static void m_increase(std::atomic<uint64_t>& value, uint64_t amount) {
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+   public:
+    void add(Counter counter, uint64_t amount) {
+        m_increase(m_counters[static_cast<size_t>(counter)], amount);
+    }
+
+    void record(Histogram histogram, uint64_t value) {
+        HistogramData& data = m_histograms[static_cast<size_t>(histogram)];
+        m_increase(data.buckets[bucketOf(value)], 1);
+        m_increase(data.count, 1);
+        m_increase(data.sum, value);
+        if (value > data.max.load(std::memory_order_relaxed)) {
+            data.max.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    /*
+     * Index of the bucket holding a value, values below SUB_BUCKETS have a bucket of their own
+     */
+    static size_t bucketOf(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return value;
+        }
+        unsigned int exponent = 63 - __builtin_clzll(value);
+        return (exponent - 3) * SUB_BUCKETS + ((value >> (exponent - 4)) & (SUB_BUCKETS - 1));
+    }
+
+    /*
+     * Smallest value of a bucket
+     */
+    static uint64_t bucketStart(size_t bucket);
+
+    uint64_t getCounter(Counter counter) const;
+    const HistogramData& getHistogram(Histogram histogram) const;
+};
+
+/*
+ * Metrics of all threads of the server (thread-safe)
+ * Every thread that records metrics registers once and then writes into its own MetricsShard through a thread_local
+ * pointer, so recording never takes a lock or shares a cache line with another thread. Threads that did not register
+ * (e.g. in the benchmarks) record nothing. Reading sums up all shards.
+ */
+class Metrics {
+   public:
+    struct HistogramSnapshot {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        /*
+         * Returns the upper end of the bucket holding the given quantile (0 to 1), 0 if nothing was recorded
+         */
+        uint64_t quantile(double q) const;
+    };
+
+    struct Snapshot {
+        std::array<uint64_t, static_cast<size_t>(Counter::COUNT)> counters{};
+        std::array<HistogramSnapshot, static_cast<size_t>(Histogram::COUNT)> histograms;
+    };
+
+   private:
+    mutable std::mutex m_mutex;
+    std::deque<std::unique_ptr<MetricsShard>> m_shards;
+
+    static thread_local MetricsShard* t_shard;
+
+   public:
+    /*
+     * Creates the shard of the calling thread, its metrics are recorded from now on
+     */
+    void registerThread();
+
+    static void count(Counter counter, uint64_t amount = 1) {
+        if (t_shard != nullptr) {
+            t_shard->add(counter, amount);
+        }
+    }
+
+    static void record(Histogram histogram, uint64_t value) {
+        if (t_shard != nullptr) {
+            t_shard->record(histogram, value);
+        }
+    }
+
+    /*
+     * Sums up the metrics of all threads
+     */
+    Snapshot snapshot() const;
+
+    /*
+     * Human readable summary for the server console: counters and the count, p50, p99, p99.9 and max of every histogram
+     */
+    std::string formatText() const;
+
+    /*
+     * Prometheus text exposition format (version 0.0.4)
+     */
+    std::string formatPrometheus() const;
+};
+
+/*
+ * Records the time from its construction to its destruction in a histogram
+ */
+class ScopedLatency {
+   private:
+    Histogram m_histogram;
+    std::chrono::steady_clock::time_point m_start;
+
+   public:
+    ScopedLatency(Histogram histogram) : m_histogram{histogram}, m_start{std::chrono::steady_clock::now()} {}
+    ScopedLatency(const ScopedLatency& other) = delete;
+    ScopedLatency& operator=(const ScopedLatency& other) = delete;
+
+    ~ScopedLatency() {
+        Metrics::record(m_histogram, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count());
+    }
+};
@@ -0,0 +1,77 @@
+#include "PresenceAggregator.hpp"
+
+#include <algorithm>
+
+PresenceAggregator::PresenceAggregator(std::chrono::milliseconds window) : m_window{window} {}
+
+void PresenceAggregator::joined(const std::string& name) {
+    m_record(name, 1);
+}
+
+void PresenceAggregator::left(const std::string& name) {
+    m_record(name, -1);
+}
+
+void PresenceAggregator::m_record(const std::string& name, int change) {
+    if (m_order.empty()) {
+        m_deadline = std::chrono::steady_clock::now() + m_window;
+    }
+    auto [it, inserted] = m_balance.try_emplace(name, 0);
+    if (inserted) {
+        m_order.push_back(name);
+    }
+    it->second += change;
+}
+
+bool PresenceAggregator::isDue() const {
+    return !m_order.empty() && std::chrono::steady_clock::now() >= m_deadline;
+}
+
+int PresenceAggregator::getTimeoutMs() const {
+    if (m_order.empty()) {
+        return -1;
+    }
+    auto remaining = std::chrono::ceil<std::chrono::milliseconds>(m_deadline - std::chrono::steady_clock::now());
+    return std::max<int>(0, remaining.count());
+}
+
+std::vector<std::string> PresenceAggregator::take() {
+    std::vector<std::string> joined;
+    std::vector<std::string> left;
+    for (const std::string& name : m_order) {
+        int balance = m_balance.at(name);
+        if (balance > 0) {
+            joined.push_back(name);
+        } else if (balance < 0) {
+            left.push_back(name);
+        }
+    }
+    m_balance.clear();
+    m_order.clear();
+
+    std::vector<std::string> summaries;
+    if (!joined.empty()) {
+        summaries.push_back(m_summarize(joined, "joined the server"));
+    }
+    if (!left.empty()) {
+        summaries.push_back(m_summarize(left, "left the server"));
+    }
+    return summaries;
+}
+
+std::string PresenceAggregator::m_summarize(const std::vector<std::string>& names, const std::string& action) const {
+    // 'alice', 'alice and bob', 'alice, bob and carol', 'alice, bob, carol and 2 others'
+    size_t listed = names.size() <= m_listedNames + 1 ? names.size() : m_listedNames;
+    size_t others = names.size() - listed;
+    std::string summary;
+    for (size_t nameIdx = 0; nameIdx < listed; nameIdx++) {
+        if (nameIdx > 0) {
+            summary += (nameIdx + 1 == listed && others == 0) ? " and " : ", ";
+        }
+        summary += names[nameIdx];
+    }
+    if (others > 0) {
+        summary += " and " + std::to_string(others) + " others";
+    }
+    return summary + " " + action;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Collects the logins and logouts of one shard over a short window and summarizes them (not thread-safe)
+ * A reconnect wave then costs one notification per window instead of one per user, e.g.
+ * 'alice, bob, carol and 47 others joined the server'. A user leaving and joining again within the same window
+ * cancels out and is not reported at all.
+ */
+class PresenceAggregator {
+   private:
+    std::chrono::milliseconds m_window;
+    std::chrono::steady_clock::time_point m_deadline;
+
+    // Net change per user (joins minus leaves) and the order in which the users were first seen
+    std::unordered_map<std::string, int> m_balance;
+    std::vector<std::string> m_order;
+
+    // Names listed in a summary before the rest is only counted
+    const size_t m_listedNames = 3;
+
+    void m_record(const std::string& name, int change);
+    std::string m_summarize(const std::vector<std::string>& names, const std::string& action) const;
+
+   public:
+    /*
+     * Constructor
+     * @param window - time events are collected after the first one, 0 reports every event right away
+     */
+    PresenceAggregator(std::chrono::milliseconds window);
+
+    void joined(const std::string& name);
+    void left(const std::string& name);
+
+    /*
+     * Returns true if events are pending and the window elapsed
+     */
+    bool isDue() const;
+
+    /*
+     * Time until the pending events are due in milliseconds, -1 if none are pending
+     */
+    int getTimeoutMs() const;
+
+    /*
+     * Returns the summaries of the pending events (at most one for joins and one for leaves) and clears them
+     */
+    std::vector<std::string> take();
+};
@@ -0,0 +1,23 @@
+#include "RoomDirectory.hpp"
+
+size_t RoomDirectory::enter(std::string_view room) {
+    std::lock_guard lock{m_mutex};
+    auto it = m_memberCounts.find(room);
+    if (it == m_memberCounts.end()) {
+        it = m_memberCounts.emplace(std::string(room), 0).first;
+    }
+    return ++it->second;
+}
+
+void RoomDirectory::exit(std::string_view room) {
+    std::lock_guard lock{m_mutex};
+    auto it = m_memberCounts.find(room);
+    if (it != m_memberCounts.end() && --it->second == 0) {
+        m_memberCounts.erase(it);
+    }
+}
+
+std::vector<std::pair<std::string, size_t>> RoomDirectory::list() const {
+    std::lock_guard lock{m_mutex};
+    return std::vector<std::pair<std::string, size_t>>(m_memberCounts.begin(), m_memberCounts.end());
+}
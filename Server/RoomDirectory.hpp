@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*
+ * Member counts of the rooms of all shards, used to list the rooms (thread-safe)
+ * Only joins and leaves update it, messages to a room never touch it.
+ */
+class RoomDirectory {
+   private:
+    mutable std::mutex m_mutex;
+    std::map<std::string, size_t, std::less<>> m_memberCounts;
+
+   public:
+    /*
+     * Counts a new member of a room
+     * @return number of members including the new one
+     */
+    size_t enter(std::string_view room);
+
+    /*
+     * Counts a member leaving a room, rooms without members are removed
+     */
+    void exit(std::string_view room);
+
+    /*
+     * Returns the names and member counts of all rooms, ordered by name
+     */
+    std::vector<std::pair<std::string, size_t>> list() const;
+};
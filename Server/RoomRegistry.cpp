@@ -0,0 +1,50 @@
+#include "RoomRegistry.hpp"
+
+std::string RoomRegistry::join(uint32_t index, std::string_view room) {
+    std::string previous = leave(index);
+
+    auto it = m_rooms.find(room);
+    if (it == m_rooms.end()) {
+        it = m_rooms.emplace(std::string(room), Room{MessageBuffer::create({room}), {}}).first;
+    }
+    m_memberships[index] = Membership{it->first, it->second.members.size()};
+    it->second.members.push_back(index);
+    return previous;
+}
+
+std::string RoomRegistry::leave(uint32_t index) {
+    auto membershipIt = m_memberships.find(index);
+    if (membershipIt == m_memberships.end()) {
+        return "";
+    }
+    Membership membership = std::move(membershipIt->second);
+    m_memberships.erase(membershipIt);
+
+    auto roomIt = m_rooms.find(membership.room);
+    std::vector<uint32_t>& members = roomIt->second.members;
+    if (membership.slot + 1 != members.size()) {
+        uint32_t moved = members.back();
+        members[membership.slot] = moved;
+        m_memberships.at(moved).slot = membership.slot;
+    }
+    members.pop_back();
+    if (members.empty()) {
+        m_rooms.erase(roomIt);
+    }
+    return membership.room;
+}
+
+std::string_view RoomRegistry::getRoom(uint32_t index) const {
+    auto it = m_memberships.find(index);
+    return it != m_memberships.end() ? std::string_view(it->second.room) : std::string_view();
+}
+
+std::span<const uint32_t> RoomRegistry::getMembers(std::string_view room) const {
+    auto it = m_rooms.find(room);
+    return it != m_rooms.end() ? std::span<const uint32_t>(it->second.members) : std::span<const uint32_t>();
+}
+
+MessageRef RoomRegistry::getSharedName(std::string_view room) const {
+    auto it = m_rooms.find(room);
+    return it != m_rooms.end() ? it->second.name : MessageBuffer::create({room});
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../Networking/MessageBuffer.hpp"
+
+/*
+ * Room memberships of the connections of one shard (not thread-safe)
+ * Every room holds a compact array with the ConnectionSlab indices of its members, so a message to a room costs
+ * O(room size) instead of O(connections). A connection is member of at most one room, it has to leave its room before
+ * its slot is freed.
+ */
+class RoomRegistry {
+   private:
+    // Allows looking rooms up by string_view without constructing a string
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const {
+            return std::hash<std::string_view>{}(name);
+        }
+    };
+
+    struct Room {
+        // Shared copy of the name, handed to other shards and the history instead of copying it per message
+        MessageRef name;
+        std::vector<uint32_t> members;
+    };
+
+    struct Membership {
+        std::string room;
+        // Index of the connection within the member array of its room
+        size_t slot;
+    };
+
+    std::unordered_map<std::string, Room, NameHash, std::equal_to<>> m_rooms;
+    std::unordered_map<uint32_t, Membership> m_memberships;
+
+   public:
+    /*
+     * Adds a connection to a room, it leaves its previous room first
+     * @param index - slab index of the connection
+     * @param room - name of the room, created if it does not exist
+     * @return name of the previous room, empty if the connection was in none
+     */
+    std::string join(uint32_t index, std::string_view room);
+
+    /*
+     * Removes a connection from its room, empty rooms are deleted
+     * The last member of the room takes over the slot of the leaving one.
+     * @return name of the room that was left, empty if the connection was in none
+     */
+    std::string leave(uint32_t index);
+
+    /*
+     * Returns the room of a connection, empty if it is in none
+     */
+    std::string_view getRoom(uint32_t index) const;
+
+    /*
+     * Returns the slab indices of the members of a room
+     * The span is invalidated by the next join or leave.
+     */
+    std::span<const uint32_t> getMembers(std::string_view room) const;
+
+    /*
+     * Returns the shared name of a room with local members, a new buffer with the name otherwise
+     */
+    MessageRef getSharedName(std::string_view room) const;
+};
@@ -1,15 +1,65 @@
 
 #include "Server.hpp"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <optional>
+
+#include "../Logging/Logger.hpp"
+#include "ServerGroup.hpp"
+
+namespace {
+
+EventLoop createEventLoop(EventLoop::Backend backend) {
+    if (backend == EventLoop::Backend::IO_URING) {
+        try {
+            return EventLoop(EventLoop::Backend::IO_URING);
+        } catch (const std::runtime_error& error) {
+            // e.g. the locked memory limit is too low for another ring
+            Logger::warning(error.what(), ", falling back to epoll");
+        }
+    }
+    return EventLoop(EventLoop::Backend::EPOLL);
+}
+
+}  // namespace
 
-Server::Server(uint16_t port) : m_running{false},
-                                m_port{port},
-                                m_listeningTCPSocket(TCPSocket(TCPSocketType::TCP)),
-                                m_stdinTCPSocket(TCPSocket::stdinSocket()),
-                                m_userDatabase{m_databasePath} {}
+Server::Server(const ServerConfig& config, ServerGroup& group, unsigned int shardIndex) : m_running{false},
+                                                                                          m_port{config.port},
+                                                                                          m_group{group},
+                                                                                          m_shardIndex{shardIndex},
+                                                                                          m_listeningTCPSocket(TCPSocket(TCPSocketType::TCP)),
+                                                                                          m_listenBacklog{config.listenBacklog},
+                                                                                          m_stdinTCPSocket(TCPSocket::stdinSocket()),
+                                                                                          m_eventLoop{createEventLoop(config.ioBackend)},
+                                                                                          m_outboundLimits{config.outboundLimits},
+                                                                                          m_maxLineLength{config.maxLineLength},
+                                                                                          m_compressionThreshold{config.compressionThreshold},
+                                                                                          m_admission{config.connectRate, config.connectBurst},
+                                                                                          m_spareFd{::open("/dev/null", O_RDONLY | O_CLOEXEC)},
+                                                                                          m_receivePool{std::max<size_t>(2 * config.maxLineLength, 4096)},
+                                                                                          m_presence{std::chrono::milliseconds(config.presenceWindowMs)},
+                                                                                          m_sessionsEnabled{config.sessionTtl > 0},
+                                                                                          m_timers{std::chrono::milliseconds(100)},
+                                                                                          m_loginTimeout{config.loginTimeout},
+                                                                                          m_idleTimeout{config.idleTimeout},
+                                                                                          m_pingInterval{config.pingInterval},
+                                                                                          m_pingTimeout{config.pingTimeout},
+                                                                                          m_historyReplay{config.historyReplay},
+                                                                                          m_messageCount{0} {}
+
+Server::~Server() {
+    if (m_spareFd != -1) {
+        close(m_spareFd);
+    }
+}
 
 Server::ServerCommand Server::m_parseCommand(const std::string& command) {
     if (command == "exit") {
@@ -18,165 +68,1044 @@ Server::ServerCommand Server::m_parseCommand(const std::string& command) {
     if (command == "help") {
         return ServerCommand::HELP;
     }
+    if (command == "stats") {
+        return ServerCommand::STATS;
+    }
     return ServerCommand::INVALID;
 }
 
-std::string Server::m_colorizeText(const std::string& text, TextColor color) {
-    switch (color) {
-        case TextColor::SERVER_ALERT:
-            return "\033[31m" + text + "\033[0m";
-        case TextColor::SERVER_MESSAGE:
-            return "\033[32m" + text + "\033[0m";
-        case TextColor::SERVER_NOTIFICATION:
-            return "\033[36m" + text + "\033[0m";
-        default:
-            return text;
+bool Server::m_isValidRoomName(std::string_view room) const {
+    if (room.empty() || room.length() > m_maximumRoomNameLength) {
+        return false;
     }
+    return std::all_of(room.begin(), room.end(), [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_'; });
+}
+
+uint64_t Server::m_nextMessageId() {
+    return (static_cast<uint64_t>(m_shardIndex) << 56) | ++m_messageCount;
 }
 
 void Server::run() {
+    Logger::setThreadName("reactor-" + std::to_string(m_shardIndex));
+    m_group.getMetrics().registerThread();
+
+    if (m_group.getShardCount() > 1 && !m_listeningTCPSocket.setReusePort(true)) {
+        Logger::error("setsockopt SO_REUSEPORT failed, errno: ", errno);
+        exit(1);
+    }
+
     if (!m_listeningTCPSocket.bind(m_port)) {
-        std::cerr << "bind failed, errno: " << std::to_string(errno) << std::endl;
+        Logger::error("bind failed, errno: ", errno);
         exit(1);
     }
 
-    if (!m_listeningTCPSocket.listen(m_listenBufferSize)) {
-        std::cerr << "listen failed, errno: " << std::to_string(errno) << std::endl;
+    if (!m_listeningTCPSocket.listen(m_listenBacklog)) {
+        Logger::error("listen failed, errno: ", errno);
         exit(1);
     }
 
+    m_listeningTCPSocket.setNonBlocking(true);
+    if (m_eventLoop.getBackend() == EventLoop::Backend::IO_URING) {
+        m_eventLoop.accept(m_listeningTCPSocket.getSockFd(), [this](int result) { handleAcceptedConnection(result); });
+    } else {
+        // Level-triggered, so a connection storm is accepted in batches instead of all at once
+        m_eventLoop.add(m_listeningTCPSocket.getSockFd(), EPOLLIN, [this](uint32_t) { handleNewConnections(); }, true);
+    }
+    m_eventLoop.add(m_inbox.getFd(), EPOLLIN, [this](uint32_t) { handleShardEvents(); });
+    m_eventLoop.add(m_authResults.getFd(), EPOLLIN, [this](uint32_t) { handleAuthResults(); });
+    if (m_shardIndex == 0 && m_sessionsEnabled) {
+        m_sessionTimer = std::make_unique<IntervalTimer>(std::chrono::milliseconds(1000));
+        m_eventLoop.add(m_sessionTimer->getFd(), EPOLLIN, [this](uint32_t) { expireSessions(); });
+    }
+
+    // stdin is shared with the terminal and therefore stays blocking, so it is watched level-triggered
+    if (m_shardIndex == 0 && !m_eventLoop.add(m_stdinTCPSocket.getSockFd(), EPOLLIN, [this](uint32_t) { handleServerInput(); }, true)) {
+        Logger::warning("stdin can not be watched, server console disabled");
+    }
+
     m_running = true;
-    std::cout << "Server running on port " << m_port << std::endl;
+    if (m_shardIndex == 0) {
+        Logger::info("Server running on port ", m_port, " with ", m_group.getShardCount(), " reactor thread(s) using ",
+                     m_eventLoop.getBackend() == EventLoop::Backend::IO_URING ? "io_uring" : "epoll");
+    }
 
     while (m_running) {
-        handleNewConnections();
-        handleLogin();
-        handleApprovedConnections();
-        handleServerInput();
+        int presenceTimeoutMs = m_presence.getTimeoutMs();
+        int timerTimeoutMs = m_timers.getTimeoutMs();
+        m_eventLoop.poll(presenceTimeoutMs == -1 || timerTimeoutMs == -1 ? std::max(presenceTimeoutMs, timerTimeoutMs) : std::min(presenceTimeoutMs, timerTimeoutMs));
+        // Only the handling is measured, not the wait for events
+        ScopedLatency iteration(Histogram::LOOP_ITERATION_NS);
+        m_timers.expire(std::chrono::steady_clock::now(), [this](uint64_t payload) {
+            handleConnectionTimer(ConnectionHandle{static_cast<uint32_t>(payload >> 32), static_cast<uint32_t>(payload)});
+        });
+        if (m_presence.isDue()) {
+            flushPresence();
+        }
+        flushConnections();
+        closeScheduledConnections();
     }
+
+    // Give the shutdown alert a chance to reach the clients
+    m_connections.forEach(ConnectionSlab::State::APPROVED, [](ConnectionHandle, Connection& connection) { connection.flush(); });
 };
 
 void Server::handleNewConnections() {
-    if (m_listeningTCPSocket.dataAvailable()) {
-        TCPSocket socket = m_listeningTCPSocket.accept();
-        Connection connection = Connection(std::move(socket), UserData::empty());
-        std::cout << "New connection from: " << connection.getSocket().getRemoteAddr() << std::endl;
-        connection.getSocket().send(m_welcomeMsg);
-        m_newConnections.push_back(std::move(connection));
+    for (size_t acceptIdx = 0; acceptIdx < m_acceptBatchSize; acceptIdx++) {
+        TCPSocket socket = m_listeningTCPSocket.accept(true);
+        if (socket.isValid()) {
+            admitConnection(std::move(socket));
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK || !handleAcceptError(errno)) {
+            return;
+        }
     }
 }
 
-void Server::handleLogin() {
-    for (int connIdx = m_newConnections.size() - 1; connIdx >= 0; connIdx--) {
-        if (!m_newConnections[connIdx].dataAvailable()) {
-            continue;
-        }
+void Server::handleAcceptedConnection(int result) {
+    if (result < 0) {
+        handleAcceptError(-result);
+        return;
+    }
+    // Accepted sockets are already non-blocking
+    admitConnection(TCPSocket::adopt(result));
+}
 
-        std::string data = m_newConnections[connIdx].recv();
-        if (data.empty()) {
-            std::cout << "Connection closed by client: " << m_newConnections[connIdx].getRemoteAddr() << std::endl;
-            m_newConnections.erase(m_newConnections.begin() + connIdx);
-            continue;
+bool Server::handleAcceptError(int error) {
+    switch (error) {
+        case EMFILE:
+        case ENFILE: {
+            // Otherwise the connection stays pending and the listening socket reports it again and again
+            if (m_spareFd == -1) {
+                // Another thread may have taken the descriptor released last time
+                m_spareFd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+                if (m_spareFd == -1) {
+                    Logger::debug("Out of file descriptors, no spare descriptor to reject connections with");
+                    return false;
+                }
+            }
+            close(m_spareFd);
+            bool accepted = m_listeningTCPSocket.accept(true).isValid();
+            m_spareFd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+            if (!accepted) {
+                return false;
+            }
+            Metrics::count(Counter::REJECTED_CONNECTIONS);
+            Logger::warning("Out of file descriptors, rejected a connection");
+            return true;
         }
+        case ENOBUFS:
+        case ENOMEM:
+            Logger::warning("Out of memory, accepting connections is postponed");
+            return false;
+        default:
+            // e.g. ECONNABORTED for a connection reset while it was pending, the next one can be accepted
+            Logger::debug("accept failed, errno: ", error);
+            return true;
+    }
+}
 
-        std::istringstream dataStream(data);
-        std::string command;
-        std::getline(dataStream, command, ' ');
-        std::string name;
-        std::getline(dataStream, name, ' ');
-        std::string password;
-        std::getline(dataStream, password);
+void Server::admitConnection(TCPSocket&& socket) {
+    if (!m_admission.admit(socket.getRemoteAddr().getAddress())) {
+        Metrics::count(Counter::REJECTED_CONNECTIONS);
+        Logger::debug("Rejected connection from ", std::string(socket.getRemoteAddr()), ", too many connections from its address");
+        socket.sendSome(m_tooManyConnectionsMsg.data(), m_tooManyConnectionsMsg.size());
+        return;
+    }
+    addConnection(std::move(socket));
+}
 
-        if (command == "/register") {
-            std::cerr << "Client on " << m_newConnections[connIdx].getRemoteAddr() << " attempts to register, using credentials " << name << ":" << password << std::endl;
-            if (name.empty() || password.empty()) {
-                m_newConnections[connIdx].getSocket().send("Invalid name or password\n");
-                continue;
+void Server::addConnection(TCPSocket&& socket) {
+    Metrics::count(Counter::ACCEPTED_CONNECTIONS);
+    int fd = socket.getSockFd();
+    Connection connection = Connection(std::move(socket), UserData::empty(), m_receivePool, m_outboundLimits, m_maxLineLength);
+    Logger::info("New connection from: ", connection.getRemoteAddr());
+    connection.send(m_welcomeMsg);
+    bool completionInput = m_eventLoop.getBackend() == EventLoop::Backend::IO_URING;
+    connection.setCompletionInput(completionInput);
+    ConnectionHandle handle = m_connections.insert(std::move(connection));
+    if (m_loginTimeout.count() > 0) {
+        Connection& inserted = *m_connections.get(handle);
+        setConnectionTimer(handle, inserted, inserted.getLastInput() + m_loginTimeout);
+    }
+    if (completionInput) {
+        m_eventLoop.receive(fd, [this, handle](int result, std::string_view data) { handleReceivedData(handle, result, data); });
+        scheduleQueuedOutput(handle);
+    } else {
+        m_eventLoop.add(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP, [this, handle](uint32_t events) { handleConnectionEvent(handle, events); });
+    }
+}
+
+void Server::handleConnectionEvent(ConnectionHandle handle, uint32_t events) {
+    Connection* connection = m_connections.get(handle);
+    if (connection == nullptr) {
+        return;
+    }
+
+    if ((events & EPOLLOUT) && !connection->flush()) {
+        scheduleClose(handle);
+        return;
+    }
+    handleConnectionInput(handle, *connection);
+}
+
+void Server::handleConnectionInput(ConnectionHandle handle, Connection& connection) {
+    while (true) {
+        // Consume every complete line before receiving more, lines are views into the connection's receive buffer
+        std::string_view line;
+        LineFramer::Result result;
+        while (!connection.isClosing() && !connection.isPaused() && !connection.isAuthPending() && (result = connection.nextLine(line)) != LineFramer::Result::NEED_MORE_DATA) {
+            if (result == LineFramer::Result::LINE_TOO_LONG) {
+                connection.send("Message too long, the maximum is " + std::to_string(m_maxLineLength) + " characters\n");
+            } else if (connection.isBinary() && line.find('\n') != std::string_view::npos) {
+                // Stored and relayed to text clients as a single line
+                connection.send("Messages must not contain line breaks\n");
+            } else if (line == "/proto" || line.starts_with("/proto ")) {
+                handleProtocolCommand(connection, line.substr(std::min<size_t>(7, line.size())));
+            } else if (line == "/compress" || line.starts_with("/compress ")) {
+                handleCompressCommand(connection, line.substr(std::min<size_t>(10, line.size())));
+            } else if (m_connections.getState(handle.index) == ConnectionSlab::State::APPROVED) {
+                // Checked per line, a resumed session is approved without waiting for the AuthService
+                handleChatMessage(handle, connection, line);
+            } else {
+                handleLoginRequest(handle, connection, line);
             }
-            if (name.length() < m_miminumNameLength || name.length() > m_maximumNameLength) {
-                m_newConnections[connIdx].getSocket().send("Name must be between " + std::to_string(m_miminumNameLength) + " and " + std::to_string(m_maximumNameLength) + " characters\n");
-                continue;
+        }
+
+        if (connection.isClosing()) {
+            scheduleClose(handle);
+            return;
+        }
+        // A paused client is not read from until its outbound queue drained, a client waiting for its login until the result arrived
+        if (connection.isPaused() || connection.isAuthPending()) {
+            return;
+        }
+
+        switch (connection.readInput()) {
+            case Connection::ReadResult::DATA:
+                // Any input answers an outstanding ping
+                connection.setLastInput(std::chrono::steady_clock::now());
+                break;
+            case Connection::ReadResult::WOULD_BLOCK:
+                // Everything received meanwhile was handled, so receiving from the client can go on
+                if (connection.isReceivePaused()) {
+                    connection.setReceivePaused(false);
+                    m_eventLoop.resumeReceive(connection.getSocket().getSockFd());
+                }
+                return;
+            case Connection::ReadResult::CLOSED:
+                if (m_connections.getState(handle.index) != ConnectionSlab::State::APPROVED) {
+                    Logger::info("Connection closed by client: ", connection.getRemoteAddr());
+                }
+                closeConnection(handle);
+                return;
+        }
+    }
+}
+
+void Server::handleReceivedData(ConnectionHandle handle, int result, std::string_view data) {
+    Connection* connection = m_connections.get(handle);
+    if (connection == nullptr) {
+        return;
+    }
+    if (result > 0) {
+        connection->receive(data);
+    } else {
+        connection->closeInput();
+    }
+    handleConnectionInput(handle, *connection);
+    scheduleQueuedOutput(handle);
+
+    // Input is not handled while the client is paused or waits for its login, the kernel keeps the rest meanwhile
+    connection = m_connections.get(handle);
+    if (connection != nullptr && !connection->isReceivePaused() && connection->getReceivedBytes() > m_maxReceivedBytes) {
+        connection->setReceivePaused(true);
+        m_eventLoop.pauseReceive(connection->getSocket().getSockFd());
+    }
+}
+
+void Server::handleProtocolCommand(Connection& connection, std::string_view argument) {
+    if (argument == "bin") {
+        if (connection.isBinary()) {
+            connection.send("Already using binary frames\n");
+        }
+        connection.setBinary(true);
+    } else if (argument == "text") {
+        connection.setBinary(false);
+        connection.send("Switched to text lines\n");
+    } else {
+        connection.send("Usage: /proto <bin | text>\n");
+    }
+}
+
+void Server::handleCompressCommand(Connection& connection, std::string_view argument) {
+    if (argument != "on" && argument != "off") {
+        connection.send("Usage: /compress <on | off>\n");
+    } else if (!connection.isBinary()) {
+        connection.send("Compression requires binary frames, use '/proto bin' first\n");
+    } else if (argument == "on" && m_compressionThreshold == 0) {
+        connection.send("Compression is disabled on this server\n");
+    } else {
+        connection.setCompressionThreshold(argument == "on" ? m_compressionThreshold : 0);
+        connection.send(argument == "on" ? "Compression enabled\n" : "Compression disabled\n");
+    }
+}
+
+void Server::handleLoginRequest(ConnectionHandle handle, Connection& connection, std::string_view request) {
+    // '<command> <name> <password>', the password is the rest of the line
+    size_t commandEnd = std::min(request.find(' '), request.size());
+    std::string command{request.substr(0, commandEnd)};
+    request.remove_prefix(std::min(commandEnd + 1, request.size()));
+    if (command == "/resume") {
+        resumeSession(handle, connection, request);
+        return;
+    }
+    size_t nameEnd = std::min(request.find(' '), request.size());
+    std::string name{request.substr(0, nameEnd)};
+    request.remove_prefix(std::min(nameEnd + 1, request.size()));
+    std::string password{request};
+
+    AuthRequest authRequest;
+    if (command == "/register") {
+        if (name.empty() || password.empty()) {
+            connection.send("Invalid name or password\n");
+            return;
+        }
+        if (name.length() < m_miminumNameLength || name.length() > m_maximumNameLength) {
+            connection.send("Name must be between " + std::to_string(m_miminumNameLength) + " and " + std::to_string(m_maximumNameLength) + " characters\n");
+            return;
+        }
+        if (password.length() < m_minimumPasswordLength || password.length() > m_maximumPasswordLength) {
+            connection.send("Password must be between " + std::to_string(m_miminumNameLength) + " and " + std::to_string(m_maximumNameLength) + " characters\n");
+            return;
+        }
+        authRequest.type = AuthRequest::Type::REGISTER;
+
+    } else if (command == "/login") {
+        if (name.empty() || password.empty()) {
+            connection.send("Invalid name or password\n");
+            return;
+        }
+        if (name.length() < m_miminumNameLength || name.length() > m_maximumNameLength) {
+            connection.send("Name must be between " + std::to_string(m_miminumNameLength) + " and " + std::to_string(m_maximumNameLength) + " characters\n");
+            return;
+        }
+        if (password.length() < m_miminumNameLength || password.length() > m_maximumNameLength) {
+            connection.send("Password must be between " + std::to_string(m_miminumNameLength) + " and " + std::to_string(m_maximumNameLength) + " characters\n");
+            return;
+        }
+        authRequest.type = AuthRequest::Type::LOGIN;
+
+    } else {
+        connection.send("Invalid command\n");
+        return;
+    }
+
+    Logger::info("Client on ", connection.getRemoteAddr(), authRequest.type == AuthRequest::Type::REGISTER ? " attempts to register as " : " attempts to login as ", name);
+
+    // Hashing and database work run on the AuthService, so neither stalls the delivery to the logged in users
+    authRequest.name = std::move(name);
+    authRequest.password = std::move(password);
+    authRequest.connection = handle;
+    authRequest.remoteAddress = connection.getSocket().getRemoteAddr().getIp();
+    authRequest.completions = &m_authResults;
+    switch (m_group.getAuthService().submit(std::move(authRequest))) {
+        case AuthService::Admission::ACCEPTED:
+            connection.setAuthPending(true);
+            break;
+        case AuthService::Admission::QUEUE_FULL:
+            connection.send("Server busy, please try again later\n");
+            break;
+        case AuthService::Admission::ADDRESS_LIMIT:
+            connection.send("Too many login attempts from your address, please try again later\n");
+            break;
+    }
+}
+
+void Server::setConnectionTimer(ConnectionHandle handle, Connection& connection, std::chrono::steady_clock::time_point deadline) {
+    m_timers.cancel(connection.getTimer());
+    if (deadline == std::chrono::steady_clock::time_point{}) {
+        connection.setTimer(TimerHandle{});
+        return;
+    }
+    connection.setTimer(m_timers.schedule(deadline, (static_cast<uint64_t>(handle.index) << 32) | handle.generation));
+}
+
+void Server::scheduleKeepalive(ConnectionHandle handle, Connection& connection) {
+    std::chrono::steady_clock::time_point deadline{};
+    auto consider = [&deadline](std::chrono::steady_clock::time_point candidate) {
+        if (deadline == std::chrono::steady_clock::time_point{} || candidate < deadline) {
+            deadline = candidate;
+        }
+    };
+    if (m_idleTimeout.count() > 0) {
+        consider(connection.getLastActivity() + m_idleTimeout);
+    }
+    if (m_pingInterval.count() > 0) {
+        bool pingOutstanding = connection.getPingSent() != std::chrono::steady_clock::time_point{} && connection.getLastInput() < connection.getPingSent();
+        consider(pingOutstanding ? connection.getPingSent() + m_pingTimeout : connection.getLastInput() + m_pingInterval);
+    }
+    setConnectionTimer(handle, connection, deadline);
+}
+
+void Server::handleConnectionTimer(ConnectionHandle handle) {
+    Connection* connection = m_connections.get(handle);
+    if (connection == nullptr) {
+        return;
+    }
+    // The timer fired, so its handle is stale
+    connection->setTimer(TimerHandle{});
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    if (m_connections.getState(handle.index) == ConnectionSlab::State::NEW) {
+        // The AuthService is busy, the client did its part in time
+        if (connection->isAuthPending()) {
+            setConnectionTimer(handle, *connection, now + m_loginTimeout);
+            return;
+        }
+        Metrics::count(Counter::TIMED_OUT_CONNECTIONS);
+        Logger::info("Closing connection of ", connection->getRemoteAddr(), ", it did not log in within ", m_loginTimeout.count(), " seconds");
+        connection->send("Login timed out\n");
+        closeConnection(handle);
+        return;
+    }
+
+    if (m_idleTimeout.count() > 0 && now >= connection->getLastActivity() + m_idleTimeout) {
+        Metrics::count(Counter::TIMED_OUT_CONNECTIONS);
+        Logger::info("Closing connection of ", connection->getClientData().getName(), ", it was idle for ", m_idleTimeout.count(), " seconds");
+        connection->send("Disconnected after being idle for " + std::to_string(m_idleTimeout.count()) + " seconds\n");
+        closeConnection(handle);
+        return;
+    }
+
+    if (m_pingInterval.count() > 0 && connection->isPaused()) {
+        // A paused client is not read from, so its answer could not arrive, it counts as alive until it is resumed
+        connection->setLastInput(now);
+    } else if (m_pingInterval.count() > 0) {
+        bool pingOutstanding = connection->getPingSent() != std::chrono::steady_clock::time_point{} && connection->getLastInput() < connection->getPingSent();
+        if (pingOutstanding && now >= connection->getPingSent() + m_pingTimeout) {
+            // Most likely nobody receives it anymore, so no message is sent
+            Metrics::count(Counter::TIMED_OUT_CONNECTIONS);
+            Logger::info("Closing connection of ", connection->getClientData().getName(), ", it did not answer a ping within ", m_pingTimeout.count(), " seconds");
+            closeConnection(handle);
+            return;
+        }
+        if (!pingOutstanding && now >= connection->getLastInput() + m_pingInterval) {
+            connection->setPingSent(now);
+            connection->sendPing();
+            scheduleQueuedOutput(handle);
+            if (connection->isClosing()) {
+                scheduleClose(handle);
+                return;
             }
-            if (m_userDatabase.findByName(name).getName() == name) {
-                m_newConnections[connIdx].getSocket().send("Name already taken\n");
-                continue;
+        }
+    }
+    scheduleKeepalive(handle, *connection);
+}
+
+void Server::handleAuthResults() {
+    m_authResults.drain([this](AuthResult result) { handleAuthResult(result); });
+}
+
+void Server::handleAuthResult(const AuthResult& result) {
+    // The connection might have been closed while the request was handled, its slot even reused
+    Connection* connection = m_connections.get(result.connection);
+    if (connection == nullptr || m_connections.getState(result.connection.index) != ConnectionSlab::State::NEW) {
+        return;
+    }
+    connection->setAuthPending(false);
+
+    switch (result.status) {
+        case AuthResult::Status::REGISTERED:
+            Metrics::count(Counter::REGISTRATIONS);
+            break;
+        case AuthResult::Status::NAME_TAKEN:
+            connection->send("Name already taken\n");
+            break;
+        case AuthResult::Status::INVALID_CREDENTIALS:
+            Metrics::count(Counter::FAILED_LOGINS);
+            connection->send("Invalid name or password\n");
+            break;
+        case AuthResult::Status::FAILED:
+            Metrics::count(Counter::FAILED_LOGINS);
+            connection->send("Request failed, please try again\n");
+            break;
+        case AuthResult::Status::LOGGED_IN:
+            Metrics::count(Counter::LOGINS);
+            // The connection stays in its slot, approving it only changes its state
+            connection->setClientData(result.userData);
+            m_connections.setState(result.connection.index, ConnectionSlab::State::APPROVED);
+            connection->setLastActivity(std::chrono::steady_clock::now());
+            scheduleKeepalive(result.connection, *connection);
+            enterRoom(result.connection, m_defaultRoom);
+            m_group.getUserDirectory().add(result.userData.getId(), result.userData.getName(), UserLocation{m_shardIndex, result.connection});
+            // The others learn about the login with the next presence summary, the client right away
+            connection->sendNotice("Logged in as " + result.userData.getName(), TextColor::SERVER_NOTIFICATION);
+            m_presence.joined(result.userData.getName());
+            if (m_sessionsEnabled) {
+                connection->setSessionToken(m_group.getSessionTable().create(result.userData, UserLocation{m_shardIndex, result.connection}));
+                connection->sendNotice("Session token: " + connection->getSessionToken() + ", use '/resume " + connection->getSessionToken() + "' to continue after reconnecting", TextColor::SERVER_NOTIFICATION);
             }
-            if (password.length() < m_minimumPasswordLength || password.length() > m_maximumPasswordLength) {
-                m_newConnections[connIdx].getSocket().send("Password must be between " + std::to_string(m_miminumNameLength) + " and " + std::to_string(m_maximumNameLength) + " characters\n");
-                continue;
+            sendHistory(*connection, m_defaultRoom, m_group.getMessageLog().findLast(m_defaultRoom, m_historyReplay));
+            break;
+    }
+
+    // Lines received after the request were left in the receive buffer
+    handleConnectionInput(result.connection, *connection);
+    scheduleQueuedOutput(result.connection);
+}
+
+void Server::resumeSession(ConnectionHandle handle, Connection& connection, std::string_view arguments) {
+    size_t tokenEnd = std::min(arguments.find(' '), arguments.size());
+    std::string_view token = arguments.substr(0, tokenEnd);
+    std::string_view lastSeen = arguments.substr(std::min(tokenEnd + 1, arguments.size()));
+    uint64_t lastSeenId = 0;
+    if (token.empty() || (!lastSeen.empty() && std::from_chars(lastSeen.data(), lastSeen.data() + lastSeen.size(), lastSeenId).ec != std::errc())) {
+        connection.send("Usage: /resume <token> [last_seen_id]\n");
+        return;
+    }
+
+    UserLocation location{m_shardIndex, handle};
+    std::optional<SessionTable::Resumed> resumed = m_group.getSessionTable().resume(token, location);
+    if (!resumed) {
+        connection.send("Invalid or expired session, please login again\n");
+        return;
+    }
+    // A connection that broke without being noticed yet might still hold the session
+    if (resumed->previousOwner) {
+        if (resumed->previousOwner->shard == m_shardIndex) {
+            closeResumedConnection(resumed->previousOwner->connection);
+        } else {
+            m_group.post(resumed->previousOwner->shard, ShardEvent::closeResumed(resumed->previousOwner->connection));
+        }
+    }
+
+    Metrics::count(Counter::RESUMED_SESSIONS);
+    // The user never left from the others' point of view, so nobody is notified
+    const UserData& user = resumed->user;
+    std::string room = resumed->room.empty() ? m_defaultRoom : resumed->room;
+    connection.setClientData(user);
+    connection.setSessionToken(std::string(token));
+    m_connections.setState(handle.index, ConnectionSlab::State::APPROVED);
+    connection.setLastActivity(std::chrono::steady_clock::now());
+    scheduleKeepalive(handle, connection);
+    enterRoom(handle, room);
+    m_group.getUserDirectory().add(user.getId(), user.getName(), location);
+    Logger::info(user.getName(), " resumed a session on ", connection.getRemoteAddr());
+
+    connection.sendNotice("Session resumed in room " + room, TextColor::SERVER_NOTIFICATION);
+    // An id sent by the client is more precise than the position recorded when the session was detached. Ids the
+    // history of the room has not reached are no history ids (e.g. the ids of CHAT frames), they would replay nothing.
+    std::optional<uint64_t> missedFrom = resumed->missedFrom;
+    if (!lastSeen.empty()) {
+        uint64_t nextId = m_group.getMessageLog().getNextId(room);
+        if (lastSeenId < nextId) {
+            missedFrom = lastSeenId + 1;
+        } else {
+            connection.send("Message id " + std::string(lastSeen) + " is not in the history of room " + room + ", which ends before id " + std::to_string(nextId) + "\n");
+        }
+    }
+    if (missedFrom) {
+        sendHistory(connection, room, m_group.getMessageLog().findFrom(room, *missedFrom, m_maximumHistoryCount));
+    }
+}
+
+void Server::closeResumedConnection(ConnectionHandle handle) {
+    Connection* connection = m_connections.get(handle);
+    if (connection == nullptr) {
+        return;
+    }
+    Logger::info("Closing connection of ", connection->getClientData().getName(), ", its session was resumed by another connection");
+    // The session belongs to the new connection already, so closing this one notifies nobody
+    closeConnection(handle);
+}
+
+void Server::expireSessions() {
+    m_sessionTimer->acknowledge();
+    for (const UserData& user : m_group.getSessionTable().expire()) {
+        // The user might have logged in again instead of resuming
+        if (!m_group.getUserDirectory().findById(user.getId())) {
+            m_presence.left(user.getName());
+        }
+    }
+}
+
+void Server::handleChatMessage(ConnectionHandle handle, Connection& connection, std::string_view message) {
+    if (message.empty()) {
+        return;
+    }
+    if (message != "/pong") {
+        connection.setLastActivity(connection.getLastInput());
+    }
+    if (message.front() == '/') {
+        handleUserCommand(handle, connection, message);
+        return;
+    }
+
+    Metrics::count(Counter::MESSAGES_RECEIVED);
+    std::string_view room = m_rooms.getRoom(handle.index);
+    MessageRef sharedRoom = m_rooms.getSharedName(room);
+    WireMessage chat = WireMessage::chat(sharedRoom, connection.getSenderPrefix(), connection.getClientData().getId(), message, m_nextMessageId());
+    sendToRoom(room, chat, handle);
+    // Only queued for the writer thread, the fan-out never waits for the disk. The log keeps the text form.
+    m_group.getMessageLog().append(sharedRoom, chat.text());
+
+    // Message contents are only logged for debugging
+    Logger::debug('[', room, "] ", connection.getClientData().getName(), ": ", message);
+}
+
+void Server::handleUserCommand(ConnectionHandle handle, Connection& connection, std::string_view command) {
+    // '<command> <argument>'
+    size_t commandEnd = std::min(command.find(' '), command.size());
+    std::string_view argument = command.substr(std::min(commandEnd + 1, command.size()));
+    command = command.substr(0, commandEnd);
+
+    if (command == "/join") {
+        if (argument.empty()) {
+            connection.send("Usage: /join <room>\n");
+            return;
+        }
+        changeRoom(handle, connection, argument);
+
+    } else if (command == "/leave") {
+        if (m_rooms.getRoom(handle.index) == m_defaultRoom) {
+            connection.send("You are in the " + m_defaultRoom + " already, use /join <room> to enter another room\n");
+            return;
+        }
+        changeRoom(handle, connection, m_defaultRoom);
+
+    } else if (command == "/msg") {
+        size_t recipientEnd = std::min(argument.find(' '), argument.size());
+        std::string_view recipient = argument.substr(0, recipientEnd);
+        std::string_view text = argument.substr(std::min(recipientEnd + 1, argument.size()));
+        if (recipient.empty() || text.empty()) {
+            connection.send("Usage: /msg <user> <text>\n");
+            return;
+        }
+        sendDirectMessage(connection, recipient, text);
+
+    } else if (command == "/rooms") {
+        std::string_view current = m_rooms.getRoom(handle.index);
+        std::string reply = "Rooms:\n";
+        for (const auto& [room, members] : m_group.getRoomDirectory().list()) {
+            reply += "  " + room + " - " + std::to_string(members) + " member(s)" + (room == current ? " (you are here)\n" : "\n");
+        }
+        connection.send(reply);
+
+    } else if (command == "/history") {
+        handleHistoryCommand(handle, connection, argument);
+
+    } else if (command == "/help") {
+        connection.send(m_userHelpMsg);
+
+    } else if (command == "/pong") {
+        // Answer to a keepalive ping, receiving it was all that counted
+
+    } else {
+        connection.send("Invalid command, use /help to list the available commands\n");
+    }
+}
+
+void Server::changeRoom(ConnectionHandle handle, Connection& connection, std::string_view room) {
+    if (!m_isValidRoomName(room)) {
+        connection.send("Room names consist of 1 to " + std::to_string(m_maximumRoomNameLength) + " letters, digits, '-' or '_'\n");
+        return;
+    }
+    if (m_rooms.getRoom(handle.index) == room) {
+        connection.send("You are in room " + std::string(room) + " already\n");
+        return;
+    }
+
+    const std::string& name = connection.getClientData().getName();
+    std::string previous = enterRoom(handle, room);
+    if (!connection.getSessionToken().empty()) {
+        m_group.getSessionTable().setRoom(connection.getSessionToken(), room);
+    }
+    if (!previous.empty()) {
+        sendRoomNotification(previous, name + " left the room", ConnectionHandle{});
+    }
+    sendRoomNotification(room, name + " joined the room", handle);
+    connection.sendNotice("You are now in room " + std::string(room), TextColor::SERVER_NOTIFICATION);
+    sendHistory(connection, room, m_group.getMessageLog().findLast(room, m_historyReplay));
+    Logger::info(name, " moved from room ", previous, " to ", room);
+}
+
+void Server::handleHistoryCommand(ConnectionHandle handle, Connection& connection, std::string_view argument) {
+    // '<count>' or '<minutes>m'
+    bool minutes = !argument.empty() && argument.back() == 'm';
+    std::string_view number = minutes ? argument.substr(0, argument.size() - 1) : argument;
+    size_t value = m_defaultHistoryCount;
+    auto [end, error] = std::from_chars(number.data(), number.data() + number.size(), value);
+    if (!argument.empty() && (error != std::errc() || end != number.data() + number.size() || value == 0)) {
+        connection.send("Usage: /history [count | <minutes>m], at most " + std::to_string(m_maximumHistoryCount) + " messages are shown\n");
+        return;
+    }
+
+    std::string_view room = m_rooms.getRoom(handle.index);
+    MessageLog& messageLog = m_group.getMessageLog();
+    std::vector<MessageLog::Range> ranges;
+    if (minutes) {
+        auto since = std::chrono::system_clock::now() - std::chrono::minutes(std::min(value, m_maximumHistoryMinutes));
+        ranges = messageLog.findSince(room, since, m_maximumHistoryCount);
+    } else {
+        ranges = messageLog.findLast(room, std::min(value, m_maximumHistoryCount));
+    }
+    if (ranges.empty()) {
+        connection.sendNotice("No messages in room " + std::string(room) + " yet", TextColor::SERVER_NOTIFICATION);
+        return;
+    }
+    sendHistory(connection, room, ranges);
+}
+
+void Server::sendHistory(Connection& connection, std::string_view room, const std::vector<MessageLog::Range>& ranges) {
+    if (ranges.empty()) {
+        return;
+    }
+    connection.sendNotice("Recent messages in room " + std::string(room) + ":", TextColor::SERVER_NOTIFICATION);
+    if (connection.isBinary()) {
+        // The log stores '<name>: <text>' lines, their times are not known here. The message id is the history id
+        // of the room, which '/resume' accepts as last seen id.
+        FrameHeader header;
+        header.type = FrameType::HISTORY;
+        std::string frames;
+        for (const MessageLog::Range& range : ranges) {
+            std::string_view stored = range.segment->view(range.offset, range.length);
+            header.messageId = range.firstId;
+            for (; !stored.empty(); header.messageId++) {
+                size_t lineEnd = std::min(stored.find('\n'), stored.size());
+                std::string_view line = stored.substr(0, lineEnd);
+                stored.remove_prefix(std::min(lineEnd + 1, stored.size()));
+                size_t separator = line.find(": ");
+                std::string_view sender = separator != std::string_view::npos ? line.substr(0, separator) : std::string_view();
+                appendFrame(frames, header, room, sender, separator != std::string_view::npos ? line.substr(separator + 2) : line);
             }
+        }
+        // A replay is sent as a single batch, which compresses far better than its messages one by one
+        connection.sendFrames(frames);
+        return;
+    }
+    // The bytes in the log are exactly what clients receive, so they go from the page cache to the socket unchanged
+    for (const MessageLog::Range& range : ranges) {
+        if (!connection.sendFile(range.segment->getFd(), range.offset, range.segment->view(range.offset, range.length))) {
+            return;
+        }
+    }
+}
+
+void Server::sendDirectMessage(Connection& connection, std::string_view recipient, std::string_view text) {
+    std::optional<UserLocation> location = m_group.getUserDirectory().findByName(recipient);
+    if (!location) {
+        connection.send("User " + std::string(recipient) + " is not online\n");
+        return;
+    }
+
+    WireMessage direct = WireMessage::direct(connection.getSenderPrefix(), connection.getClientData().getId(), text, m_nextMessageId());
+    if (location->shard == m_shardIndex) {
+        deliverDirect(location->connection, direct);
+    } else {
+        m_group.post(location->shard, ShardEvent::directMessage(location->connection, direct));
+    }
+    Logger::debug(connection.getClientData().getName(), " sent a private message to ", recipient);
+}
+
+void Server::deliverDirect(ConnectionHandle handle, WireMessage& message) {
+    Connection* connection = m_connections.get(handle);
+    if (connection != nullptr) {
+        deliver(handle, *connection, message);
+    }
+}
+
+std::string Server::enterRoom(ConnectionHandle handle, std::string_view room) {
+    RoomDirectory& directory = m_group.getRoomDirectory();
+    std::string previous = m_rooms.join(handle.index, room);
+    if (!previous.empty()) {
+        directory.exit(previous);
+    }
+    directory.enter(room);
+    return previous;
+}
+
+std::string Server::exitRoom(ConnectionHandle handle) {
+    std::string room = m_rooms.leave(handle.index);
+    if (!room.empty()) {
+        m_group.getRoomDirectory().exit(room);
+    }
+    return room;
+}
+
+void Server::post(ShardEvent event) {
+    m_inbox.post(std::move(event));
+}
 
-            m_userDatabase.insert(UserData(m_nextClientId++, name, password));
+void Server::handleShardEvents() {
+    m_inbox.drain([this](ShardEvent event) {
+        switch (event.type) {
+            case ShardEvent::Type::BROADCAST:
+                deliverLocal(event.message, ConnectionHandle{});
+                break;
+            case ShardEvent::Type::ROOM_MESSAGE:
+                deliverToRoom(event.room.view(), event.message, ConnectionHandle{});
+                break;
+            case ShardEvent::Type::DIRECT_MESSAGE:
+                deliverDirect(event.target, event.message);
+                break;
+            case ShardEvent::Type::CLOSE_RESUMED:
+                closeResumedConnection(event.target);
+                break;
+            case ShardEvent::Type::STOP:
+                m_running = false;
+                break;
+        }
+    });
+}
+
+void Server::broadcast(WireMessage& message, ConnectionHandle exclude) {
+    deliverLocal(message, exclude);
+    if (m_group.getShardCount() > 1) {
+        m_group.forward(m_shardIndex, ShardEvent::broadcast(message));
+    }
+}
 
-        } else if (command == "/login") {
-            std::cerr << "Client on " << m_newConnections[connIdx].getRemoteAddr() << " attempts to login, using credentials " << name << ":" << password << std::endl;
-            if (name.empty() || password.empty()) {
-                m_newConnections[connIdx].getSocket().send("Invalid name or password\n");
+void Server::deliverLocal(WireMessage& message, ConnectionHandle exclude) {
+    m_connections.forEach(ConnectionSlab::State::APPROVED, [&](ConnectionHandle handle, Connection& connection) {
+        if (handle != exclude) {
+            deliver(handle, connection, message);
+        }
+    });
+}
+
+void Server::sendToRoom(std::string_view room, WireMessage& message, ConnectionHandle exclude) {
+    deliverToRoom(room, message, exclude);
+    if (m_group.getShardCount() > 1) {
+        m_group.forward(m_shardIndex, ShardEvent::roomMessage(m_rooms.getSharedName(room), message));
+    }
+}
+
+void Server::deliverToRoom(std::string_view room, WireMessage& message, ConnectionHandle exclude) {
+    // Members leave their room before their slot is freed, so every index refers to a live connection
+    for (uint32_t index : m_rooms.getMembers(room)) {
+        if (index != exclude.index) {
+            deliver(m_connections.getHandle(index), m_connections.at(index), message);
+        }
+    }
+}
+
+void Server::deliver(ConnectionHandle handle, Connection& connection, WireMessage& message) {
+    Metrics::count(Counter::MESSAGES_DELIVERED);
+    std::span<const MessageRef> segments = message.text();
+    if (connection.getCompressionThreshold() > 0) {
+        // Compressed once per message, the fan-out only shares the result
+        segments = message.compressed(connection.getCompressionThreshold());
+        Metrics::count(Counter::COMPRESSION_SAVED_BYTES, message.getCompressionSavings());
+    } else if (connection.isBinary()) {
+        segments = message.binary();
+    }
+    if (!connection.post(segments)) {
+        scheduleClose(handle);
+        return;
+    }
+    if (!connection.isFlushScheduled()) {
+        connection.setFlushScheduled(true);
+        m_flushConnections.push_back(handle);
+    }
+}
+
+void Server::flushConnections() {
+    if (m_eventLoop.getBackend() == EventLoop::Backend::IO_URING) {
+        flushConnectionsBatched();
+        return;
+    }
+    // Handling the input of a resumed client might deliver further messages, which are appended and flushed as well
+    for (size_t connectionIdx = 0; connectionIdx < m_flushConnections.size(); connectionIdx++) {
+        ConnectionHandle handle = m_flushConnections[connectionIdx];
+        Connection* connection = m_connections.get(handle);
+        if (connection == nullptr) {
+            continue;
+        }
+        connection->setFlushScheduled(false);
+        bool paused = connection->isPaused();
+        if (!connection->flush()) {
+            scheduleClose(handle);
+            continue;
+        }
+        Metrics::record(Histogram::OUTBOUND_QUEUE_BYTES, connection->getQueuedBytes());
+        // Input that arrived while the client was paused is not reported again by the edge-triggered event loop
+        if (paused && !connection->isPaused()) {
+            handleConnectionInput(handle, *connection);
+        }
+    }
+    m_flushConnections.clear();
+}
+
+void Server::flushConnectionsBatched() {
+    // Handling the input of an unpaused client might deliver further messages, they are written by another batch
+    size_t batchStart = 0;
+    while (batchStart < m_flushConnections.size()) {
+        size_t batchEnd = m_flushConnections.size();
+        m_sends.clear();
+        m_sendHandles.clear();
+        // Not resized while the batch is gathered, the messages point into it
+        m_sendSegments.resize((batchEnd - batchStart) * m_maxSegmentsPerSend);
+        for (size_t connectionIdx = batchStart; connectionIdx < batchEnd; connectionIdx++) {
+            ConnectionHandle handle = m_flushConnections[connectionIdx];
+            Connection* connection = m_connections.get(handle);
+            if (connection == nullptr) {
                 continue;
             }
-            if (name.length() < m_miminumNameLength || name.length() > m_maximumNameLength) {
-                m_newConnections[connIdx].getSocket().send("Name must be between " + std::to_string(m_miminumNameLength) + " and " + std::to_string(m_maximumNameLength) + " characters\n");
+            connection->setFlushScheduled(false);
+            // Written once the socket became writable again
+            if (connection->isWriteWatched()) {
                 continue;
             }
-            if (password.length() < m_miminumNameLength || password.length() > m_maximumNameLength) {
-                m_newConnections[connIdx].getSocket().send("Password must be between " + std::to_string(m_miminumNameLength) + " and " + std::to_string(m_maximumNameLength) + " characters\n");
+            iovec* segments = &m_sendSegments[m_sends.size() * m_maxSegmentsPerSend];
+            size_t segmentCount = connection->gatherOutput(segments, m_maxSegmentsPerSend);
+            if (segmentCount == 0) {
                 continue;
             }
+            msghdr message{};
+            message.msg_iov = segments;
+            message.msg_iovlen = segmentCount;
+            m_sends.push_back(EventLoop::Send{connection->getSocket().getSockFd(), message, 0});
+            m_sendHandles.push_back(handle);
+        }
+        batchStart = batchEnd;
+        if (m_sends.empty()) {
+            continue;
+        }
 
-            UserData userData = m_userDatabase.findByName(name);
-            if (userData == UserData::empty() || userData.getPassword() != password) {
-                m_newConnections[connIdx].getSocket().send("Invalid name or password\n");
+        m_eventLoop.send(m_sends);
+        for (size_t sendIdx = 0; sendIdx < m_sends.size(); sendIdx++) {
+            ConnectionHandle handle = m_sendHandles[sendIdx];
+            Connection* connection = m_connections.get(handle);
+            if (connection == nullptr) {
                 continue;
             }
+            bool paused = connection->isPaused();
+            if (!connection->completeOutput(m_sends[sendIdx].result)) {
+                scheduleClose(handle);
+                continue;
+            }
+            Metrics::record(Histogram::OUTBOUND_QUEUE_BYTES, connection->getQueuedBytes());
+            if (connection->getQueuedBytes() > 0) {
+                // The socket is full or more segments are queued than one send takes, either way it is flushed again once writable
+                connection->setWriteWatched(true);
+                m_eventLoop.watchWritable(connection->getSocket().getSockFd(), [this, handle](uint32_t) {
+                    Connection* connection = m_connections.get(handle);
+                    if (connection == nullptr) {
+                        return;
+                    }
+                    connection->setWriteWatched(false);
+                    if (!connection->isFlushScheduled()) {
+                        connection->setFlushScheduled(true);
+                        m_flushConnections.push_back(handle);
+                    }
+                });
+            }
+            if (paused && !connection->isPaused()) {
+                handleConnectionInput(handle, *connection);
+                scheduleQueuedOutput(handle);
+            }
+        }
+    }
+    m_flushConnections.clear();
+}
+
+void Server::scheduleQueuedOutput(ConnectionHandle handle) {
+    if (m_eventLoop.getBackend() != EventLoop::Backend::IO_URING) {
+        return;
+    }
+    Connection* connection = m_connections.get(handle);
+    if (connection != nullptr && connection->getQueuedBytes() > 0 && !connection->isFlushScheduled() && !connection->isWriteWatched()) {
+        connection->setFlushScheduled(true);
+        m_flushConnections.push_back(handle);
+    }
+}
 
-            m_newConnections[connIdx].setClientData(userData);
-            m_approvedConnections.push_back(std::move(m_newConnections[connIdx]));
-            m_newConnections.erase(m_newConnections.begin() + connIdx);
-            sendServerNotification(userData.getName() + " joined the server");
+void Server::flushPresence() {
+    for (const std::string& summary : m_presence.take()) {
+        sendServerNotification(summary);
+    }
+}
+
+void Server::sendRoomNotification(std::string_view room, const std::string& message, ConnectionHandle exclude) {
+    WireMessage notice = WireMessage::notice(m_rooms.getSharedName(room), message, TextColor::SERVER_NOTIFICATION);
+    sendToRoom(room, notice, exclude);
+}
+
+void Server::scheduleClose(ConnectionHandle handle) {
+    m_closingConnections.push_back(handle);
+}
+
+void Server::closeScheduledConnections() {
+    // Handling a close never delivers anything right away, the logout is announced by the PresenceAggregator
+    while (!m_closingConnections.empty()) {
+        ConnectionHandle handle = m_closingConnections.back();
+        m_closingConnections.pop_back();
+
+        // A connection might be scheduled more than once
+        Connection* connection = m_connections.get(handle);
+        if (connection == nullptr) {
             continue;
-        } else {
-            m_newConnections[connIdx].getSocket().send("Invalid command\n");
+        }
+        if (m_connections.getState(handle.index) == ConnectionSlab::State::NEW) {
+            Logger::info("Closing connection: ", connection->getRemoteAddr());
+            closeConnection(handle);
             continue;
         }
+        Logger::info("Closing connection of ", connection->getClientData().getName(), " (failed or too slow), ", connection->getDroppedMessages(), " message(s) dropped");
+        closeConnection(handle);
     }
 }
 
-void Server::handleApprovedConnections() {
-    for (int connIdx = m_approvedConnections.size() - 1; connIdx >= 0; connIdx--) {
-        if (m_approvedConnections[connIdx].dataAvailable()) {
-            std::string message = m_approvedConnections[connIdx].recv();
-            if (message.empty()) {
-                sendServerNotification(m_approvedConnections[connIdx].getClientData().getName() + " left the server");
-                m_approvedConnections.erase(m_approvedConnections.begin() + connIdx);
-                continue;
-            }
-            if (message.back() != '\n') {
-                message += '\n';
-            }
-
-            for (int connIdx2 = m_approvedConnections.size() - 1; connIdx2 >= 0; connIdx2--) {
-                if (connIdx == connIdx2) {
-                    continue;
-                }
-                m_approvedConnections[connIdx2].send(m_approvedConnections[connIdx].getClientData().getName() + ": " + message);
-            }
+void Server::closeConnection(ConnectionHandle handle) {
+    Connection* connection = m_connections.get(handle);
+    if (connection == nullptr) {
+        return;
+    }
+    Metrics::count(Counter::CLOSED_CONNECTIONS);
+    m_eventLoop.remove(m_connections.getFd(handle.index));
+    m_timers.cancel(connection->getTimer());
+    if (m_connections.getState(handle.index) != ConnectionSlab::State::APPROVED) {
+        m_connections.remove(handle);
+        return;
+    }
 
-            std::cout << m_approvedConnections[connIdx].getClientData().getName() << ": " << message;
-        }
+    UserLocation location{m_shardIndex, handle};
+    std::string name = connection->getClientData().getName();
+    m_group.getUserDirectory().remove(connection->getClientData().getId(), location);
+    std::string room = exitRoom(handle);
+    // A kept session lets the client resume later, the others only learn that the user left once it expired
+    bool sessionKept = !connection->getSessionToken().empty() && m_group.getSessionTable().detach(connection->getSessionToken(), location, room, m_group.getMessageLog().getNextId(room));
+    m_connections.remove(handle);
+    if (!sessionKept) {
+        m_presence.left(name);
     }
 }
 
 void Server::handleServerInput() {
-    if (m_stdinTCPSocket.dataAvailable()) {
-        std::string input{};
-        std::getline(std::cin, input);
+    char buffer[1024];
+    int bytesRead = ::read(m_stdinTCPSocket.getSockFd(), buffer, sizeof(buffer));
+    if (bytesRead <= 0) {
+        // Console closed (e.g. stdin redirected from a file), keep serving the clients
+        m_eventLoop.remove(m_stdinTCPSocket.getSockFd());
+        return;
+    }
+    m_consoleBuffer.append(buffer, bytesRead);
 
-        if (input.front() == '/') {
-            handleServerCommand(input.substr(1));
-            return;
-        } else {
-            sendServerMessage(input);
-        }
+    size_t lineEnd;
+    while (m_running && (lineEnd = m_consoleBuffer.find('\n')) != std::string::npos) {
+        std::string input = m_consoleBuffer.substr(0, lineEnd);
+        m_consoleBuffer.erase(0, lineEnd + 1);
+        handleServerInputLine(input);
+    }
+}
+
+void Server::handleServerInputLine(const std::string& input) {
+    if (input.empty()) {
+        return;
+    }
+    if (input.front() == '/') {
+        handleServerCommand(input.substr(1));
+    } else {
+        sendServerMessage(input);
     }
 }
 
@@ -186,37 +1115,39 @@ void Server::handleServerCommand(const std::string& command) {
             std::cout << ">>> Invalid command" << std::endl;
             break;
         case ServerCommand::STOP:
-            sendServerAlert(">>> Server shutdown");
+            sendServerAlert("Server shutdown");
+            m_group.stop(m_shardIndex);
             m_running = false;
             break;
         case ServerCommand::HELP:
             std::cout << m_consoleHelpMsg << std::endl;
+            break;
+        case ServerCommand::STATS:
+            std::cout << m_group.getMetrics().formatText() << std::flush;
+            break;
         default:
             break;
     }
 }
 
 void Server::sendGlobalMessage(const std::string& message, TextColor color) {
-    std::string formattedMessage = m_colorizeText(message, color);
-    if (message.back() != '\n') {
-        formattedMessage += '\n';
-    }
-    for (auto& conn : m_approvedConnections) {
-        if (!conn.send(formattedMessage)) {
-            std::cout << "Failed to send message to client: " << conn.getRemoteAddr() << std::endl;
-        }
+    std::string_view text = message;
+    if (!text.empty() && text.back() == '\n') {
+        text.remove_suffix(1);
     }
+    WireMessage notice = WireMessage::notice(MessageRef(), text, color);
+    broadcast(notice, ConnectionHandle{});
 }
 
 void Server::sendServerMessage(const std::string& message) {
-    sendGlobalMessage("Server: " + message, TextColor::SERVER_MESSAGE);
+    sendGlobalMessage(message, TextColor::SERVER_MESSAGE);
 }
 
 void Server::sendServerNotification(const std::string& message) {
-    std::cout << m_colorizeText(message, TextColor::SERVER_NOTIFICATION) << std::endl;
-    sendGlobalMessage(">>> " + message, TextColor::SERVER_NOTIFICATION);
+    Logger::info(message);
+    sendGlobalMessage(message, TextColor::SERVER_NOTIFICATION);
 }
 
 void Server::sendServerAlert(const std::string& message) {
-    sendGlobalMessage(">>> " + message, TextColor::SERVER_ALERT);
+    sendGlobalMessage(message, TextColor::SERVER_ALERT);
 }
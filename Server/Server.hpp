@@ -1,70 +1,179 @@
 #pragma once
 
-#include <filesystem>
+#include <memory>
+#include <span>
+#include <string_view>
 #include <vector>
 
+#include "../Database/MessageLog.hpp"
 #include "../Database/UserData.hpp"
-#include "../Database/UserDatabase.hpp"
+#include "../Networking/BufferPool.hpp"
+#include "../Networking/EventLoop.hpp"
+#include "../Networking/IntervalTimer.hpp"
+#include "../Networking/Mailbox.hpp"
 #include "../Networking/TCPSocket.hpp"
+#include "../Networking/TimerWheel.hpp"
+#include "AuthRequest.hpp"
 #include "Connection.hpp"
+#include "ConnectionAdmission.hpp"
+#include "ConnectionSlab.hpp"
+#include "PresenceAggregator.hpp"
+#include "RoomRegistry.hpp"
+#include "ServerConfig.hpp"
+#include "ShardEvent.hpp"
+#include "TextColor.hpp"
+#include "WireMessage.hpp"
+
+class ServerGroup;
 
 class Server {
     enum class ServerCommand {
         INVALID,
         STOP,
-        HELP
-    };
-
-    enum class TextColor {
-        SERVER_MESSAGE,
-        SERVER_NOTIFICATION,
-        SERVER_ALERT
+        HELP,
+        STATS
     };
 
    private:
     bool m_running;
     uint16_t m_port;
+    ServerGroup& m_group;
+    unsigned int m_shardIndex;
     TCPSocket m_listeningTCPSocket;
+    int m_listenBacklog;
     TCPSocket m_stdinTCPSocket;
+    EventLoop m_eventLoop;
+    Mailbox<ShardEvent> m_inbox;
+    std::string m_consoleBuffer;
+
+    // Results of the logins and registrations this shard submitted to the AuthService
+    Mailbox<AuthResult> m_authResults;
+
+    OutboundLimits m_outboundLimits;
+    size_t m_maxLineLength;
+    size_t m_compressionThreshold;
+
+    // Per-address rate limit of new connections
+    ConnectionAdmission m_admission;
+
+    // Descriptor held in reserve, so a connection can still be accepted and closed once the process ran out of descriptors
+    int m_spareFd;
+
+    // Receive buffers of all connections of this shard, only connections with a partial line hold one
+    BufferPool m_receivePool;
+
+    // Connections that are not logged in yet (NEW) and logged in ones (APPROVED), a login only changes the state
+    ConnectionSlab m_connections;
+
+    // Rooms of the approved connections of this shard
+    RoomRegistry m_rooms;
 
-    std::string m_databasePath = std::filesystem::current_path().string() + "/users.db";
-    UserDatabase m_userDatabase;
-    unsigned int m_nextClientId;
+    // Connections that failed or hit the slow consumer policy while iterating, closed after the current event batch
+    std::vector<ConnectionHandle> m_closingConnections;
 
-    std::vector<Connection> m_newConnections;
-    std::vector<Connection> m_approvedConnections;
+    // Connections that received messages during the current event loop iteration, each one is written once at its end
+    std::vector<ConnectionHandle> m_flushConnections;
 
-    const int m_listenBufferSize = 5;
+    // Batched send of the flushed connections, reused by every iteration (io_uring)
+    std::vector<EventLoop::Send> m_sends;
+    std::vector<ConnectionHandle> m_sendHandles;
+    std::vector<iovec> m_sendSegments;
+
+    // Logins and logouts of this shard, announced in batches
+    PresenceAggregator m_presence;
+
+    // Sessions are issued on login if enabled, shard 0 expires the detached ones every second
+    bool m_sessionsEnabled;
+    std::unique_ptr<IntervalTimer> m_sessionTimer;
+
+    // One timer per connection at most, its login deadline or the next time its keepalive has to be checked
+    TimerWheel m_timers;
+    std::chrono::seconds m_loginTimeout;
+    std::chrono::seconds m_idleTimeout;
+    std::chrono::seconds m_pingInterval;
+    std::chrono::seconds m_pingTimeout;
+
+    // Connections accepted per readiness event of the listening socket, the clients already connected are served in between
+    const size_t m_acceptBatchSize = 64;
+    const size_t m_maxSegmentsPerSend = 64;
+    // Received bytes that may wait for being handled before receiving from the client is paused (io_uring)
+    const size_t m_maxReceivedBytes = 64 * 1024;
     const unsigned int m_miminumNameLength = 3;
     const unsigned int m_maximumNameLength = 16;
     const unsigned int m_minimumPasswordLength = 6;
     const unsigned int m_maximumPasswordLength = 32;
+    const unsigned int m_maximumRoomNameLength = 24;
+
+    // Number of history messages sent on login and /join, and the limits of /history
+    size_t m_historyReplay;
+    const size_t m_defaultHistoryCount = 20;
+    const size_t m_maximumHistoryCount = 1000;
+    const size_t m_maximumHistoryMinutes = 365 * 24 * 60;
+
+    // Messages created on this shard, ids carry the shard index in their top 8 bits so they are unique across shards
+    uint64_t m_messageCount;
+
+    // Room every user is placed in after logging in and returns to on /leave
+    const std::string m_defaultRoom = "lobby";
 
     const std::string m_welcomeMsg =
         "Welcome to the server!\n\
         Register as new user using '/register <name> <password>'\n\
-        or login to an existing account using '/login <name> <password>'\n";
+        or login to an existing account using '/login <name> <password>'\n\
+        or continue a session after reconnecting using '/resume <token> [last_seen_id]'\n\
+        Bots and gateways may switch to binary frames using '/proto bin', they follow the line '/proto bin ok'\n";
+
+    const std::string m_tooManyConnectionsMsg = "Too many connections from your address, please try again later\n";
+
+    const std::string m_userHelpMsg =
+        "Available commands:\n\
+        /join <room> - switch to another room, it is created if it does not exist\n\
+        /leave - return to the lobby\n\
+        /msg <user> <text> - send a private message\n\
+        /rooms - list the rooms and their number of members\n\
+        /history [count | <minutes>m] - show the last messages of the room, or the ones of the last minutes\n\
+        /proto <bin | text> - switch to binary frames, they follow the line '/proto bin ok', or back to text lines after a CONTROL frame\n\
+        /compress <on | off> - compress large binary frames\n\
+        /help - display this message\n";
 
     const std::string m_consoleHelpMsg =
         "Available commands:\n\
         /help - display this message\n\
+        /stats - display the counters and latency histograms\n\
         /exit - stop the server\n";
 
     ServerCommand m_parseCommand(const std::string& command);
-    std::string m_colorizeText(const std::string& text, TextColor color);
+
+    bool m_isValidRoomName(std::string_view room) const;
+
+    /*
+     * Returns the id of the next message created on this shard
+     */
+    uint64_t m_nextMessageId();
 
    public:
     /*
      * Constructor
-     * @param port - port to listen on
+     * @param config - server configuration, including the port to listen on
+     * @param group - group of shards this server is part of
+     * @param shardIndex - index of this server within the group, shard 0 owns the server console
      */
-    Server(uint16_t port);
+    Server(const ServerConfig& config, ServerGroup& group, unsigned int shardIndex);
+    Server(const Server& other) = delete;
+    ~Server();
+
+    Server& operator=(const Server& other) = delete;
 
     /*
      * Starts the servers main loop
      */
     void run();
 
+    /*
+     * Posts an event to this server, safe to call from any thread
+     */
+    void post(ShardEvent event);
+
    private:
     /*
      * Handles input from the server console
@@ -73,19 +182,272 @@ class Server {
     void handleServerInput();
 
     /*
-     * Accepts new connections and adds them to the list of unapproved connections (not logged in users)
+     * Handles a single line read from the server console
+     */
+    void handleServerInputLine(const std::string& input);
+
+    /*
+     * Accepts all pending connections and adds them to the list of unapproved connections (not logged in users)
      */
     void handleNewConnections();
 
     /*
-     * Handles login and registration requests
+     * Handles a connection accepted by the io_uring backend
+     * @param result - descriptor of the accepted socket, or -errno
+     */
+    void handleAcceptedConnection(int result);
+
+    /*
+     * Handles a failed accept, out of descriptors the pending connection is accepted with the spare descriptor and closed
+     * @param error - errno of the accept call
+     * @return false if accepting should not be retried right away
+     */
+    bool handleAcceptError(int error);
+
+    /*
+     * Adds an accepted connection unless its address exceeded the connection rate limit
+     */
+    void admitConnection(TCPSocket&& socket);
+
+    /*
+     * Adds an accepted non-blocking socket to the unapproved connections and starts watching it
+     */
+    void addConnection(TCPSocket&& socket);
+
+    /*
+     * Flushes the outbound queue of a writable client socket and handles the input of a readable one
+     * @param handle - handle of the ready connection
+     * @param events - ready epoll events
+     */
+    void handleConnectionEvent(ConnectionHandle handle, uint32_t events);
+
+    /*
+     * Reads from a client until its socket would block and handles every complete line it sent
+     * @param handle - handle of the connection
+     * @param connection - the connection itself
+     */
+    void handleConnectionInput(ConnectionHandle handle, Connection& connection);
+
+    /*
+     * Handles data received by the io_uring backend, receiving is paused while too much of it waits for being handled
+     * @param handle - handle of the connection
+     * @param result - number of received bytes, 0 if the peer closed the connection or -errno
+     * @param data - the received bytes
+     */
+    void handleReceivedData(ConnectionHandle handle, int result, std::string_view data);
+
+    /*
+     * Handles '/proto <bin | text>', which is accepted before and after login
+     * @param connection - the connection itself
+     * @param argument - the line after the command
+     */
+    void handleProtocolCommand(Connection& connection, std::string_view argument);
+
+    /*
+     * Handles '/compress <on | off>' of a binary client, which is accepted before and after login
+     * @param connection - the connection itself
+     * @param argument - the line after the command
+     */
+    void handleCompressCommand(Connection& connection, std::string_view argument);
+
+    /*
+     * Validates a login or registration request of a not yet approved connection and submits it to the AuthService
+     * The connection handles no further input until the result arrived.
+     * @param handle - handle of the connection
+     * @param connection - the connection itself
+     * @param request - received line
+     */
+    void handleLoginRequest(ConnectionHandle handle, Connection& connection, std::string_view request);
+
+    /*
+     * Handles '/resume <token> [last_seen_id]', approves the connection without a database lookup or notifications
+     * and sends the messages of the user's room that were missed since the session was detached
+     * @param handle - handle of the connection
+     * @param connection - the connection itself
+     * @param arguments - the line after the command
+     */
+    void resumeSession(ConnectionHandle handle, Connection& connection, std::string_view arguments);
+
+    /*
+     * Closes a connection of this shard whose session was resumed by another connection, nobody is notified
+     */
+    void closeResumedConnection(ConnectionHandle handle);
+
+    /*
+     * Deletes the expired sessions and notifies the users that their users left, called by shard 0 every second
+     */
+    void expireSessions();
+
+    /*
+     * Replaces the timer of a connection, a time_point of the epoch only cancels it
+     */
+    void setConnectionTimer(ConnectionHandle handle, Connection& connection, std::chrono::steady_clock::time_point deadline);
+
+    /*
+     * Schedules the next keepalive check of an approved connection: its idle deadline, the time to send the next
+     * ping or the deadline of the outstanding one, whichever comes first
+     */
+    void scheduleKeepalive(ConnectionHandle handle, Connection& connection);
+
+    /*
+     * Closes a connection that did not log in in time, stayed idle or did not answer a ping, or sends the ping
+     */
+    void handleConnectionTimer(ConnectionHandle handle);
+
+    /*
+     * Handles the results of the AuthService, approves connections that logged in successfully
+     */
+    void handleAuthResults();
+
+    /*
+     * Applies a single AuthResult and continues handling the input of its connection
+     */
+    void handleAuthResult(const AuthResult& result);
+
+    /*
+     * Forwards a message of an approved connection (logged in user) to the other users
+     * @param handle - handle of the connection
+     * @param connection - the connection itself
+     * @param message - received line
+     */
+    void handleChatMessage(ConnectionHandle handle, Connection& connection, std::string_view message);
+
+    /*
+     * Handles a command of an approved connection (a line starting with '/')
+     * @param handle - handle of the connection
+     * @param connection - the connection itself
+     * @param command - received line
+     */
+    void handleUserCommand(ConnectionHandle handle, Connection& connection, std::string_view command);
+
+    /*
+     * Moves an approved connection to another room and notifies the members of both rooms
+     * @param handle - handle of the connection
+     * @param connection - the connection itself
+     * @param room - name of the room to join
+     */
+    void changeRoom(ConnectionHandle handle, Connection& connection, std::string_view room);
+
+    /*
+     * Adds an approved connection to a room without notifying anyone, it leaves its previous room first
+     * @return name of the previous room, empty if the connection was in none
+     */
+    std::string enterRoom(ConnectionHandle handle, std::string_view room);
+
+    /*
+     * Removes a connection from its room without notifying anyone
+     * @return name of the room that was left, empty if the connection was in none
+     */
+    std::string exitRoom(ConnectionHandle handle);
+
+    /*
+     * Handles '/history [count | <minutes>m]', sends the requested messages of the connection's room
+     */
+    void handleHistoryCommand(ConnectionHandle handle, Connection& connection, std::string_view argument);
+
+    /*
+     * Sends messages of the history to a client, with sendfile while its outbound queue is empty
+     * Binary clients receive a HISTORY frame per message instead, parsed from the stored lines.
+     * @param connection - receiving connection
+     * @param room - room the messages belong to, named in the header line
+     * @param ranges - ranges of the history returned by the MessageLog
+     */
+    void sendHistory(Connection& connection, std::string_view room, const std::vector<MessageLog::Range>& ranges);
+
+    /*
+     * Sends a private message to a logged in user, on this or another shard
+     * @param connection - connection of the sender
+     * @param recipient - name of the recipient
+     * @param text - text of the message
+     */
+    void sendDirectMessage(Connection& connection, std::string_view recipient, std::string_view text);
+
+    /*
+     * Delivers a private message to a connection of this shard, if it is still the one the sender addressed
+     */
+    void deliverDirect(ConnectionHandle handle, WireMessage& message);
+
+    /*
+     * Handles events posted by the other shards
+     */
+    void handleShardEvents();
+
+    /*
+     * Sends a message to the logged in users of this shard and forwards it to all other shards
+     * The message references shared buffers, so no recipient (or shard) copies it
+     * @param message - the message in both wire formats
+     * @param exclude - connection that does not receive the message (the sender), ConnectionHandle{} to send to everyone
+     */
+    void broadcast(WireMessage& message, ConnectionHandle exclude);
+
+    /*
+     * Sends a message to the logged in users of this shard
+     */
+    void deliverLocal(WireMessage& message, ConnectionHandle exclude);
+
+    /*
+     * Queues a message in the connection's protocol and registers the connection to be flushed at the end of the iteration
+     */
+    void deliver(ConnectionHandle handle, Connection& connection, WireMessage& message);
+
+    /*
+     * Writes the messages queued by deliver, one call per connection
+     */
+    void flushConnections();
+
+    /*
+     * Writes the messages queued by deliver with a single batched send of the io_uring backend
+     */
+    void flushConnectionsBatched();
+
+    /*
+     * Schedules a flush if direct writes to the connection had to queue data (io_uring)
+     * Unlike with epoll, no writable event reports that the socket has room again.
+     */
+    void scheduleQueuedOutput(ConnectionHandle handle);
+
+    /*
+     * Announces the logins and logouts collected by the PresenceAggregator
+     */
+    void flushPresence();
+
+    /*
+     * Sends a message to the members of a room on this shard and forwards it to all other shards
+     * @param room - name of the room
+     * @param message - the message in both wire formats
+     * @param exclude - connection that does not receive the message (the sender), ConnectionHandle{} to send to every member
+     */
+    void sendToRoom(std::string_view room, WireMessage& message, ConnectionHandle exclude);
+
+    /*
+     * Sends a message to the members of a room on this shard
+     * Sending never changes a membership (failed connections are closed after the event batch), so the member array
+     * stays valid while iterating. Messages that are already queued reference their own buffers and are delivered
+     * even if the recipient leaves the room.
+     */
+    void deliverToRoom(std::string_view room, WireMessage& message, ConnectionHandle exclude);
+
+    /*
+     * Sends a notification to the members of a room
+     * @param exclude - connection that does not receive the notification, ConnectionHandle{} to send to every member
+     */
+    void sendRoomNotification(std::string_view room, const std::string& message, ConnectionHandle exclude);
+
+    /*
+     * Marks a connection to be closed after the current event batch
+     */
+    void scheduleClose(ConnectionHandle handle);
+
+    /*
+     * Closes all connections scheduled by scheduleClose
      */
-    void handleLogin();
+    void closeScheduledConnections();
 
     /*
-     * Handles approved connections (logged in users), by forwarding messages to the other users
+     * Unregisters a connection from the event loop, removes it from its room and the UserDirectory and closes it
+     * The others are notified that its user left, unless the user's session is kept for resuming. Stale handles are ignored.
      */
-    void handleApprovedConnections();
+    void closeConnection(ConnectionHandle handle);
 
     /*
      * Handles a command from the server console
@@ -96,7 +458,7 @@ class Server {
     /*
      * Sends a message with the selected color to all logged in users
      * This method is a generalization of sendServerMessage, sendServerNotification and sendServerAlert which themselves use predefined colors
-     * @param message - message to send
+     * @param message - message to send, text clients receive it with the color and label added
      * @param color - color to use for the message
      */
     void sendGlobalMessage(const std::string& message, TextColor color);
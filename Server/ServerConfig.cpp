@@ -0,0 +1,183 @@
+#include "ServerConfig.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+
+namespace {
+
+/*
+ * Parses a decimal number that fits into the target type, unlike std::stoul it rejects signs and wrapped values
+ * @param minimum - smallest accepted value
+ * @return false if the text is no number or the number is out of range, the target is unchanged then
+ */
+template <typename T>
+bool parseNumber(std::string_view text, T& number, std::type_identity_t<T> minimum = 0) {
+    if (text.empty() || text.front() == '-' || text.front() == '+') {
+        return false;
+    }
+    T parsed;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), parsed);
+    if (error != std::errc() || end != text.data() + text.size() || parsed < minimum) {
+        return false;
+    }
+    number = parsed;
+    return true;
+}
+
+}  // namespace
+
+bool ServerConfig::parse(int argc, char** argv, ServerConfig& config) {
+    if (argc < 2) {
+        return false;
+    }
+
+    if (!parseNumber(argv[1], config.port)) {
+        return false;
+    }
+
+    for (int argIdx = 2; argIdx < argc; argIdx++) {
+        std::string_view option = argv[argIdx];
+        if (argIdx + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++argIdx];
+
+        if (option == "--threads") {
+            if (!parseNumber(value, config.threads, 1)) {
+                return false;
+            }
+        } else if (option == "--backlog") {
+            if (!parseNumber(value, config.listenBacklog, 1)) {
+                return false;
+            }
+        } else if (option == "--connect-rate") {
+            if (!parseNumber(value, config.connectRate)) {
+                return false;
+            }
+        } else if (option == "--connect-burst") {
+            if (!parseNumber(value, config.connectBurst, 1)) {
+                return false;
+            }
+        } else if (option == "--auth-threads") {
+            if (!parseNumber(value, config.authOptions.workers, 1)) {
+                return false;
+            }
+        } else if (option == "--auth-queue") {
+            if (!parseNumber(value, config.authOptions.queueSize, 1)) {
+                return false;
+            }
+        } else if (option == "--auth-per-address") {
+            if (!parseNumber(value, config.authOptions.requestsPerAddress, 1)) {
+                return false;
+            }
+        } else if (option == "--kdf-iterations") {
+            if (!parseNumber(value, config.authOptions.kdfIterations, 1)) {
+                return false;
+            }
+        } else if (option == "--user-cache") {
+            if (!parseNumber(value, config.authOptions.userCacheSize)) {
+                return false;
+            }
+        } else if (option == "--max-line-length") {
+            if (!parseNumber(value, config.maxLineLength, 1)) {
+                return false;
+            }
+        } else if (option == "--compression-threshold") {
+            if (!parseNumber(value, config.compressionThreshold)) {
+                return false;
+            }
+        } else if (option == "--high-watermark") {
+            if (!parseNumber(value, config.outboundLimits.highWatermark)) {
+                return false;
+            }
+        } else if (option == "--low-watermark") {
+            if (!parseNumber(value, config.outboundLimits.lowWatermark)) {
+                return false;
+            }
+        } else if (option == "--slow-consumer") {
+            if (value == "drop-oldest") {
+                config.outboundLimits.policy = SlowConsumerPolicy::DROP_OLDEST;
+            } else if (value == "disconnect") {
+                config.outboundLimits.policy = SlowConsumerPolicy::DISCONNECT;
+            } else if (value == "pause") {
+                config.outboundLimits.policy = SlowConsumerPolicy::PAUSE;
+            } else {
+                return false;
+            }
+        } else if (option == "--history-dir") {
+            config.historyOptions.directory = value;
+        } else if (option == "--history-replay") {
+            if (!parseNumber(value, config.historyReplay)) {
+                return false;
+            }
+        } else if (option == "--history-sync-ms") {
+            if (!parseNumber(value, config.historyOptions.syncIntervalMs)) {
+                return false;
+            }
+        } else if (option == "--history-segment-size") {
+            if (!parseNumber(value, config.historyOptions.segmentSize)) {
+                return false;
+            }
+        } else if (option == "--history-segments") {
+            if (!parseNumber(value, config.historyOptions.segmentsPerRoom, 1)) {
+                return false;
+            }
+        } else if (option == "--presence-window") {
+            if (!parseNumber(value, config.presenceWindowMs)) {
+                return false;
+            }
+        } else if (option == "--session-ttl") {
+            if (!parseNumber(value, config.sessionTtl)) {
+                return false;
+            }
+        } else if (option == "--login-timeout") {
+            if (!parseNumber(value, config.loginTimeout)) {
+                return false;
+            }
+        } else if (option == "--idle-timeout") {
+            if (!parseNumber(value, config.idleTimeout)) {
+                return false;
+            }
+        } else if (option == "--ping-interval") {
+            if (!parseNumber(value, config.pingInterval)) {
+                return false;
+            }
+        } else if (option == "--ping-timeout") {
+            if (!parseNumber(value, config.pingTimeout, 1)) {
+                return false;
+            }
+        } else if (option == "--admin-port") {
+            if (!parseNumber(value, config.adminPort)) {
+                return false;
+            }
+        } else if (option == "--io-backend") {
+            if (value == "epoll") {
+                config.ioBackend = EventLoop::Backend::EPOLL;
+            } else if (value == "io_uring") {
+                config.ioBackend = EventLoop::Backend::IO_URING;
+            } else {
+                return false;
+            }
+        } else if (option == "--log-level") {
+            if (!Logger::parseLevel(value, config.logOptions.level)) {
+                return false;
+            }
+        } else if (option == "--log-rate") {
+            if (!parseNumber(value, config.logOptions.linesPerSecond)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    // Every message has to fit into a single history segment
+    size_t minimumSegmentSize = std::max<size_t>(64 * 1024, 2 * config.maxLineLength);
+    return config.outboundLimits.lowWatermark <= config.outboundLimits.highWatermark && config.historyOptions.segmentSize >= minimumSegmentSize;
+}
+
+std::string ServerConfig::usage(const std::string& program) {
+    return "Usage: " + program + " <port> [--threads N] [--backlog N] [--connect-rate N] [--connect-burst N] [--auth-threads N] [--auth-queue N] [--auth-per-address N] [--kdf-iterations N] [--user-cache N] [--high-watermark BYTES] [--low-watermark BYTES] [--slow-consumer drop-oldest|disconnect|pause] [--max-line-length BYTES] [--compression-threshold BYTES] [--history-dir PATH] [--history-replay N] [--history-sync-ms MS] [--history-segment-size BYTES] [--history-segments N] [--session-ttl SECONDS] [--login-timeout SECONDS] [--idle-timeout SECONDS] [--ping-interval SECONDS] [--ping-timeout SECONDS] [--presence-window MS] [--admin-port PORT] [--io-backend epoll|io_uring] [--log-level debug|info|warning|error] [--log-rate N]";
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include "../Database/MessageLog.hpp"
+#include "../Logging/Logger.hpp"
+#include "../Networking/EventLoop.hpp"
+#include "../Networking/OutboundQueue.hpp"
+#include "AuthService.hpp"
+
+struct ServerConfig {
+    uint16_t port = 0;
+
+    // Number of reactor threads, each one owns its own listening socket and slice of the connections
+    unsigned int threads = 1;
+
+    // Connections waiting for being accepted before the kernel refuses new ones (capped by net.core.somaxconn)
+    int listenBacklog = SOMAXCONN;
+
+    // Connections a single address may open per second and at once, per reactor thread, a rate of 0 disables the limit
+    unsigned int connectRate = 20;
+    unsigned int connectBurst = 100;
+
+    // Worker pool handling logins and registrations: threads, queue size, per address limit, hashing cost and user cache size
+    AuthOptions authOptions;
+
+    std::string databasePath = std::filesystem::current_path().string() + "/users.db";
+
+    // Longest line (chat message or command) accepted from a client
+    size_t maxLineLength = 4096;
+
+    // Smallest frame that is compressed for binary clients that enabled compression, 0 disables compression
+    size_t compressionThreshold = 256;
+
+    // Watermarks of the per-connection outbound queues and the policy applied to clients that read too slowly
+    OutboundLimits outboundLimits;
+
+    // Location, segment size, retention and sync interval of the persistent room history
+    MessageLogOptions historyOptions;
+
+    // Number of history messages sent to a client entering a room, 0 disables the replay
+    size_t historyReplay = 20;
+
+    // Logins and logouts within this many milliseconds are announced together, 0 announces each one right away
+    unsigned int presenceWindowMs = 200;
+
+    // Seconds a session can be resumed after its connection was closed, 0 disables sessions
+    unsigned int sessionTtl = 120;
+
+    // Seconds a client may take to log in, and a logged in one may send nothing but '/pong' before it is disconnected, 0 disables each limit
+    unsigned int loginTimeout = 30;
+    unsigned int idleTimeout = 0;
+
+    // Seconds of silence after which a client is sent '/ping', and the seconds it has to answer, an interval of 0 disables the keepalive
+    unsigned int pingInterval = 0;
+    unsigned int pingTimeout = 20;
+
+    // Port on the loopback interface serving the metrics in Prometheus format, 0 disables it
+    uint16_t adminPort = 0;
+
+    // Event loop backend of the reactor threads, io_uring falls back to epoll if the kernel does not support it
+    EventLoop::Backend ioBackend = EventLoop::Backend::EPOLL;
+
+    // Lowest level that is logged and the number of lines a thread may log per second
+    LogOptions logOptions;
+
+    /*
+     * Parses the command line arguments '<port> [--threads N] [--backlog N] [--connect-rate N] [--connect-burst N] [--auth-threads N] [--auth-queue N] [--auth-per-address N] [--kdf-iterations N] [--user-cache N] [--high-watermark BYTES] [--low-watermark BYTES] [--slow-consumer POLICY] [--max-line-length BYTES] [--compression-threshold BYTES] [--history-dir PATH] [--history-replay N] [--history-sync-ms MS] [--history-segment-size BYTES] [--history-segments N] [--session-ttl SECONDS] [--login-timeout SECONDS] [--idle-timeout SECONDS] [--ping-interval SECONDS] [--ping-timeout SECONDS] [--presence-window MS] [--admin-port PORT] [--io-backend BACKEND] [--log-level LEVEL] [--log-rate N]'
+     * @param config - receives the parsed values
+     * @return false if the arguments are invalid
+     */
+    static bool parse(int argc, char** argv, ServerConfig& config);
+
+    /*
+     * Usage string printed for invalid arguments
+     */
+    static std::string usage(const std::string& program);
+};
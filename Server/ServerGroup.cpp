@@ -0,0 +1,86 @@
+#include "ServerGroup.hpp"
+
+#include <csignal>
+#include <thread>
+
+#include "../Logging/Logger.hpp"
+
+ServerGroup::ServerGroup(const ServerConfig& config) : m_config{config}, m_authService{config.databasePath, config.authOptions, &m_metrics},
+                                                        m_sessionTable{std::chrono::seconds(config.sessionTtl)},
+                                                        m_messageLog{config.historyOptions} {
+    // History is sent with sendfile, which unlike send has no flag to suppress SIGPIPE for a closed peer
+    signal(SIGPIPE, SIG_IGN);
+
+    if (m_config.ioBackend == EventLoop::Backend::IO_URING && !EventLoop::isIoUringSupported()) {
+        Logger::warning("io_uring is not supported by this kernel or build, falling back to epoll");
+        m_config.ioBackend = EventLoop::Backend::EPOLL;
+    }
+
+    for (unsigned int shardIdx = 0; shardIdx < m_config.threads; shardIdx++) {
+        m_shards.push_back(std::make_unique<Server>(m_config, *this, shardIdx));
+    }
+    if (m_config.adminPort != 0) {
+        m_adminServer = std::make_unique<AdminServer>(m_config.adminPort, m_metrics);
+    }
+}
+
+void ServerGroup::run() {
+    std::vector<std::thread> threads;
+    for (unsigned int shardIdx = 1; shardIdx < m_shards.size(); shardIdx++) {
+        threads.emplace_back([this, shardIdx]() { m_shards[shardIdx]->run(); });
+    }
+    m_shards[0]->run();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    m_authService.stop();
+    m_messageLog.stop();
+    if (m_adminServer) {
+        m_adminServer->stop();
+    }
+}
+
+void ServerGroup::forward(unsigned int originShard, const ShardEvent& event) {
+    for (unsigned int shardIdx = 0; shardIdx < m_shards.size(); shardIdx++) {
+        if (shardIdx != originShard) {
+            m_shards[shardIdx]->post(event);
+        }
+    }
+}
+
+void ServerGroup::post(unsigned int shard, const ShardEvent& event) {
+    m_shards[shard]->post(event);
+}
+
+void ServerGroup::stop(unsigned int originShard) {
+    forward(originShard, ShardEvent::stop());
+}
+
+AuthService& ServerGroup::getAuthService() {
+    return m_authService;
+}
+
+RoomDirectory& ServerGroup::getRoomDirectory() {
+    return m_roomDirectory;
+}
+
+UserDirectory& ServerGroup::getUserDirectory() {
+    return m_userDirectory;
+}
+
+SessionTable& ServerGroup::getSessionTable() {
+    return m_sessionTable;
+}
+
+MessageLog& ServerGroup::getMessageLog() {
+    return m_messageLog;
+}
+
+Metrics& ServerGroup::getMetrics() {
+    return m_metrics;
+}
+
+unsigned int ServerGroup::getShardCount() const {
+    return m_shards.size();
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "../Database/MessageLog.hpp"
+#include "AdminServer.hpp"
+#include "AuthService.hpp"
+#include "Metrics.hpp"
+#include "RoomDirectory.hpp"
+#include "Server.hpp"
+#include "ServerConfig.hpp"
+#include "SessionTable.hpp"
+#include "ShardEvent.hpp"
+#include "UserDirectory.hpp"
+
+/*
+ * Runs one Server (shard) per reactor thread
+ * Every shard listens on the same port using SO_REUSEPORT, so the kernel distributes new connections between them.
+ * Broadcasts cross shards through the lock-free inbox of each shard.
+ */
+class ServerGroup {
+   private:
+    ServerConfig m_config;
+    std::vector<std::unique_ptr<Server>> m_shards;
+
+    // Declared before the auth workers and the admin server, which use it until they are destroyed
+    Metrics m_metrics;
+
+    // Declared after the shards, so its workers stop before the inboxes they post to are destroyed
+    AuthService m_authService;
+
+    RoomDirectory m_roomDirectory;
+    UserDirectory m_userDirectory;
+    SessionTable m_sessionTable;
+    MessageLog m_messageLog;
+
+    // Only set if an admin port is configured
+    std::unique_ptr<AdminServer> m_adminServer;
+
+   public:
+    /*
+     * Constructor
+     * @param config - configuration shared by all shards
+     */
+    ServerGroup(const ServerConfig& config);
+
+    /*
+     * Starts all shards and blocks until every one of them stopped
+     * The first shard runs on the calling thread and owns the server console
+     */
+    void run();
+
+    /*
+     * Posts an event to every shard except the origin
+     * @param originShard - index of the posting shard
+     * @param event - event to post
+     */
+    void forward(unsigned int originShard, const ShardEvent& event);
+
+    /*
+     * Posts an event to a single shard
+     */
+    void post(unsigned int shard, const ShardEvent& event);
+
+    /*
+     * Stops all shards except the origin, which is expected to stop itself
+     */
+    void stop(unsigned int originShard);
+
+    /*
+     * Worker pool handling the logins and registrations of all shards
+     */
+    AuthService& getAuthService();
+
+    /*
+     * Member counts of the rooms of all shards
+     */
+    RoomDirectory& getRoomDirectory();
+
+    /*
+     * Logged in users of all shards, by name and id
+     */
+    UserDirectory& getUserDirectory();
+
+    /*
+     * Resumable sessions of the users of all shards
+     */
+    SessionTable& getSessionTable();
+
+    /*
+     * Persistent history of the rooms of all shards
+     */
+    MessageLog& getMessageLog();
+
+    /*
+     * Counters and histograms of all shards and auth workers
+     */
+    Metrics& getMetrics();
+
+    unsigned int getShardCount() const;
+};
@@ -0,0 +1,88 @@
+#include "SessionTable.hpp"
+
+#include <sys/random.h>
+
+SessionTable::SessionTable(std::chrono::seconds timeToLive) : m_timeToLive{timeToLive} {}
+
+std::string SessionTable::create(const UserData& user, const UserLocation& owner) {
+    // 128 random bits, hex encoded
+    unsigned char bytes[16];
+    size_t filled = 0;
+    while (filled < sizeof(bytes)) {
+        ssize_t result = getrandom(bytes + filled, sizeof(bytes) - filled, 0);
+        if (result > 0) {
+            filled += result;
+        }
+    }
+    static const char digits[] = "0123456789abcdef";
+    std::string token;
+    for (unsigned char byte : bytes) {
+        token.push_back(digits[byte >> 4]);
+        token.push_back(digits[byte & 0x0f]);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sessions.insert_or_assign(token, Session{user, "", 0, owner, {}});
+    return token;
+}
+
+void SessionTable::setRoom(const std::string& token, std::string_view room) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_sessions.find(token);
+    if (it != m_sessions.end()) {
+        it->second.room = room;
+    }
+}
+
+bool SessionTable::detach(const std::string& token, const UserLocation& owner, const std::string& room, uint64_t missedFrom) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_sessions.find(token);
+    if (it == m_sessions.end()) {
+        return false;
+    }
+    Session& session = it->second;
+    if (session.owner != owner) {
+        // Taken over by a resuming connection, whose user is online
+        return session.owner.has_value();
+    }
+    session.owner.reset();
+    session.room = room;
+    session.missedFrom = missedFrom;
+    session.expiry = std::chrono::steady_clock::now() + m_timeToLive;
+    m_expiries.emplace_back(session.expiry, token);
+    return true;
+}
+
+std::optional<SessionTable::Resumed> SessionTable::resume(std::string_view token, const UserLocation& owner) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_sessions.find(std::string(token));
+    if (it == m_sessions.end()) {
+        return std::nullopt;
+    }
+    Session& session = it->second;
+    if (!session.owner && session.expiry <= std::chrono::steady_clock::now()) {
+        return std::nullopt;
+    }
+    Resumed resumed{session.user, session.room, std::nullopt, session.owner};
+    if (!session.owner) {
+        resumed.missedFrom = session.missedFrom;
+    }
+    session.owner = owner;
+    return resumed;
+}
+
+std::vector<UserData> SessionTable::expire() {
+    std::vector<UserData> users;
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (!m_expiries.empty() && m_expiries.front().first <= now) {
+        auto it = m_sessions.find(m_expiries.front().second);
+        // The session might have been resumed and detached again since, then a later entry is responsible
+        if (it != m_sessions.end() && !it->second.owner && it->second.expiry == m_expiries.front().first) {
+            users.push_back(it->second.user);
+            m_sessions.erase(it);
+        }
+        m_expiries.pop_front();
+    }
+    return users;
+}
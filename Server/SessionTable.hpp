@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../Database/UserData.hpp"
+#include "UserDirectory.hpp"
+
+/*
+ * Sessions of the logged in users of all shards, keyed by an opaque random token (thread-safe)
+ * A session outlives its connection for a while, so a client that lost its connection can resume it with the token
+ * instead of logging in again. Until the session expires, the user counts as online and nobody is notified.
+ */
+class SessionTable {
+   public:
+    /*
+     * Session taken over by a resuming connection
+     */
+    struct Resumed {
+        UserData user;
+        std::string room;
+        // Id of the first history message of the room the client missed, nullopt if the old connection was still open
+        std::optional<uint64_t> missedFrom;
+        // Connection that used the session until now, it has to be closed without notifications
+        std::optional<UserLocation> previousOwner;
+    };
+
+   private:
+    struct Session {
+        UserData user;
+        std::string room;
+        uint64_t missedFrom;
+        // Connection currently using the session, nullopt while it is detached
+        std::optional<UserLocation> owner;
+        // Only meaningful while detached
+        std::chrono::steady_clock::time_point expiry;
+    };
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Session> m_sessions;
+
+    // Detached sessions in the order they expire, entries of sessions resumed since are skipped
+    std::deque<std::pair<std::chrono::steady_clock::time_point, std::string>> m_expiries;
+    std::chrono::seconds m_timeToLive;
+
+   public:
+    /*
+     * Constructor
+     * @param timeToLive - time a session is kept after its connection was closed
+     */
+    SessionTable(std::chrono::seconds timeToLive);
+
+    /*
+     * Creates a session for a login
+     * @return token of the new session
+     */
+    std::string create(const UserData& user, const UserLocation& owner);
+
+    /*
+     * Records the room the user of a session moved to
+     */
+    void setRoom(const std::string& token, std::string_view room);
+
+    /*
+     * Called when the connection using a session closed, the session stays valid until it expires
+     * @param room - room the user was in
+     * @param missedFrom - id of the next history message of the room
+     * @return true if the session is kept or was already taken over by another connection, so nobody should be notified
+     */
+    bool detach(const std::string& token, const UserLocation& owner, const std::string& room, uint64_t missedFrom);
+
+    /*
+     * Moves a session to another connection
+     * @return the session, nullopt if the token is unknown or expired
+     */
+    std::optional<Resumed> resume(std::string_view token, const UserLocation& owner);
+
+    /*
+     * Deletes the detached sessions whose time to live elapsed
+     * @return users of the expired sessions
+     */
+    std::vector<UserData> expire();
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../Networking/MessageBuffer.hpp"
+#include "ConnectionHandle.hpp"
+#include "WireMessage.hpp"
+
+/*
+ * Event passed between the reactor threads of a ServerGroup
+ */
+struct ShardEvent {
+    enum class Type {
+        // Deliver the message to all logged in users of the receiving shard
+        BROADCAST,
+        // Deliver the message to the members of a room on the receiving shard
+        ROOM_MESSAGE,
+        // Deliver the message to a single connection of the receiving shard
+        DIRECT_MESSAGE,
+        // Close a connection of the receiving shard without notifying anyone, its session was resumed elsewhere
+        CLOSE_RESUMED,
+        // Stop the receiving shard
+        STOP
+    };
+
+    Type type = Type::BROADCAST;
+
+    // The message in both wire formats, its buffers are shared by all shards instead of being copied per thread
+    WireMessage message;
+
+    // Name of the room of a ROOM_MESSAGE
+    MessageRef room;
+
+    // Recipient of a DIRECT_MESSAGE or connection to close within the slab of the receiving shard
+    ConnectionHandle target;
+
+    static ShardEvent broadcast(const WireMessage& message) {
+        ShardEvent event;
+        event.message = message;
+        return event;
+    }
+
+    static ShardEvent roomMessage(const MessageRef& room, const WireMessage& message) {
+        ShardEvent event = broadcast(message);
+        event.type = Type::ROOM_MESSAGE;
+        event.room = room;
+        return event;
+    }
+
+    static ShardEvent directMessage(ConnectionHandle target, const WireMessage& message) {
+        ShardEvent event = broadcast(message);
+        event.type = Type::DIRECT_MESSAGE;
+        event.target = target;
+        return event;
+    }
+
+    static ShardEvent closeResumed(ConnectionHandle target) {
+        ShardEvent event;
+        event.type = Type::CLOSE_RESUMED;
+        event.target = target;
+        return event;
+    }
+
+    static ShardEvent stop() {
+        ShardEvent event;
+        event.type = Type::STOP;
+        return event;
+    }
+};
@@ -0,0 +1,35 @@
+#include "TextColor.hpp"
+
+std::string_view colorCode(TextColor color) {
+    switch (color) {
+        case TextColor::SERVER_ALERT:
+            return "\033[31m";
+        case TextColor::SERVER_MESSAGE:
+            return "\033[32m";
+        case TextColor::SERVER_NOTIFICATION:
+            return "\033[36m";
+        default:
+            return "";
+    }
+}
+
+std::string_view noticeLabel(TextColor color) {
+    return color == TextColor::SERVER_MESSAGE ? "Server: " : ">>> ";
+}
+
+std::string colorizeText(std::string_view text, TextColor color) {
+    std::string_view code = colorCode(color);
+    std::string colorized;
+    colorized.reserve(code.size() + text.size() + colorReset.size());
+    colorized.append(code).append(text).append(colorReset);
+    return colorized;
+}
+
+std::string decorateText(std::string_view text, TextColor color) {
+    std::string_view code = colorCode(color);
+    std::string_view label = noticeLabel(color);
+    std::string decorated;
+    decorated.reserve(code.size() + label.size() + text.size() + noticeEnd.size());
+    decorated.append(code).append(label).append(text).append(noticeEnd);
+    return decorated;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+enum class TextColor {
+    SERVER_MESSAGE,
+    SERVER_NOTIFICATION,
+    SERVER_ALERT
+};
+
+// Escape sequence restoring the default color
+inline constexpr std::string_view colorReset = "\033[0m";
+
+// Ends a notice of the text protocol, the reset sequence followed by the line break
+inline constexpr std::string_view noticeEnd = "\033[0m\n";
+
+/*
+ * Returns the ANSI escape sequence selecting the color
+ */
+std::string_view colorCode(TextColor color);
+
+/*
+ * Returns the label a notice of the color starts with in the text protocol ('Server: ' or '>>> ')
+ */
+std::string_view noticeLabel(TextColor color);
+
+/*
+ * Wraps the text into the escape sequences of the color and the reset sequence
+ */
+std::string colorizeText(std::string_view text, TextColor color);
+
+/*
+ * Formats a notice for the text protocol: color, label, text, reset sequence and line break
+ * Binary clients receive the plain text and the color instead, so this is only applied at the text edge.
+ */
+std::string decorateText(std::string_view text, TextColor color);
@@ -0,0 +1,37 @@
+#include "UserDirectory.hpp"
+
+#include <mutex>
+
+void UserDirectory::add(unsigned int id, const std::string& name, const UserLocation& location) {
+    std::unique_lock lock{m_mutex};
+    m_byId.insert_or_assign(id, Entry{name, location});
+    m_idsByName.insert_or_assign(name, id);
+}
+
+void UserDirectory::remove(unsigned int id, const UserLocation& location) {
+    std::unique_lock lock{m_mutex};
+    auto it = m_byId.find(id);
+    if (it == m_byId.end() || it->second.location != location) {
+        return;
+    }
+    m_idsByName.erase(it->second.name);
+    m_byId.erase(it);
+}
+
+std::optional<UserLocation> UserDirectory::findByName(std::string_view name) const {
+    std::shared_lock lock{m_mutex};
+    auto idIt = m_idsByName.find(name);
+    if (idIt == m_idsByName.end()) {
+        return std::nullopt;
+    }
+    return m_byId.at(idIt->second).location;
+}
+
+std::optional<UserLocation> UserDirectory::findById(unsigned int id) const {
+    std::shared_lock lock{m_mutex};
+    auto it = m_byId.find(id);
+    if (it == m_byId.end()) {
+        return std::nullopt;
+    }
+    return it->second.location;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "ConnectionHandle.hpp"
+
+/*
+ * Shard and connection of a logged in user
+ */
+struct UserLocation {
+    unsigned int shard;
+    ConnectionHandle connection;
+
+    bool operator==(const UserLocation& other) const = default;
+};
+
+/*
+ * Index of the logged in users of all shards by name and id (thread-safe)
+ * Lookups take a shared lock and cost two hash lookups at most, independent of the number of online users.
+ * If a user is logged in more than once, the index refers to the most recent login.
+ */
+class UserDirectory {
+   private:
+    // Allows looking names up by string_view without constructing a string
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const {
+            return std::hash<std::string_view>{}(name);
+        }
+    };
+
+    struct Entry {
+        std::string name;
+        UserLocation location;
+    };
+
+    mutable std::shared_mutex m_mutex;
+    std::unordered_map<unsigned int, Entry> m_byId;
+    std::unordered_map<std::string, unsigned int, NameHash, std::equal_to<>> m_idsByName;
+
+   public:
+    /*
+     * Registers a login, replacing an older login of the same user
+     */
+    void add(unsigned int id, const std::string& name, const UserLocation& location);
+
+    /*
+     * Unregisters a login, nothing happens if the user logged in again from another connection since
+     */
+    void remove(unsigned int id, const UserLocation& location);
+
+    std::optional<UserLocation> findByName(std::string_view name) const;
+    std::optional<UserLocation> findById(unsigned int id) const;
+};
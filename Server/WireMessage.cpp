@@ -0,0 +1,93 @@
+#include "WireMessage.hpp"
+
+#include <chrono>
+#include <string>
+
+WireMessage::WireMessage() : m_textCount{0},
+                             m_compressionTried{false},
+                             m_compressionSavings{0} {}
+
+WireMessage WireMessage::m_create(FrameType type, uint64_t senderId, uint64_t messageId) {
+    WireMessage message;
+    message.m_header.type = type;
+    message.m_header.senderId = senderId;
+    message.m_header.messageId = messageId;
+    message.m_header.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    return message;
+}
+
+WireMessage WireMessage::chat(const MessageRef& room, const MessageRef& senderPrefix, uint64_t senderId, std::string_view text, uint64_t messageId) {
+    WireMessage message = m_create(FrameType::CHAT, senderId, messageId);
+    // One payload buffer per message, the sender prefix was created on login
+    MessageRef payload = MessageBuffer::create({text, "\n"});
+    message.m_room = room;
+    message.m_sender = senderPrefix.prefix(senderPrefix.size() - 2);
+    message.m_binaryText = payload.prefix(text.size());
+    message.m_text = {senderPrefix, payload};
+    message.m_textCount = 2;
+    return message;
+}
+
+WireMessage WireMessage::direct(const MessageRef& senderPrefix, uint64_t senderId, std::string_view text, uint64_t messageId) {
+    WireMessage message = m_create(FrameType::DIRECT, senderId, messageId);
+    MessageRef payload = MessageBuffer::create({text, "\n"});
+    message.m_sender = senderPrefix.prefix(senderPrefix.size() - 2);
+    message.m_binaryText = payload.prefix(text.size());
+    message.m_text = {MessageRef::fromStatic("(private) "), senderPrefix, payload};
+    message.m_textCount = 3;
+    return message;
+}
+
+WireMessage WireMessage::notice(const MessageRef& room, std::string_view text, TextColor color) {
+    WireMessage message = m_create(FrameType::NOTICE, 0, 0);
+    message.m_header.flags = static_cast<uint8_t>(color);
+    // Color codes and labels are static, only the text itself needs a buffer
+    MessageRef payload = MessageBuffer::create({text});
+    message.m_room = room;
+    message.m_binaryText = payload;
+    message.m_text = {MessageRef::fromStatic(colorCode(color)), MessageRef::fromStatic(noticeLabel(color)), payload, MessageRef::fromStatic(noticeEnd)};
+    message.m_textCount = 4;
+    return message;
+}
+
+std::span<const MessageRef> WireMessage::text() const {
+    return std::span<const MessageRef>(m_text.data(), m_textCount);
+}
+
+std::span<const MessageRef> WireMessage::binary() {
+    if (m_binary[0].empty()) {
+        std::string_view room = m_room.view().substr(0, UINT8_MAX);
+        std::string_view sender = m_sender.view().substr(0, UINT8_MAX);
+        m_header.roomLength = static_cast<uint8_t>(room.size());
+        m_header.senderLength = static_cast<uint8_t>(sender.size());
+        m_header.length = static_cast<uint32_t>(room.size() + sender.size() + m_binaryText.size());
+        m_binary = {MessageBuffer::create({viewFrameHeader(m_header), room, sender}), m_binaryText};
+    }
+    // An empty text (e.g. of a notice) needs no segment
+    return std::span<const MessageRef>(m_binary.data(), m_binaryText.empty() ? 1 : 2);
+}
+
+std::span<const MessageRef> WireMessage::compressed(size_t threshold) {
+    std::span<const MessageRef> frame = binary();
+    size_t frameSize = m_binary[0].size() + m_binaryText.size();
+    if (frameSize < threshold) {
+        return frame;
+    }
+    if (!m_compressionTried) {
+        m_compressionTried = true;
+        // Reused by every message of the thread
+        thread_local std::string uncompressed;
+        thread_local std::string compressed;
+        uncompressed.assign(m_binary[0].view()).append(m_binaryText.view());
+        compressed.clear();
+        if (appendCompressedFrame(compressed, uncompressed)) {
+            m_compressed = MessageBuffer::create({compressed});
+            m_compressionSavings = frameSize - compressed.size();
+        }
+    }
+    return m_compressed.empty() ? frame : std::span<const MessageRef>(&m_compressed, 1);
+}
+
+size_t WireMessage::getCompressionSavings() const {
+    return m_compressionSavings;
+}
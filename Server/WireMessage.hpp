@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include "../Networking/BinaryFrame.hpp"
+#include "../Networking/MessageBuffer.hpp"
+#include "TextColor.hpp"
+
+/*
+ * Message delivered to many connections, in the format of either protocol
+ * The text form (sender prefix, colors and line break included) is built on creation. The binary form shares its
+ * payload buffer and only adds a buffer holding the frame header, room and sender, which is built when the first binary
+ * client receives the message, and so is the compressed form. Copies share all buffers but build the other forms on
+ * their own, so every shard can use its copy without synchronization. Either way, a message is encoded once per shard
+ * at most, never once per recipient.
+ */
+class WireMessage {
+   private:
+    FrameHeader m_header;
+    MessageRef m_room;
+    MessageRef m_sender;
+    // Text of the binary frame, a slice of the text form's payload
+    MessageRef m_binaryText;
+
+    std::array<MessageRef, 4> m_text;
+    size_t m_textCount;
+    std::array<MessageRef, 2> m_binary;
+    // COMPRESSED frame holding the binary frame, empty if it is too small or did not compress
+    MessageRef m_compressed;
+    bool m_compressionTried;
+    size_t m_compressionSavings;
+
+    /*
+     * Creates a message with the frame header fields that do not depend on the content
+     */
+    static WireMessage m_create(FrameType type, uint64_t senderId, uint64_t messageId);
+
+   public:
+    WireMessage();
+
+    /*
+     * Creates a chat message of a room
+     * @param room - shared name of the room
+     * @param senderPrefix - shared '<name>: ' prefix of the sender
+     * @param senderId - user id of the sender
+     * @param text - text without line break
+     * @param messageId - id unique across all shards
+     */
+    static WireMessage chat(const MessageRef& room, const MessageRef& senderPrefix, uint64_t senderId, std::string_view text, uint64_t messageId);
+
+    /*
+     * Creates a private message, parameters as for chat
+     */
+    static WireMessage direct(const MessageRef& senderPrefix, uint64_t senderId, std::string_view text, uint64_t messageId);
+
+    /*
+     * Creates a server notice
+     * @param room - shared name of the room the notice concerns, empty for notices to everyone
+     * @param text - undecorated text, the color and label are only added for text clients
+     */
+    static WireMessage notice(const MessageRef& room, std::string_view text, TextColor color);
+
+    /*
+     * Segments of the message in the text protocol
+     */
+    std::span<const MessageRef> text() const;
+
+    /*
+     * Segments of the message as a binary frame, built on the first call
+     */
+    std::span<const MessageRef> binary();
+
+    /*
+     * Segments of the message as a COMPRESSED frame, or as the binary frame if that is smaller than threshold or
+     * compressing does not pay off, compressed on the first call
+     */
+    std::span<const MessageRef> compressed(size_t threshold);
+
+    /*
+     * Bytes a recipient of the compressed form saves, 0 if it was not compressed
+     */
+    size_t getCompressionSavings() const;
+};
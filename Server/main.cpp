@@ -2,14 +2,29 @@
 
 #include <chrono>
 #include <iostream>
+#include <stdexcept>
 #include <thread>
 
+#include "../Logging/Logger.hpp"
 #include "../Networking/TCPSocket.hpp"
-#include "Server.hpp"
+#include "ServerConfig.hpp"
+#include "ServerGroup.hpp"
 
-int main(int, char** argv) {
-    uint16_t port = std::atoi(argv[1]);
-    Server server{port};
-    server.run();
+int main(int argc, char** argv) {
+    ServerConfig config;
+    if (!ServerConfig::parse(argc, argv, config)) {
+        std::cerr << ServerConfig::usage(argv[0]) << std::endl;
+        return 1;
+    }
+    Logger::configure(config.logOptions);
+    Logger::setThreadName("reactor-0");
+
+    try {
+        ServerGroup serverGroup{config};
+        serverGroup.run();
+    } catch (const std::runtime_error& error) {
+        Logger::error(error.what());
+        return 1;
+    }
     return 0;
-}
\ No newline at end of file
+}